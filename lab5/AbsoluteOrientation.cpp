@@ -1,39 +1,298 @@
+#include <mutex>
+
 #include "AbsoluteOrientation.h"
+#include "Parallel.h"
+
+AbsoluteOrientation::AbsoluteOrientation(const vector<Point3D>& coords_object, const vector<Point3D>& coords_model) :
+	AbsoluteOrientation(PointCloud3D(coords_object), PointCloud3D(coords_model)) {}
 
-AbsoluteOrientation::AbsoluteOrientation(const vector<Point3D>& coords_object, const vector<Point3D>& coords_model) {
+AbsoluteOrientation::AbsoluteOrientation(const PointCloud3D &coords_object, const PointCloud3D &coords_model) {
 	this->num_points = coords_object.size();
 	this->coords_object = coords_object;
 	this->coords_model = coords_model;
+	this->loss = NULL;
+	this->parameterization = RotationParameterization::Angles;
+}
+
+void AbsoluteOrientation::setRobustLoss(const RobustLoss *loss) {
+	this->loss = loss;
 }
 
 void AbsoluteOrientation::computeOrientation(const Point3D &_T, const Angles &_ang, double _lambda) {
 	T = _T;
-	Angles ang = _ang;
+	ang = _ang;
 	lambda = _lambda;
 	M.rotate(ang);
+	q = Quaternion::fromMatrix(M);
 
-	Matrix obs = convertToVector(coords_object);
-	Matrix est;
+	obs = convertToVector(coords_object);
+	weights.assign(3 * num_points, 1.0);
 
 	double threshold = 1e-6;
-	do {
-		A = absoluteA();
-		est = absoluteCond();
-		w = misclosure(obs, est);
-		del = delta(A, w);
-		
-		ang.omega += del.at(0, 0);
-		ang.phi += del.at(1, 0);
-		ang.kappa += del.at(2, 0);
-		lambda += del.at(3, 0);
-		T.x += del.at(4, 0);
-		T.y += del.at(5, 0);
-		T.z += del.at(6, 0);
+	Matrix tolerances(7, 1, threshold);
+
+	report = levenbergMarquardt(*this, tolerances, options);
+
+	A = Matrix(); // formed by getA() on request
+	w = misclosureVector();
+	del = report.step;
+
+	// at the solution the residuals are the misclosures: v = f(x_hat) - l
+	v = w;
+}
+
+void AbsoluteOrientation::setSolverOptions(const SolverOptions &options) {
+	this->options = options;
+}
 
-		M.rotate(ang);
-	} while (del.maxAbsElem() > threshold);
+void AbsoluteOrientation::setParameterization(RotationParameterization parameterization) {
+	// the angles are not kept up to date by the local parameterizations
+	if (parameterization == RotationParameterization::Angles && this->parameterization != parameterization)
+		ang = M.getAngles();
+	this->parameterization = parameterization;
+}
 
-	v = residuals(A, del, w);
+Matrix AbsoluteOrientation::designMatrix() {
+	return absoluteA();
+}
+
+/*
+ * The X, Y and Z rows of point i (r = 0, 1, 2) are
+ *
+ * a_ir = [lambda * D_0[r] * pm, lambda * D_1[r] * pm, lambda * D_2[r] * pm, M[r] * pm, e_r]
+ *
+ * so every element of N and u is a row of D or M applied to weighted moments of the model
+ * points, taken separately per coordinate since the robust weights differ:
+ *
+ * S_r = sum(p_ir * pm * pm_trans), m_r = sum(p_ir * pm), W_r = sum(p_ir)
+ * g_r = sum(p_ir * w_ir * pm),		 h_r = sum(p_ir * w_ir)
+ *
+ * One pass over the points gathers the 42 sums and the 7-by-7 system is assembled from them.
+ * The sums are taken over the model points reduced to the first one, o, and expanded
+ * afterwards, so that large coordinates do not swamp the spread of the points:
+ *
+ * S_r = S'_r + o * m'_r_trans + m'_r * o_trans + W_r * o * o_trans
+ * m_r = m'_r + W_r * o, g_r = g'_r + h_r * o
+ */
+bool AbsoluteOrientation::normalEquations(const Matrix &w, const vector<double> &p, Matrix &N, Matrix &u) {
+	double S[3][6] = {}, m[3][3] = {}, W[3] = {}, g[3][3] = {}, h[3] = {};
+	std::mutex sums_mutex;
+
+	double o[3] = { 0.0, 0.0, 0.0 };
+	if (num_points > 0) {
+		o[0] = coords_model.x[0];
+		o[1] = coords_model.y[0];
+		o[2] = coords_model.z[0];
+	}
+
+	parallelFor(num_points, [&](unsigned int begin, unsigned int end) {
+		double S_local[3][6] = {}, m_local[3][3] = {}, W_local[3] = {}, g_local[3][3] = {}, h_local[3] = {};
+
+		for (unsigned int i = begin; i < end; i++) {
+			const Point3D pm(coords_model.x[i] - o[0], coords_model.y[i] - o[1], coords_model.z[i] - o[2]);
+			double xx = pm.x * pm.x, xy = pm.x * pm.y, xz = pm.x * pm.z;
+			double yy = pm.y * pm.y, yz = pm.y * pm.z, zz = pm.z * pm.z;
+
+			for (unsigned int r = 0; r < 3; r++) {
+				double pr = p[3 * i + r];
+				if (pr == 0.0)
+					continue;
+
+				double *Sr = S_local[r];
+				Sr[0] += pr * xx;
+				Sr[1] += pr * xy;
+				Sr[2] += pr * xz;
+				Sr[3] += pr * yy;
+				Sr[4] += pr * yz;
+				Sr[5] += pr * zz;
+
+				m_local[r][0] += pr * pm.x;
+				m_local[r][1] += pr * pm.y;
+				m_local[r][2] += pr * pm.z;
+				W_local[r] += pr;
+
+				double pw = pr * w.at(3 * i + r, 0);
+				g_local[r][0] += pw * pm.x;
+				g_local[r][1] += pw * pm.y;
+				g_local[r][2] += pw * pm.z;
+				h_local[r] += pw;
+			}
+		}
+
+		std::lock_guard<std::mutex> lock(sums_mutex);
+		for (unsigned int r = 0; r < 3; r++) {
+			for (unsigned int k = 0; k < 6; k++)
+				S[r][k] += S_local[r][k];
+			for (unsigned int k = 0; k < 3; k++) {
+				m[r][k] += m_local[r][k];
+				g[r][k] += g_local[r][k];
+			}
+			W[r] += W_local[r];
+			h[r] += h_local[r];
+		}
+	}, 0, 65536);
+
+	for (unsigned int r = 0; r < 3; r++) {
+		// the upper triangle of S_r in the order xx, xy, xz, yy, yz, zz
+		static const unsigned int row[6] = { 0, 0, 0, 1, 1, 2 }, col[6] = { 0, 1, 2, 1, 2, 2 };
+		for (unsigned int k = 0; k < 6; k++) {
+			unsigned int i = row[k], j = col[k];
+			S[r][k] += o[i] * m[r][j] + m[r][i] * o[j] + W[r] * o[i] * o[j];
+		}
+
+		for (unsigned int k = 0; k < 3; k++) {
+			m[r][k] += W[r] * o[k];
+			g[r][k] += h[r] * o[k];
+		}
+	}
+
+	// c[r][a] * pm is the element of row r in column a, for the rotation and scale columns
+	double D[27];
+	rotationPartials(D);
+
+	double c[3][4][3];
+	for (unsigned int r = 0; r < 3; r++) {
+		for (unsigned int a = 0; a < 3; a++)
+			for (unsigned int k = 0; k < 3; k++)
+				c[r][a][k] = lambda * D[9 * a + 3 * r + k];
+		for (unsigned int k = 0; k < 3; k++)
+			c[r][3][k] = M.at(r, k);
+	}
+
+	N = Matrix(7, 7);
+	u = Matrix(7, 1);
+
+	for (unsigned int r = 0; r < 3; r++) {
+		const double *Sr = S[r];
+		for (unsigned int a = 0; a < 4; a++) {
+			const double *ca = c[r][a];
+
+			// S_r * c_a
+			double Sc[3] = {
+				Sr[0] * ca[0] + Sr[1] * ca[1] + Sr[2] * ca[2],
+				Sr[1] * ca[0] + Sr[3] * ca[1] + Sr[4] * ca[2],
+				Sr[2] * ca[0] + Sr[4] * ca[1] + Sr[5] * ca[2] };
+
+			for (unsigned int b = a; b < 4; b++) {
+				const double *cb = c[r][b];
+				N[a][b] += cb[0] * Sc[0] + cb[1] * Sc[1] + cb[2] * Sc[2];
+			}
+
+			N[a][4 + r] = ca[0] * m[r][0] + ca[1] * m[r][1] + ca[2] * m[r][2];
+			u[a][0] += ca[0] * g[r][0] + ca[1] * g[r][1] + ca[2] * g[r][2];
+		}
+
+		N[4 + r][4 + r] = W[r];
+		u[4 + r][0] = h[r];
+	}
+
+	for (unsigned int a = 0; a < 7; a++)
+		for (unsigned int b = 0; b < a; b++)
+			N[a][b] = N[b][a];
+
+	return true;
+}
+
+void AbsoluteOrientation::rotationPartials(double *D) {
+	if (parameterization != RotationParameterization::Angles) {
+		// D_k = E_k * M, where E_k * P is the change of P = M * pm under the local increment k
+		for (unsigned int k = 0; k < 3; k++) {
+			D[k] = 0;
+			D[3 + k] = M.at(2, k);
+			D[6 + k] = -M.at(1, k);
+
+			D[9 + k] = -M.at(2, k);
+			D[12 + k] = 0;
+			D[15 + k] = M.at(0, k);
+
+			D[18 + k] = M.at(1, k);
+			D[21 + k] = -M.at(0, k);
+			D[24 + k] = 0;
+		}
+		return;
+	}
+
+	double so = sin(M.getOmega()), co = cos(M.getOmega());
+	double sp = sin(M.getPhi()), cp = cos(M.getPhi());
+	double sk = sin(M.getKappa()), ck = cos(M.getKappa());
+
+	// d/d(omega)
+	D[0] = 0;
+	D[1] = -so * sk + co * sp * ck;
+	D[2] = co * sk + so * sp * ck;
+	D[3] = 0;
+	D[4] = -so * ck - co * sp * sk;
+	D[5] = co * ck - so * sp * sk;
+	D[6] = 0;
+	D[7] = -co * cp;
+	D[8] = -so * cp;
+
+	// d/d(phi)
+	D[9] = -sp * ck;
+	D[10] = so * cp * ck;
+	D[11] = -co * cp * ck;
+	D[12] = sp * sk;
+	D[13] = -so * cp * sk;
+	D[14] = co * cp * sk;
+	D[15] = cp;
+	D[16] = so * sp;
+	D[17] = -co * sp;
+
+	// d/d(kappa)
+	D[18] = -cp * sk;
+	D[19] = co * ck - so * sp * sk;
+	D[20] = so * ck + co * sp * sk;
+	D[21] = -cp * ck;
+	D[22] = -co * sk - so * sp * ck;
+	D[23] = -so * sk + co * sp * ck;
+	D[24] = 0;
+	D[25] = 0;
+	D[26] = 0;
+}
+
+Matrix AbsoluteOrientation::misclosureVector() {
+	// w = f(x) - l, formed in the vector of estimates
+	Matrix w = absoluteCond();
+	for (unsigned int i = 0; i < 3 * num_points; i++)
+		w[i][0] -= obs[i][0];
+	return w;
+}
+
+vector<double> AbsoluteOrientation::observationWeights(const Matrix &w) {
+	if (loss != NULL)
+		weights = robustWeights(w, *loss);
+
+	return weights;
+}
+
+Matrix AbsoluteOrientation::getParameters() {
+	unsigned int k = rotationParameters(parameterization);
+
+	Matrix x(k + 4, 1);
+	getRotation(parameterization, ang, q, x, 0);
+	x[k][0] = lambda;
+	x[k + 1][0] = T.x;
+	x[k + 2][0] = T.y;
+	x[k + 3][0] = T.z;
+	return x;
+}
+
+void AbsoluteOrientation::setParameters(const Matrix &x) {
+	unsigned int k = rotationParameters(parameterization);
+
+	setRotation(parameterization, x, 0, ang, q, M);
+	lambda = x.at(k, 0);
+	T.x = x.at(k + 1, 0);
+	T.y = x.at(k + 2, 0);
+	T.z = x.at(k + 3, 0);
+}
+
+void AbsoluteOrientation::update(const Matrix &del) {
+	updateRotation(parameterization, del, 0, ang, q, M);
+	lambda += del.at(3, 0);
+	T.x += del.at(4, 0);
+	T.y += del.at(5, 0);
+	T.z += del.at(6, 0);
 }
 
 Matrix AbsoluteOrientation::absoluteA() {
@@ -42,18 +301,24 @@ Matrix AbsoluteOrientation::absoluteA() {
 
 	Point3D pm;
 
+	if (parameterization != RotationParameterization::Angles) {
+		for (unsigned int i = 0; i < num_points; i++)
+			computeRowsLocal(A, 3 * i, Point3D(coords_model.x[i], coords_model.y[i], coords_model.z[i]));
+		return A;
+	}
+
 	double omega = M.getOmega();
 	double phi = M.getPhi();
 	double kappa = M.getKappa();
 
+	// define sine and cosine values for omega, phi, and kappa
+	// so to reduce computation time
+	vector<double> sin_vals = { sin(omega), sin(phi), sin(kappa) };
+	vector<double> cos_vals = { cos(omega), cos(phi), cos(kappa) };
+
 	for (unsigned int i = 0; i < num_points; i++) {
-		pm = coords_model[i];
+		pm = Point3D(coords_model.x[i], coords_model.y[i], coords_model.z[i]);
 
-		// define sine and cosine values for omega, phi, and kappa
-		// so to reduce computation time
-		vector<double> sin_vals = { sin(omega), sin(phi), sin(kappa) };
-		vector<double> cos_vals = { cos(omega), cos(phi), cos(kappa) };
-		
 		computeRowX(A, 3 * i, pm, sin_vals, cos_vals);
 		computeRowY(A, 3 * i + 1, pm, sin_vals, cos_vals);
 		computeRowZ(A, 3 * i + 2, pm, sin_vals, cos_vals);
@@ -66,15 +331,17 @@ Matrix AbsoluteOrientation::absoluteCond() {
 
 	Matrix cond(num_points * 3, 1);
 
-	Point3D pm;
+	// scaled rotation lambda * M, applied without copying the points
+	double r[9];
+	for (unsigned int i = 0; i < 3; i++)
+		for (unsigned int j = 0; j < 3; j++)
+			r[3 * i + j] = lambda * M.at(i, j);
 
+	const double *x = coords_model.x.data(), *y = coords_model.y.data(), *z = coords_model.z.data();
 	for (unsigned int i = 0; i < num_points; i++) {
-		pm = coords_model[i];
-		pm.transform(lambda, M, T);
-
-		cond.at(3 * i, 0) = pm.x;
-		cond.at(3 * i + 1, 0) = pm.y;
-		cond.at(3 * i + 2, 0) = pm.z;
+		cond[3 * i][0] = r[0] * x[i] + r[1] * y[i] + r[2] * z[i] + T.x;
+		cond[3 * i + 1][0] = r[3] * x[i] + r[4] * y[i] + r[5] * z[i] + T.y;
+		cond[3 * i + 2][0] = r[6] * x[i] + r[7] * y[i] + r[8] * z[i] + T.z;
 	}
 
 	return cond;
@@ -135,7 +402,33 @@ void AbsoluteOrientation::computeRowZ(Matrix &A, int row, const Point3D pm, cons
 	A.at(row, 6) = 1;
 }
 
+void AbsoluteOrientation::computeRowsLocal(Matrix &A, int row, const Point3D &pm) {
+	double px = M.at(0, 0) * pm.x + M.at(0, 1) * pm.y + M.at(0, 2) * pm.z;
+	double py = M.at(1, 0) * pm.x + M.at(1, 1) * pm.y + M.at(1, 2) * pm.z;
+	double pz = M.at(2, 0) * pm.x + M.at(2, 1) * pm.y + M.at(2, 2) * pm.z;
+
+	A.at(row, 0) = 0;
+	A.at(row, 1) = -lambda * pz;
+	A.at(row, 2) = lambda * py;
+	A.at(row, 3) = px;
+	A.at(row, 4) = 1;
+
+	A.at(row + 1, 0) = lambda * pz;
+	A.at(row + 1, 1) = 0;
+	A.at(row + 1, 2) = -lambda * px;
+	A.at(row + 1, 3) = py;
+	A.at(row + 1, 5) = 1;
+
+	A.at(row + 2, 0) = -lambda * py;
+	A.at(row + 2, 1) = lambda * px;
+	A.at(row + 2, 2) = 0;
+	A.at(row + 2, 3) = pz;
+	A.at(row + 2, 6) = 1;
+}
+
 Matrix AbsoluteOrientation::getA() {
+	if (A.getrows() == 0)
+		A = absoluteA();
 	return A;
 }
 
@@ -151,12 +444,20 @@ Matrix AbsoluteOrientation::getResiduals() {
 	return v;
 }
 
+vector<double> AbsoluteOrientation::getWeights() {
+	return weights;
+}
+
+SolverReport AbsoluteOrientation::getReport() {
+	return report;
+}
+
 vector<Point3D> AbsoluteOrientation::getObjectCoords() {
-	return coords_object;
+	return coords_object.toPoints();
 }
 
 vector<Point3D> AbsoluteOrientation::getModelCoords() {
-	return coords_model;
+	return coords_model.toPoints();
 }
 
 RotationMatrix AbsoluteOrientation::getM() {
@@ -2,9 +2,13 @@
 
 #include "RotationMatrix.h"
 #include "LeastSquares.h"
+#include "Adjustment.h"
+#include "RobustLoss.h"
 #include "Point.h"
+#include "PointCloud.h"
+#include "Quaternion.h"
 
-class AbsoluteOrientation {
+class AbsoluteOrientation : public Adjustment {
 public:
 	/** AbsoluteOrientation
 	 * the constructor of this class; sets up the object and model coordinates, respectively
@@ -13,9 +17,11 @@ public:
 	 * @param coords_model	- the model coordinates of the selected points
 	 */
 	AbsoluteOrientation(const vector<Point3D> &coords_object, const vector<Point3D> &coords_model);
+	AbsoluteOrientation(const PointCloud3D &coords_object, const PointCloud3D &coords_model);
 
 	/** computeOrientation
-	 * Computes all parameters in the absolute orientation adjustment
+	 * Computes all parameters in the absolute orientation adjustment with the damped
+	 * least-squares solver; the outcome of the iterations is available from getReport()
 	 * 
 	 * @param _T	  - the point of expansion for the translation vector
 	 * @param _ang	  - the point of expansion for the rotation angles
@@ -23,6 +29,26 @@ public:
 	 */
 	void computeOrientation(const Point3D &_T, const Angles &_ang, double _lambda);
 
+	/** setSolverOptions
+	 * sets the iteration cap and damping of the solver used by computeOrientation
+	 */
+	void setSolverOptions(const SolverOptions &options);
+
+	/** setParameterization
+	 * selects how the rotation is parameterized by computeOrientation; with Quaternion or
+	 * Rodrigues the rotation increments are local small angles, see Quaternion.h
+	 */
+	void setParameterization(RotationParameterization parameterization);
+
+	/** setRobustLoss
+	 * switches the adjustment into an iteratively reweighted least-squares (IRLS) mode;
+	 * after the first iteration the observation weights are updated from the misclosures
+	 * using the given loss. Passing NULL restores the unweighted adjustment
+	 *
+	 * @param loss - the robust loss function (not owned; must outlive the adjustment)
+	 */
+	void setRobustLoss(const RobustLoss *loss);
+
 	Matrix getA();
 	Matrix getMisclosure();
 	Matrix getDelta();
@@ -31,20 +57,44 @@ public:
 	vector<Point3D> getObjectCoords();
 	vector<Point3D> getModelCoords();
 
+	vector<double> getWeights();
+	SolverReport getReport();
+
 	RotationMatrix getM();
 	Point3D getT();
 	double getScale();
+
+	// Adjustment interface; parameters are [omega, phi, kappa, lambda, Tx, Ty, Tz], or the
+	// quaternion or rotation vector in place of the angles (see setParameterization)
+	Matrix designMatrix();
+	Matrix misclosureVector();
+	vector<double> observationWeights(const Matrix &w);
+	bool normalEquations(const Matrix &w, const vector<double> &p, Matrix &N, Matrix &u);
+	Matrix getParameters();
+	void setParameters(const Matrix &x);
+	void update(const Matrix &del);
 private:
 	Matrix A, w, del, v;
+	Matrix obs; // 3n-by-1 vector of object space observations
+
+	SolverOptions options;
+	SolverReport report;
+
+	const RobustLoss *loss; // NULL for an unweighted adjustment
+	vector<double> weights;  // diagonal of the weight matrix
 
 	unsigned int num_points;
-	vector<Point3D> coords_object;
-	vector<Point3D> coords_model;
+	PointCloud3D coords_object;
+	PointCloud3D coords_model;
 
 	RotationMatrix M; // rotates from model to object space
+	Angles ang;		  // rotation angles of M (with the Angles parameterization only)
+	Quaternion q;	  // rotation of M for the local parameterizations
 	Point3D T;		  // translation vector from object to model space
 	double lambda;	  // scale from model to object space
 
+	RotationParameterization parameterization;
+
 	/** absoluteA
 	 * Determines a 3n-by-7 design matrix for an absolute orientation LS
 	 * 
@@ -113,4 +163,23 @@ private:
 	 * @param cosv - a vector containing all the cosine values in order of cos{omega, phi, kappa}
 	 */
 	void computeRowZ(Matrix &A, int row, const Point3D pm, const vector<double> &sinv, const vector<double> &cosv);
+
+	/** rotationPartials
+	 * the partial derivatives of the rotated model point M * pm with respect to the three
+	 * rotation unknowns, as matrices: d(M * pm) / d(r_a) = D_a * pm, row-major in
+	 * D[9 * a, 9 * a + 9). Computed once per iteration for all points
+	 *
+	 * @param D - 27 elements; the matrices for omega, phi, kappa (or the local increments)
+	 */
+	void rotationPartials(double *D);
+
+	/** computeRowsLocal
+	 * updates the X, Y and Z rows of the design matrix for the local rotation increments;
+	 * with P = M * pm the rotation columns are lambda * [P]x
+	 *
+	 * @param A	  - the current design matrix being calculated (manipulated)
+	 * @param row - the X row; the Y and Z rows follow it
+	 * @param pm  - the model point of the rows
+	 */
+	void computeRowsLocal(Matrix &A, int row, const Point3D &pm);
 };
\ No newline at end of file
@@ -0,0 +1,199 @@
+#include "Adjustment.h"
+
+vector<double> Adjustment::observationWeights(const Matrix &w) {
+	return vector<double>(w.getrows(), 1.0);
+}
+
+bool Adjustment::normalEquations(const Matrix & /*w*/, const vector<double> & /*p*/, Matrix & /*N*/, Matrix & /*u*/) {
+	return false;
+}
+
+// w_trans * P * w with a diagonal P
+static double weightedCost(const Matrix &w, const vector<double> &p) {
+	double cost = 0.0;
+	for (unsigned int i = 0; i < w.getrows(); i++)
+		cost += p[i] * w.at(i, 0) * w.at(i, 0);
+	return cost;
+}
+
+/*
+ * solves (N + damping * diag(N)) * del = -u by a Cholesky decomposition; false if the
+ * damped matrix is not positive definite or N and u are not finite
+ */
+static bool dampedStep(const Matrix &N, const Matrix &u, double damping, Matrix &del) {
+	unsigned int n = N.getrows();
+	vector<double> L(n * n, 0.0);
+
+	for (unsigned int i = 0; i < n; i++) {
+		for (unsigned int j = 0; j <= i; j++) {
+			double s = N.at(i, j);
+			if (i == j)
+				s += damping * ((N.at(i, i) > 0.0) ? N.at(i, i) : 1.0);
+			for (unsigned int k = 0; k < j; k++)
+				s -= L[i * n + k] * L[j * n + k];
+
+			if (i == j) {
+				if (!(s > 0.0) || !std::isfinite(s))
+					return false;
+				L[i * n + i] = sqrt(s);
+			}
+			else
+				L[i * n + j] = s / L[j * n + j];
+		}
+	}
+
+	// L * y = -u, then L_trans * del = y
+	vector<double> y(n);
+	for (unsigned int i = 0; i < n; i++) {
+		double s = -u.at(i, 0);
+		for (unsigned int k = 0; k < i; k++)
+			s -= L[i * n + k] * y[k];
+		y[i] = s / L[i * n + i];
+	}
+
+	del = Matrix(n, 1);
+	for (unsigned int i = n; i-- > 0;) {
+		double s = y[i];
+		for (unsigned int k = i + 1; k < n; k++)
+			s -= L[k * n + i] * del.at(k, 0);
+		del.at(i, 0) = s / L[i * n + i];
+	}
+
+	for (unsigned int i = 0; i < n; i++)
+		if (!std::isfinite(del.at(i, 0)))
+			return false;
+
+	return true;
+}
+
+// true if all elements of the matrix are finite
+static bool isFinite(const Matrix &mat) {
+	for (unsigned int i = 0; i < mat.getrows(); i++)
+		for (unsigned int j = 0; j < mat.getcols(); j++)
+			if (!std::isfinite(mat.at(i, j)))
+				return false;
+	return true;
+}
+
+// the normal matrix and vector at the current estimate of the parameters
+static void linearize(Adjustment &adj, const Matrix &w, const vector<double> &p, Matrix &N, Matrix &u) {
+	if (adj.normalEquations(w, p, N, u))
+		return;
+
+	Matrix A = adj.designMatrix();
+	N = normalMatrix(A, p);
+	u = normalVector(A, p, w);
+}
+
+SolverReport levenbergMarquardt(Adjustment &adj, const Matrix &tolerances, const SolverOptions &options) {
+	SolverReport report;
+
+	Matrix w = adj.misclosureVector();
+	vector<double> p(w.getrows(), 1.0); // first iteration is always unweighted
+
+	// N and u only change with the parameters or weights, so rejected steps reuse them
+	Matrix N, u;
+	linearize(adj, w, p, N, u);
+
+	double cost = weightedCost(w, p);
+	double damping = options.initial_damping;
+	double nu = 2.0;
+
+	report.initial_cost = cost;
+
+	while (true) {
+		if (report.iterations >= options.max_iterations) {
+			report.reason = ConvergenceReason::MaxIterations;
+			break;
+		}
+
+		// Marquardt damping scaled by the diagonal of N, so the step is invariant to
+		// the units of the parameters; an unobservable parameter still gets damped
+		Matrix del;
+		bool solved = dampedStep(N, u, damping, del);
+		report.iterations++;
+
+		if (!solved) {
+			// more damping makes a finite system positive definite; nothing repairs a NaN
+			if (!isFinite(N) || !isFinite(u)) {
+				report.reason = ConvergenceReason::SingularSystem;
+				break;
+			}
+
+			damping *= nu;
+			nu *= 2.0;
+
+			if (damping > options.max_damping) {
+				report.reason = ConvergenceReason::SingularSystem;
+				break;
+			}
+			continue;
+		}
+
+		// reduction predicted by the linearized model: |w|^2 - |w + A * del|^2
+		double predicted = -(2.0 * (del.trans() * u).at(0, 0) + (del.trans() * N * del).at(0, 0));
+
+		Matrix x = adj.getParameters();
+		adj.update(del);
+		Matrix w_new = adj.misclosureVector();
+		double cost_new = weightedCost(w_new, p);
+
+		if (std::isfinite(cost_new) && cost_new <= cost) {
+			report.accepted++;
+			report.step = del;
+
+			double rho = (predicted > 0.0) ? (cost - cost_new) / predicted : 1.0;
+			damping *= fmax(1.0 / 3.0, 1.0 - pow(2.0 * rho - 1.0, 3));
+			nu = 2.0;
+
+			w = w_new;
+			p = adj.observationWeights(w);
+			cost = weightedCost(w, p);
+
+			if (belowTolerances(del, tolerances)) {
+				report.reason = ConvergenceReason::Converged;
+				break;
+			}
+
+			linearize(adj, w, p, N, u);
+		}
+		else {
+			adj.setParameters(x);
+
+			// a negligible step that fails to reduce the cost is rounding noise at the minimum
+			if (report.accepted > 0 && belowTolerances(del, tolerances)) {
+				report.reason = ConvergenceReason::Converged;
+				break;
+			}
+
+			damping *= nu;
+			nu *= 2.0;
+
+			if (damping > options.max_damping) {
+				report.reason = ConvergenceReason::Stalled;
+				break;
+			}
+		}
+	}
+
+	report.final_cost = cost;
+	report.damping = damping;
+
+	return report;
+}
+
+string convergenceReason(ConvergenceReason reason) {
+	switch (reason) {
+	case ConvergenceReason::NotRun:
+		return "not run";
+	case ConvergenceReason::Converged:
+		return "converged";
+	case ConvergenceReason::MaxIterations:
+		return "maximum number of iterations reached";
+	case ConvergenceReason::Stalled:
+		return "stalled (no step reduces the cost)";
+	case ConvergenceReason::SingularSystem:
+		return "singular system (the normal equations cannot be solved)";
+	}
+	return "unknown";
+}
@@ -0,0 +1,121 @@
+/*
+ * The purpose of this header is to provide a common interface to the non-linear
+ * least-squares adjustments (resection, relative and absolute orientation) so that
+ * they can all be solved by the same damped (Levenberg-Marquardt) solver.
+ */
+
+#pragma once
+
+#include <string>
+#include "LeastSquares.h"
+
+enum class ConvergenceReason {
+	NotRun,			// the solver has not been run yet
+	Converged,		// all components of the last step were below their tolerances
+	MaxIterations,	// the iteration cap was reached before convergence
+	Stalled,		// no step could reduce the cost, even with maximum damping
+	SingularSystem	// the damped normal equations were not positive definite or not finite
+};
+
+struct SolverOptions {
+	unsigned int max_iterations; // cap on the number of trial steps (accepted or rejected)
+	double initial_damping;		 // initial damping, relative to the diagonal of N
+	double max_damping;			 // the solver gives up once the damping exceeds this value
+
+	SolverOptions() : max_iterations(100), initial_damping(1e-3), max_damping(1e16) {}
+	SolverOptions(unsigned int _max_iterations) :
+		max_iterations(_max_iterations), initial_damping(1e-3), max_damping(1e16) {}
+};
+
+struct SolverReport {
+	ConvergenceReason reason;
+	unsigned int iterations; // number of trial steps taken
+	unsigned int accepted;	 // number of steps that reduced the cost
+	double initial_cost;	 // w_trans * P * w at the point of expansion
+	double final_cost;		 // w_trans * P * w at the solution
+	double damping;			 // the damping at termination
+	Matrix step;			 // the last accepted delta vector
+
+	SolverReport() : reason(ConvergenceReason::NotRun), iterations(0), accepted(0),
+		initial_cost(0), final_cost(0), damping(0), step() {}
+};
+
+class Adjustment {
+public:
+	virtual ~Adjustment() {}
+
+	/** designMatrix
+	 * computes the design matrix at the current estimate of the parameters
+	 */
+	virtual Matrix designMatrix() = 0;
+
+	/** misclosureVector
+	 * computes the misclosure vector, w = f(x) - l, at the current estimate of the parameters
+	 */
+	virtual Matrix misclosureVector() = 0;
+
+	/** observationWeights
+	 * computes the diagonal weights of the observations from the current misclosures;
+	 * called after every accepted step. The default is a unit weight for all observations
+	 *
+	 * @param w - the misclosure vector at the current estimate
+	 *
+	 * @return  - the diagonal of the weight matrix
+	 */
+	virtual vector<double> observationWeights(const Matrix &w);
+
+	/** normalEquations
+	 * accumulates the normal matrix and vector at the current estimate of the parameters
+	 * directly, for adjustments whose structure allows it without forming the design
+	 * matrix. The default returns false, and the solver forms them from designMatrix()
+	 *
+	 * N = A_trans * diag(p) * A, u = A_trans * diag(p) * w
+	 *
+	 * @param w - the misclosure vector at the current estimate
+	 * @param p - the diagonal of the weight matrix
+	 * @param N - the u-by-u normal matrix
+	 * @param u - the u-by-1 normal vector
+	 *
+	 * @return  - true if N and u were computed
+	 */
+	virtual bool normalEquations(const Matrix &w, const vector<double> &p, Matrix &N, Matrix &u);
+
+	/** getParameters / setParameters
+	 * saves and restores the complete state of the parameters, used by the solver to
+	 * undo a rejected step
+	 */
+	virtual Matrix getParameters() = 0;
+	virtual void setParameters(const Matrix &x) = 0;
+
+	/** update
+	 * applies a delta vector (as returned by the normal equations) to the parameters
+	 *
+	 * @param del - the u-by-1 delta vector
+	 */
+	virtual void update(const Matrix &del) = 0;
+};
+
+/** levenbergMarquardt
+ * solves a non-linear least-squares adjustment with a damped Gauss-Newton
+ * (trust-region) method
+ *
+ * (N + damping * diag(N)) * delta = -u
+ *
+ * A step is only accepted if it reduces the weighted sum of squared misclosures;
+ * the damping is adapted from the ratio of the actual to the predicted reduction.
+ * A damped system that cannot be factored is retried with more damping, and the
+ * solver stops with SingularSystem if that does not help or N is not finite. The
+ * solver never takes more than options.max_iterations trial steps
+ *
+ * @param adj		 - the adjustment to solve; holds the solution on return
+ * @param tolerances - an u-by-1 vector of tolerances on the absolute delta values
+ * @param options	 - iteration cap and damping settings
+ *
+ * @return			 - a report on the iterations and the reason for termination
+ */
+SolverReport levenbergMarquardt(Adjustment &adj, const Matrix &tolerances, const SolverOptions &options = SolverOptions());
+
+/** convergenceReason
+ * converts a convergence reason to a readable string
+ */
+string convergenceReason(ConvergenceReason reason);
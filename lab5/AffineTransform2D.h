@@ -2,6 +2,7 @@
 
 #include "LeastSquares.h"
 #include "Point.h"
+#include "PointCloud.h"
 
 struct AffineParams {
 	double a, b, c, d;
@@ -18,8 +19,13 @@ public:
 	 *
 	 * @param coords_from - the starting coordinates for the transformation
 	 * @param coords_to	  - the expected final coordinates after the transformation
+	 * @param weights	  - the 2n weights of the observations in the order x0, y0, x1, y1, ...
+	 *						(unit weights if empty)
 	 */
-	AffineTransform2D(vector<Point2D> &coords_from, vector<Point2D> &coords_to);
+	AffineTransform2D(vector<Point2D> &coords_from, vector<Point2D> &coords_to,
+		const vector<double> &weights = vector<double>());
+	AffineTransform2D(const PointCloud2D &coords_from, const PointCloud2D &coords_to,
+		const vector<double> &weights = vector<double>());
 
 	/** setCoordinates
 	 * sets the coordinates to their respective values and computes the
@@ -27,8 +33,12 @@ public:
 	 *
 	 * @param coords_from - the starting coordinates for the transformation
 	 * @param coords_to	  - the expected final coordinates after the transformation
+	 * @param weights	  - the 2n weights of the observations (unit weights if empty)
 	 */
-	void setCoordinates(vector<Point2D> &coords_from, vector<Point2D> &coords_to);
+	void setCoordinates(vector<Point2D> &coords_from, vector<Point2D> &coords_to,
+		const vector<double> &weights = vector<double>());
+	void setCoordinates(const PointCloud2D &coords_from, const PointCloud2D &coords_to,
+		const vector<double> &weights = vector<double>());
 
 	Matrix getA();
 	Matrix getDelta();
@@ -42,13 +52,16 @@ private:
 	Matrix A, del, v;
 
 	unsigned int num_points;
-	vector<Point2D> coords_from; // considered as KNOWNS in the LS adjustment
-	vector<Point2D> coords_to;	 // considered as OBSERVATIONS in the LS adjustment
+	PointCloud2D coords_from; // considered as KNOWNS in the LS adjustment
+	PointCloud2D coords_to;	  // considered as OBSERVATIONS in the LS adjustment
+	vector<double> weights;	  // diagonal of the weight matrix (empty for unit weights)
 
 	AffineParams params;
 
 	/** computeTransformation
-	 * Computes all parameters in a linear affine transformation
+	 * Computes all parameters in a linear affine transformation from normal equations
+	 * summed directly from the points (see affineNormals); the design matrix and
+	 * residuals are only formed on request
 	 */
 	void computeTransformation();
 
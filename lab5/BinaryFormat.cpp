@@ -0,0 +1,326 @@
+#include <cstring>
+
+#include "BinaryFormat.h"
+
+static_assert(sizeof(BinaryHeader) == 64, "BinaryHeader must not be padded");
+
+static const char binary_magic[4] = { 'P', 'T', 'B', 'F' };
+
+// the format is little endian and is used in place, so the host has to be as well
+static void requireLittleEndian(const char *function) {
+	const uint16_t probe = 1;
+	if (*(const unsigned char *)&probe != 1) {
+		cout << "Error: " << function << " - The binary format requires a little-endian host" << endl;
+		exit(1);
+	}
+}
+
+static uint64_t align8(uint64_t offset) {
+	return (offset + 7) & ~(uint64_t)7;
+}
+
+static void writePadding(ofstream &outfile, uint64_t &offset) {
+	static const char zeros[8] = {};
+	uint64_t aligned = align8(offset);
+	outfile.write(zeros, aligned - offset);
+	offset = aligned;
+}
+
+static void writeBlock(ofstream &outfile, uint64_t &offset, const void *data, uint64_t bytes) {
+	outfile.write((const char *)data, bytes);
+	offset += bytes;
+}
+
+static BinaryHeader makeHeader(BinaryContent content, unsigned int columns, uint64_t rows) {
+	BinaryHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, binary_magic, 4);
+	header.version = binary_version;
+	header.content = (uint16_t)content;
+	header.columns = columns;
+	header.rows = rows;
+	return header;
+}
+
+static void openOutput(ofstream &outfile, const char *filename) {
+	outfile.open(filename, ios_base::out | ios_base::binary);
+	if (!outfile.is_open()) {
+		cout << "Error: writeBinary - Error opening file " << filename << endl;
+		exit(1);
+	}
+}
+
+// writes a cloud given by its interned ids and coordinate columns
+static void writePoints(const vector<uint32_t> &id, const vector<const vector<double> *> &coords, const IdTable &table,
+	BinaryContent content, const char *filename) {
+
+	requireLittleEndian("writeBinary");
+	uint64_t n = id.size();
+
+	// string table of only the names used, numbered in order of first use
+	vector<uint32_t> local(table.size(), IdTable::npos);
+	vector<uint32_t> ids(n);
+	vector<uint32_t> used;
+	for (uint64_t i = 0; i < n; i++) {
+		if (local[id[i]] == IdTable::npos) {
+			local[id[i]] = used.size();
+			used.push_back(id[i]);
+		}
+		ids[i] = local[id[i]];
+	}
+
+	vector<uint64_t> name_offsets(used.size() + 1, 0);
+	for (unsigned int k = 0; k < used.size(); k++)
+		name_offsets[k + 1] = name_offsets[k] + table.name(used[k]).size();
+
+	BinaryHeader header = makeHeader(content, coords.size(), n);
+	header.num_names = used.size();
+	header.names_offset = sizeof(BinaryHeader);
+	header.names_size = name_offsets.back();
+	header.ids_offset = align8(header.names_offset + name_offsets.size() * sizeof(uint64_t) + header.names_size);
+	header.data_offset = align8(header.ids_offset + n * sizeof(uint32_t));
+
+	ofstream outfile;
+	openOutput(outfile, filename);
+
+	uint64_t offset = 0;
+	writeBlock(outfile, offset, &header, sizeof(header));
+	writeBlock(outfile, offset, name_offsets.data(), name_offsets.size() * sizeof(uint64_t));
+	for (unsigned int k = 0; k < used.size(); k++) {
+		const string &name = table.name(used[k]);
+		writeBlock(outfile, offset, name.data(), name.size());
+	}
+	writePadding(outfile, offset);
+	writeBlock(outfile, offset, ids.data(), n * sizeof(uint32_t));
+	writePadding(outfile, offset);
+	for (unsigned int d = 0; d < coords.size(); d++)
+		writeBlock(outfile, offset, coords[d]->data(), n * sizeof(double));
+
+	if (!outfile) {
+		cout << "Error: writeBinary - Error writing file " << filename << endl;
+		exit(1);
+	}
+}
+
+void writeBinary(const PointCloud2D &points, const char *filename) {
+	vector<const vector<double> *> coords = { &points.x, &points.y };
+	writePoints(points.id, coords, *points.table, BinaryContent::Points2D, filename);
+}
+
+void writeBinary(const PointCloud3D &points, const char *filename, BinaryContent content) {
+	if (content != BinaryContent::Points3D && content != BinaryContent::Geodetic) {
+		cout << "Error: writeBinary - A 3D point cloud is written as Points3D or Geodetic" << endl;
+		exit(1);
+	}
+
+	vector<const vector<double> *> coords = { &points.x, &points.y, &points.z };
+	writePoints(points.id, coords, *points.table, content, filename);
+}
+
+void writeBinary(const vector<Point2D> &points, const char *filename) {
+	writeBinary(PointCloud2D(points), filename);
+}
+
+void writeBinary(const vector<Point3D> &points, const char *filename) {
+	writeBinary(PointCloud3D(points), filename);
+}
+
+void writeBinary(const vector<GeodeticPoint> &points, const char *filename) {
+	PointCloud3D cloud;
+	cloud.reserve(points.size());
+	for (const GeodeticPoint &p : points)
+		cloud.push_back(p.id, p.lat, p.lon, p.h);
+	writeBinary(cloud, filename, BinaryContent::Geodetic);
+}
+
+void writeBinary(const Matrix &M, const char *filename) {
+	requireLittleEndian("writeBinary");
+
+	BinaryHeader header = makeHeader(BinaryContent::Matrix, M.getcols(), M.getrows());
+	header.names_offset = sizeof(BinaryHeader);
+	header.ids_offset = align8(header.names_offset + sizeof(uint64_t)); // the single offset of an empty table
+	header.data_offset = header.ids_offset;
+
+	ofstream outfile;
+	openOutput(outfile, filename);
+
+	uint64_t offset = 0;
+	const uint64_t no_names = 0;
+	writeBlock(outfile, offset, &header, sizeof(header));
+	writeBlock(outfile, offset, &no_names, sizeof(no_names));
+	for (unsigned int i = 0; i < M.getrows(); i++) {
+		vector<double> row = M[i];
+		writeBlock(outfile, offset, row.data(), row.size() * sizeof(double));
+	}
+
+	if (!outfile) {
+		cout << "Error: writeBinary - Error writing file " << filename << endl;
+		exit(1);
+	}
+}
+
+bool isBinaryFile(const char *filename) {
+	ifstream infile(filename, ios_base::in | ios_base::binary);
+	char magic[4];
+	return infile.read(magic, 4) && memcmp(magic, binary_magic, 4) == 0;
+}
+
+BinaryFile::BinaryFile(const char *filename) : file(filename), header(NULL), name_offsets(NULL), name_chars(NULL) {
+	requireLittleEndian("BinaryFile");
+
+	if (file.size() < sizeof(BinaryHeader) || memcmp(file.data(), binary_magic, 4) != 0) {
+		cout << "Error: BinaryFile - " << filename << " is not a binary point file" << endl;
+		exit(1);
+	}
+
+	header = (const BinaryHeader *)file.data();
+	if (header->version != binary_version) {
+		cout << "Error: BinaryFile - Unsupported version " << header->version << " of " << filename << endl;
+		exit(1);
+	}
+	if (header->content < (uint16_t)BinaryContent::Points2D || header->content > (uint16_t)BinaryContent::Matrix) {
+		cout << "Error: BinaryFile - Unknown content in " << filename << endl;
+		exit(1);
+	}
+
+	bool points = (header->content != (uint16_t)BinaryContent::Matrix);
+	unsigned int columns = (header->content == (uint16_t)BinaryContent::Points2D) ? 2 : 3;
+	if ((points && header->columns != columns) || header->rows > file.size() || header->num_names > file.size() ||
+		header->names_size > file.size() || (uint64_t)header->columns * header->rows > file.size() / sizeof(double) ||
+		header->names_offset > file.size() || header->ids_offset > file.size() || header->data_offset > file.size()) {
+		cout << "Error: BinaryFile - Corrupt header in " << filename << endl;
+		exit(1);
+	}
+
+	// every section has to lie inside of the file and be aligned for its type
+	uint64_t names_end = header->names_offset + (header->num_names + 1) * sizeof(uint64_t) + header->names_size;
+	uint64_t ids_end = header->ids_offset + (points ? header->rows * sizeof(uint32_t) : 0);
+	uint64_t data_end = header->data_offset + header->rows * header->columns * sizeof(double);
+
+	if (header->names_offset % 8 != 0 || header->ids_offset % 8 != 0 || header->data_offset % 8 != 0 ||
+		header->names_offset < sizeof(BinaryHeader) || names_end > header->ids_offset || ids_end > header->data_offset ||
+		data_end > file.size()) {
+		cout << "Error: BinaryFile - Corrupt or truncated file " << filename << endl;
+		exit(1);
+	}
+
+	name_offsets = (const uint64_t *)(file.data() + header->names_offset);
+	name_chars = (const char *)(name_offsets + header->num_names + 1);
+}
+
+BinaryContent BinaryFile::getContent() const {
+	return (BinaryContent)header->content;
+}
+
+uint64_t BinaryFile::getRows() const {
+	return header->rows;
+}
+
+unsigned int BinaryFile::getColumns() const {
+	return header->columns;
+}
+
+void BinaryFile::requireContent(bool points, const char *function) const {
+	if ((getContent() != BinaryContent::Matrix) != points) {
+		cout << "Error: BinaryFile::" << function << " - The file does not hold " << (points ? "points" : "a matrix") << endl;
+		exit(1);
+	}
+}
+
+const double *BinaryFile::column(unsigned int col) const {
+	requireContent(true, "column");
+	if (col >= header->columns) {
+		cout << "Error: BinaryFile::column - Column " << col << " out of range" << endl;
+		exit(1);
+	}
+	return (const double *)(file.data() + header->data_offset) + col * header->rows;
+}
+
+const double *BinaryFile::values() const {
+	requireContent(false, "values");
+	return (const double *)(file.data() + header->data_offset);
+}
+
+const uint32_t *BinaryFile::ids() const {
+	requireContent(true, "ids");
+	return (const uint32_t *)(file.data() + header->ids_offset);
+}
+
+uint64_t BinaryFile::numNames() const {
+	return header->num_names;
+}
+
+string BinaryFile::name(uint64_t index) const {
+	if (index >= header->num_names || name_offsets[index] > name_offsets[index + 1] ||
+		name_offsets[index + 1] > header->names_size) {
+		cout << "Error: BinaryFile::name - Invalid name " << index << endl;
+		exit(1);
+	}
+	return string(name_chars + name_offsets[index], name_chars + name_offsets[index + 1]);
+}
+
+vector<uint32_t> BinaryFile::internNames(IdTable &table) const {
+	vector<uint32_t> interned(header->num_names);
+	for (uint64_t k = 0; k < header->num_names; k++)
+		interned[k] = table.intern(name(k));
+	return interned;
+}
+
+PointCloud2D BinaryFile::toCloud2D(std::shared_ptr<IdTable> table) const {
+	if (getContent() != BinaryContent::Points2D) {
+		cout << "Error: BinaryFile::toCloud2D - The file does not hold 2D points" << endl;
+		exit(1);
+	}
+
+	PointCloud2D points(table);
+	vector<uint32_t> interned = internNames(*points.table);
+
+	uint64_t n = header->rows;
+	const uint32_t *index = ids();
+	points.id.resize(n);
+	for (uint64_t i = 0; i < n; i++) {
+		if (index[i] >= interned.size()) {
+			cout << "Error: BinaryFile::toCloud2D - Invalid id of point " << i << endl;
+			exit(1);
+		}
+		points.id[i] = interned[index[i]];
+	}
+	points.x.assign(column(0), column(0) + n);
+	points.y.assign(column(1), column(1) + n);
+	return points;
+}
+
+PointCloud3D BinaryFile::toCloud3D(std::shared_ptr<IdTable> table) const {
+	if (getContent() != BinaryContent::Points3D && getContent() != BinaryContent::Geodetic) {
+		cout << "Error: BinaryFile::toCloud3D - The file does not hold 3D or geodetic points" << endl;
+		exit(1);
+	}
+
+	PointCloud3D points(table);
+	vector<uint32_t> interned = internNames(*points.table);
+
+	uint64_t n = header->rows;
+	const uint32_t *index = ids();
+	points.id.resize(n);
+	for (uint64_t i = 0; i < n; i++) {
+		if (index[i] >= interned.size()) {
+			cout << "Error: BinaryFile::toCloud3D - Invalid id of point " << i << endl;
+			exit(1);
+		}
+		points.id[i] = interned[index[i]];
+	}
+	points.x.assign(column(0), column(0) + n);
+	points.y.assign(column(1), column(1) + n);
+	points.z.assign(column(2), column(2) + n);
+	return points;
+}
+
+Matrix BinaryFile::toMatrix() const {
+	const double *v = values();
+
+	Matrix M(header->rows, header->columns);
+	for (unsigned int i = 0; i < M.getrows(); i++)
+		for (unsigned int j = 0; j < M.getcols(); j++)
+			M.at(i, j) = v[(uint64_t)i * M.getcols() + j];
+	return M;
+}
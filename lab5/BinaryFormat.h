@@ -0,0 +1,96 @@
+/*
+ * The purpose of this header is to store points and matrices in a compact binary file that
+ * can be used straight from a memory mapping, without a parse step. All values are little
+ * endian and every section starts on an 8-byte boundary:
+ *
+ *	 header			- BinaryHeader, 64 bytes
+ *	 string table	- num_names + 1 uint64 offsets into the characters, then the characters
+ *	 ids			- rows uint32 indices into the string table (points only)
+ *	 data			- points: one array of rows doubles per column (x, y{, z})
+ *					  matrix: rows * columns doubles, row by row
+ */
+
+#pragma once
+
+#include "PointCloud.h"
+#include "MappedFile.h"
+
+enum class BinaryContent : uint16_t {
+	Points2D = 1, // x y
+	Points3D = 2, // x y z
+	Geodetic = 3, // lat lon h
+	Matrix = 4
+};
+
+struct BinaryHeader {
+	char magic[4];			// "PTBF"
+	uint16_t version;
+	uint16_t content;		// BinaryContent
+	uint32_t columns;		// coordinates per point or matrix columns
+	uint32_t reserved;
+	uint64_t rows;			// points or matrix rows
+	uint64_t num_names;		// entries in the string table
+	uint64_t names_offset;	// byte offsets of the sections from the start of the file
+	uint64_t names_size;	// bytes of characters in the string table
+	uint64_t ids_offset;
+	uint64_t data_offset;
+};
+
+static const uint16_t binary_version = 1;
+
+/** writeBinary
+ * writes points or a matrix to a binary file; only the ids used by the points are stored
+ *
+ * @param points   - the points to write
+ * @param content  - Points3D or Geodetic for a cloud of 3D points (x=lat, y=lon, z=h)
+ * @param filename - the file to write
+ */
+void writeBinary(const PointCloud2D &points, const char *filename);
+void writeBinary(const PointCloud3D &points, const char *filename, BinaryContent content = BinaryContent::Points3D);
+void writeBinary(const vector<Point2D> &points, const char *filename);
+void writeBinary(const vector<Point3D> &points, const char *filename);
+void writeBinary(const vector<GeodeticPoint> &points, const char *filename);
+void writeBinary(const Matrix &M, const char *filename);
+
+/** isBinaryFile
+ * @return - true if the file starts with the magic of the binary format
+ */
+bool isBinaryFile(const char *filename);
+
+class BinaryFile {
+public:
+	/** BinaryFile
+	 * maps a binary file read-only and checks its header; the arrays returned below point
+	 * into the mapping and stay valid as long as this object
+	 *
+	 * @param filename - the file to open
+	 */
+	BinaryFile(const char *filename);
+
+	BinaryContent getContent() const;
+	uint64_t getRows() const;
+	unsigned int getColumns() const;
+
+	const double *column(unsigned int col) const; // the coordinates of all points (points only)
+	const double *values() const;				  // the elements row by row (matrix only)
+	const uint32_t *ids() const;				  // the string table index of all points
+
+	uint64_t numNames() const;
+	string name(uint64_t index) const;
+
+	/** toCloud2D, toCloud3D, toMatrix
+	 * copies the content into memory, interning the ids into the given table (a new one
+	 * if not given)
+	 */
+	PointCloud2D toCloud2D(std::shared_ptr<IdTable> table = std::shared_ptr<IdTable>()) const;
+	PointCloud3D toCloud3D(std::shared_ptr<IdTable> table = std::shared_ptr<IdTable>()) const;
+	Matrix toMatrix() const;
+private:
+	MappedFile file;
+	const BinaryHeader *header;
+	const uint64_t *name_offsets;
+	const char *name_chars;
+
+	void requireContent(bool points, const char *function) const;
+	vector<uint32_t> internNames(IdTable &table) const;
+};
@@ -0,0 +1,193 @@
+#include <charconv>
+#include <cstring>
+
+#include "BufferedWriter.h"
+#include "Matrix.h"
+
+BufferedWriter::BufferedWriter(const char *filename, bool append, bool async, size_t buffer_size) : out(&file), name(filename) {
+	file.open(filename, append ? (ios_base::out | ios_base::app) : ios_base::out);
+	if (!file.is_open()) {
+		cout << "Error: BufferedWriter - Error opening file " << filename << endl;
+		exit(1);
+	}
+	init(async, buffer_size);
+}
+
+BufferedWriter::BufferedWriter(std::ostream &out, bool async, size_t buffer_size) : out(&out), name("stream") {
+	init(async, buffer_size);
+}
+
+BufferedWriter::~BufferedWriter() {
+	close();
+}
+
+void BufferedWriter::init(bool _async, size_t buffer_size) {
+	buffer.resize(std::max(buffer_size, (size_t)1024));
+	used = 0;
+	pending_used = 0;
+
+	async = _async;
+	has_pending = false;
+	stop = false;
+	failed = false;
+	closed = false;
+
+	if (async) {
+		pending.resize(buffer.size());
+		worker = std::thread(&BufferedWriter::writeBehind, this);
+	}
+}
+
+void BufferedWriter::writeBehind() {
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true) {
+		cv.wait(lock, [this] { return has_pending || stop; });
+		if (!has_pending)
+			return;
+
+		// the caller does not touch the pending buffer until it is released
+		lock.unlock();
+		out->write(pending.data(), pending_used);
+		bool ok = !out->fail();
+		lock.lock();
+
+		if (!ok)
+			failed = true;
+		has_pending = false;
+		cv.notify_all();
+	}
+}
+
+void BufferedWriter::flushBuffer() {
+	if (used == 0)
+		return;
+
+	if (!async) {
+		out->write(buffer.data(), used);
+		if (out->fail())
+			failed = true;
+		used = 0;
+		return;
+	}
+
+	std::unique_lock<std::mutex> lock(mutex);
+	cv.wait(lock, [this] { return !has_pending; });
+	buffer.swap(pending);
+	pending_used = used;
+	has_pending = true;
+	used = 0;
+	cv.notify_all();
+}
+
+void BufferedWriter::reserve(size_t length) {
+	if (used + length > buffer.size())
+		flushBuffer();
+}
+
+void BufferedWriter::write(const char *text, size_t length) {
+	if (length > buffer.size()) {
+		// too long to buffer, so write it straight through after what is queued
+		flush();
+		out->write(text, length);
+		if (out->fail())
+			failed = true;
+		return;
+	}
+
+	reserve(length);
+	memcpy(buffer.data() + used, text, length);
+	used += length;
+}
+
+void BufferedWriter::write(const char *text) {
+	write(text, strlen(text));
+}
+
+void BufferedWriter::write(const std::string &text) {
+	write(text.data(), text.size());
+}
+
+void BufferedWriter::put(char c) {
+	reserve(1);
+	buffer[used++] = c;
+}
+
+void BufferedWriter::newline() {
+	put('\n');
+}
+
+void BufferedWriter::writeField(const char *text, size_t length, int width) {
+	size_t padding = (width > 0 && (size_t)width > length) ? width - length : 0;
+	if (padding + length > buffer.size()) {
+		for (size_t k = 0; k < padding; k++)
+			put(' ');
+		write(text, length);
+		return;
+	}
+
+	reserve(padding + length);
+	memset(buffer.data() + used, ' ', padding);
+	memcpy(buffer.data() + used + padding, text, length);
+	used += padding + length;
+}
+
+void BufferedWriter::writeFixed(double value, int prec, int width) {
+	char text[1024];
+	std::to_chars_result result = std::to_chars(text, text + sizeof(text) - 1, value, std::chars_format::fixed, min(prec, 500));
+	if (prec == 0 && std::isfinite(value))
+		*result.ptr++ = '.'; // showpoint
+	writeField(text, result.ptr - text, width);
+}
+
+void BufferedWriter::writeScientific(double value, int prec, int width) {
+	char text[1024];
+	std::to_chars_result result = std::to_chars(text, text + sizeof(text), value, std::chars_format::scientific, min(prec, 500));
+	writeField(text, result.ptr - text, width);
+}
+
+void BufferedWriter::writeShortest(double value, int width) {
+	char text[64];
+	std::to_chars_result result = std::to_chars(text, text + sizeof(text), value);
+	writeField(text, result.ptr - text, width);
+}
+
+void BufferedWriter::writeInteger(long long value, int width) {
+	char text[32];
+	std::to_chars_result result = std::to_chars(text, text + sizeof(text), value);
+	writeField(text, result.ptr - text, width);
+}
+
+void BufferedWriter::flush() {
+	flushBuffer();
+
+	if (async) {
+		std::unique_lock<std::mutex> lock(mutex);
+		cv.wait(lock, [this] { return !has_pending; });
+	}
+	out->flush();
+}
+
+void BufferedWriter::close() {
+	if (closed)
+		return;
+
+	flush();
+	closed = true;
+
+	if (async) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stop = true;
+		}
+		cv.notify_all();
+		worker.join();
+	}
+
+	if (file.is_open())
+		file.close();
+
+	if (failed) {
+		cout << "Error: BufferedWriter - Error writing " << name << endl;
+		exit(1);
+	}
+}
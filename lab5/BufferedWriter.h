@@ -0,0 +1,88 @@
+/*
+ * The purpose of this header is to write large text outputs (residuals, covariances, point
+ * lists) quickly. The text is collected in a large buffer and handed to the stream in one
+ * piece, and the numbers are formatted with std::to_chars instead of the stream operators.
+ * With write-behind the full buffers are written by a background thread while the caller
+ * keeps formatting into a second buffer.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class BufferedWriter {
+public:
+	/** BufferedWriter
+	 * the constructor of this class; the destructor flushes and closes the output
+	 *
+	 * @param filename	  - the file to write
+	 * @param append	  - append to the file instead of overwriting it
+	 * @param out		  - a stream to write to instead of a file (e.g. cout)
+	 * @param async		  - write the full buffers on a background thread
+	 * @param buffer_size - the size of the buffer in bytes
+	 */
+	BufferedWriter(const char *filename, bool append = false, bool async = false, size_t buffer_size = 1 << 20);
+	BufferedWriter(std::ostream &out, bool async = false, size_t buffer_size = 1 << 20);
+	~BufferedWriter();
+
+	void write(const char *text, size_t length);
+	void write(const char *text);
+	void write(const std::string &text);
+	void put(char c);
+	void newline();
+
+	/** writeFixed
+	 * writes a number with prec decimals, like an ostream with fixed and showpoint, right
+	 * aligned in a field of the given width
+	 */
+	void writeFixed(double value, int prec, int width = 0);
+
+	/** writeScientific
+	 * writes a number in scientific notation with prec decimals, right aligned in a field of
+	 * the given width
+	 */
+	void writeScientific(double value, int prec, int width = 0);
+
+	/** writeShortest
+	 * writes the shortest text that reads back as exactly the same number
+	 */
+	void writeShortest(double value, int width = 0);
+
+	void writeInteger(long long value, int width = 0);
+
+	/** flush
+	 * writes everything buffered so far to the stream
+	 */
+	void flush();
+
+	/** close
+	 * flushes, stops the background thread and closes the file; reports a failed write
+	 */
+	void close();
+private:
+	std::ofstream file;
+	std::ostream *out;
+	std::string name;
+
+	std::vector<char> buffer, pending;
+	size_t used, pending_used;
+
+	bool async, has_pending, stop, failed, closed;
+	std::thread worker;
+	std::mutex mutex;
+	std::condition_variable cv;
+
+	void init(bool _async, size_t buffer_size);
+	void reserve(size_t length);
+	void flushBuffer();
+	void writeField(const char *text, size_t length, int width);
+	void writeBehind();
+
+	BufferedWriter(const BufferedWriter &);
+	BufferedWriter &operator=(const BufferedWriter &);
+};
@@ -0,0 +1,514 @@
+#include <array>
+#include <map>
+#include "BundleAdjustment.h"
+
+// 6-by-6 camera block of the reduced normal matrix, stored row-major
+typedef std::array<double, 36> CameraBlock;
+
+// 3-by-3 inverse of a symmetric positive definite point block; false if the block is
+// singular
+static bool inverse3(const double *V, double *Vinv) {
+	double c00 = V[4] * V[8] - V[5] * V[7];
+	double c01 = V[5] * V[6] - V[3] * V[8];
+	double c02 = V[3] * V[7] - V[4] * V[6];
+	double det = V[0] * c00 + V[1] * c01 + V[2] * c02;
+
+	if (!std::isfinite(det) || fabs(det) < 1.0E-300)
+		return false;
+
+	Vinv[0] = c00 / det;
+	Vinv[1] = (V[2] * V[7] - V[1] * V[8]) / det;
+	Vinv[2] = (V[1] * V[5] - V[2] * V[4]) / det;
+	Vinv[3] = c01 / det;
+	Vinv[4] = (V[0] * V[8] - V[2] * V[6]) / det;
+	Vinv[5] = (V[2] * V[3] - V[0] * V[5]) / det;
+	Vinv[6] = c02 / det;
+	Vinv[7] = (V[1] * V[6] - V[0] * V[7]) / det;
+	Vinv[8] = (V[0] * V[4] - V[1] * V[3]) / det;
+	return true;
+}
+
+// block (row, col) of the reduced camera system, created as zero if not yet present
+static CameraBlock &blockAt(std::map<unsigned int, CameraBlock> &col, unsigned int row) {
+	std::map<unsigned int, CameraBlock>::iterator it = col.find(row);
+	if (it == col.end()) {
+		CameraBlock zero;
+		zero.fill(0.0);
+		it = col.insert(std::make_pair(row, zero)).first;
+	}
+	return it->second;
+}
+
+// scalar lower triangle of the reduced camera system in CSC form: column 6k+c holds
+// rows r >= c of the diagonal block followed by the blocks below it
+static SparseMatrix reducedSystemMatrix(const vector<std::map<unsigned int, CameraBlock> > &S) {
+	unsigned int n = 6 * S.size();
+	vector<unsigned int> col_ptr(1, 0), row_idx;
+	vector<double> vals;
+
+	for (unsigned int k = 0; k < S.size(); k++)
+		for (int c = 0; c < 6; c++) {
+			for (std::map<unsigned int, CameraBlock>::const_iterator it = S[k].begin(); it != S[k].end(); ++it) {
+				if (it->first < k)
+					continue;
+				for (int r = (it->first == k) ? c : 0; r < 6; r++) {
+					row_idx.push_back(6 * it->first + r);
+					vals.push_back(it->second[r * 6 + c]);
+				}
+			}
+			col_ptr.push_back(row_idx.size());
+		}
+
+	return SparseMatrix(n, col_ptr, row_idx, vals);
+}
+
+// the reduced camera system S applied as an operator; only the lower block triangle is stored
+class ReducedCameraOperator : public LinearOperator {
+public:
+	ReducedCameraOperator(const vector<std::map<unsigned int, CameraBlock> > &S) : S(S) {}
+
+	unsigned int size() const {
+		return 6 * S.size();
+	}
+
+	void apply(const vector<double> &x, vector<double> &y) const {
+		y.assign(6 * S.size(), 0.0);
+
+		for (unsigned int k = 0; k < S.size(); k++) {
+			const double *xk = &x[6 * k];
+			double *yk = &y[6 * k];
+
+			for (std::map<unsigned int, CameraBlock>::const_iterator it = S[k].begin(); it != S[k].end(); ++it) {
+				const CameraBlock &B = it->second;
+				const double *xi = &x[6 * it->first];
+				double *yi = &y[6 * it->first];
+
+				for (int r = 0; r < 6; r++)
+					for (int c = 0; c < 6; c++) {
+						yi[r] += B[r * 6 + c] * xk[c];
+						if (it->first != k)
+							yk[c] += B[r * 6 + c] * xi[r];
+					}
+			}
+		}
+	}
+
+	vector<double> diagonalBlocks() const {
+		vector<double> blocks(36 * S.size());
+		for (unsigned int k = 0; k < S.size(); k++) {
+			const CameraBlock &B = S[k].find(k)->second;
+			for (int a = 0; a < 36; a++)
+				blocks[36 * k + a] = B[a];
+		}
+		return blocks;
+	}
+private:
+	const vector<std::map<unsigned int, CameraBlock> > &S;
+};
+
+BundleAdjustment::BundleAdjustment() : linear_solver(LinearSolver::Cholesky), cholesky(6) {}
+
+unsigned int BundleAdjustment::addPhoto(const Point3D &T, const Angles &ang, double c) {
+	Resection photo(vector<Point3D>(), vector<Point2D>(), c);
+	photo.setOrientation(T, ang);
+
+	photos.push_back(photo);
+	angles.push_back(ang);
+
+	return photos.size() - 1;
+}
+
+unsigned int BundleAdjustment::addPoint(const Point3D &point, bool control) {
+	points.push_back(point);
+	this->control.push_back(control);
+
+	return points.size() - 1;
+}
+
+void BundleAdjustment::addObservation(unsigned int photo, unsigned int point, double x, double y) {
+	if (photo >= photos.size() || point >= points.size()) {
+		cout << "Error: BundleAdjustment::addObservation - Unknown photo or point index" << endl;
+		exit(1);
+	}
+
+	observations.push_back(ImageObservation(photo, point, x, y));
+}
+
+void BundleAdjustment::groupObservations() {
+	unsigned int num_points = points.size();
+
+	point_offsets.assign(num_points + 1, 0);
+	for (const ImageObservation &obs : observations)
+		point_offsets[obs.point + 1]++;
+
+	for (unsigned int i = 0; i < num_points; i++)
+		point_offsets[i + 1] += point_offsets[i];
+
+	point_obs.resize(observations.size());
+	vector<unsigned int> fill(point_offsets.begin(), point_offsets.end() - 1);
+	for (unsigned int k = 0; k < observations.size(); k++)
+		point_obs[fill[observations[k].point]++] = k;
+}
+
+double BundleAdjustment::buildNormals(vector<double> &U, vector<double> &V, vector<double> &W,
+	vector<double> &u_cam, vector<double> &u_pt) {
+
+	U.assign(36 * photos.size(), 0.0);
+	u_cam.assign(6 * photos.size(), 0.0);
+	V.assign(9 * points.size(), 0.0);
+	u_pt.assign(3 * points.size(), 0.0);
+	W.assign(18 * observations.size(), 0.0);
+
+	double cost = 0.0;
+
+	for (unsigned int k = 0; k < observations.size(); k++) {
+		const ImageObservation &obs = observations[k];
+		Resection &photo = photos[obs.photo];
+		const Point3D &op = points[obs.point];
+
+		Matrix B = photo.collinearityPartials(op);
+		Point2D est = photo.project(op);
+
+		double w[2] = { est.x - obs.x, est.y - obs.y };
+		cost += w[0] * w[0] + w[1] * w[1];
+
+		double *Uj = &U[36 * obs.photo];
+		double *uj = &u_cam[6 * obs.photo];
+
+		for (int r = 0; r < 2; r++) {
+			vector<double> &row = B[r];
+			for (int a = 0; a < 6; a++) {
+				uj[a] += row[a] * w[r];
+				for (int b = 0; b < 6; b++)
+					Uj[a * 6 + b] += row[a] * row[b];
+			}
+		}
+
+		if (control[obs.point])
+			continue;
+
+		// point partials are the negated translation partials
+		double *Vi = &V[9 * obs.point];
+		double *ui = &u_pt[3 * obs.point];
+		double *Wk = &W[18 * k];
+
+		for (int r = 0; r < 2; r++) {
+			vector<double> &row = B[r];
+			for (int a = 0; a < 3; a++) {
+				ui[a] -= row[a] * w[r];
+				for (int b = 0; b < 3; b++)
+					Vi[a * 3 + b] += row[a] * row[b];
+				for (int b = 0; b < 6; b++)
+					Wk[b * 3 + a] -= row[b] * row[a];
+			}
+		}
+	}
+
+	return cost;
+}
+
+double BundleAdjustment::computeCost() {
+	double cost = 0.0;
+
+	for (const ImageObservation &obs : observations) {
+		Point2D est = photos[obs.photo].project(points[obs.point]);
+		cost += (est.x - obs.x) * (est.x - obs.x) + (est.y - obs.y) * (est.y - obs.y);
+	}
+
+	return cost;
+}
+
+bool BundleAdjustment::solveReduced(const vector<double> &U, const vector<double> &V, const vector<double> &W,
+	const vector<double> &u_cam, const vector<double> &u_pt, double damping,
+	vector<double> &d_cam, vector<double> &d_pt) {
+
+	unsigned int num_photos = photos.size();
+	unsigned int num_points = points.size();
+
+	// reduced camera system in block-column form: S[col][row] for row >= col
+	vector<std::map<unsigned int, CameraBlock> > S(num_photos);
+	vector<double> rhs(u_cam);
+
+	for (unsigned int j = 0; j < num_photos; j++) {
+		CameraBlock &Sjj = S[j][j];
+		for (int a = 0; a < 36; a++)
+			Sjj[a] = U[36 * j + a];
+		for (int a = 0; a < 6; a++)
+			Sjj[a * 6 + a] += damping * ((U[36 * j + a * 6 + a] > 0.0) ? U[36 * j + a * 6 + a] : 1.0);
+	}
+
+	// eliminate the tie points: S -= W * V^-1 * W_trans, rhs -= W * V^-1 * u_pt
+	vector<double> Vinv(9 * num_points, 0.0);
+	vector<double> Y; // W_k * V^-1 for all observations of the current point
+
+	for (unsigned int i = 0; i < num_points; i++) {
+		if (control[i] || point_offsets[i] == point_offsets[i + 1])
+			continue;
+
+		double Vd[9];
+		for (int a = 0; a < 9; a++)
+			Vd[a] = V[9 * i + a];
+		for (int a = 0; a < 3; a++)
+			Vd[a * 3 + a] += damping * ((V[9 * i + a * 3 + a] > 0.0) ? V[9 * i + a * 3 + a] : 1.0);
+
+		double *Vi_inv = &Vinv[9 * i];
+		if (!inverse3(Vd, Vi_inv))
+			return false;
+
+		unsigned int begin = point_offsets[i];
+		unsigned int count = point_offsets[i + 1] - begin;
+		Y.assign(18 * count, 0.0);
+
+		for (unsigned int a = 0; a < count; a++) {
+			unsigned int k = point_obs[begin + a];
+			const double *Wk = &W[18 * k];
+			double *Ya = &Y[18 * a];
+
+			for (int r = 0; r < 6; r++)
+				for (int c = 0; c < 3; c++)
+					Ya[r * 3 + c] = Wk[r * 3] * Vi_inv[c] + Wk[r * 3 + 1] * Vi_inv[3 + c] + Wk[r * 3 + 2] * Vi_inv[6 + c];
+
+			unsigned int ja = observations[k].photo;
+			for (int r = 0; r < 6; r++)
+				rhs[6 * ja + r] -= Ya[r * 3] * u_pt[3 * i] + Ya[r * 3 + 1] * u_pt[3 * i + 1] + Ya[r * 3 + 2] * u_pt[3 * i + 2];
+		}
+
+		for (unsigned int a = 0; a < count; a++) {
+			unsigned int ja = observations[point_obs[begin + a]].photo;
+			const double *Ya = &Y[18 * a];
+
+			for (unsigned int b = 0; b < count; b++) {
+				unsigned int kb = point_obs[begin + b];
+				unsigned int jb = observations[kb].photo;
+				if (ja < jb)
+					continue;
+
+				const double *Wb = &W[18 * kb];
+				CameraBlock &Sab = blockAt(S[jb], ja);
+				for (int r = 0; r < 6; r++)
+					for (int c = 0; c < 6; c++)
+						Sab[r * 6 + c] -= Ya[r * 3] * Wb[c * 3] + Ya[r * 3 + 1] * Wb[c * 3 + 1] + Ya[r * 3 + 2] * Wb[c * 3 + 2];
+			}
+		}
+	}
+
+	if (linear_solver == LinearSolver::ConjugateGradient) {
+		// warm start from the photo deltas of the previous iteration
+		d_cam = d_cam_prev;
+		for (unsigned int a = 0; a < rhs.size(); a++)
+			rhs[a] = -rhs[a];
+
+		ReducedCameraOperator op(S);
+		BlockJacobiPreconditioner M(op.diagonalBlocks(), 6 * num_photos, 6);
+		cg_report = conjugateGradient(op, rhs, d_cam, M, cg_options);
+	}
+	else {
+		// the pattern of S is fixed by the observations, so the ordering and symbolic
+		// analysis of the first iteration are reused by every later factorization
+		if (!cholesky.factorize(reducedSystemMatrix(S)))
+			return false;
+		d_cam = cholesky.solve(rhs);
+		for (unsigned int a = 0; a < d_cam.size(); a++)
+			d_cam[a] = -d_cam[a];
+	}
+	d_cam_prev = d_cam;
+
+	// back-substitute the tie points: d_pt = -V^-1 * (u_pt + W_trans * d_cam)
+	d_pt.assign(3 * num_points, 0.0);
+	for (unsigned int i = 0; i < num_points; i++) {
+		if (control[i] || point_offsets[i] == point_offsets[i + 1])
+			continue;
+
+		double t[3] = { u_pt[3 * i], u_pt[3 * i + 1], u_pt[3 * i + 2] };
+		for (unsigned int a = point_offsets[i]; a < point_offsets[i + 1]; a++) {
+			unsigned int k = point_obs[a];
+			const double *Wk = &W[18 * k];
+			const double *dc = &d_cam[6 * observations[k].photo];
+			for (int c = 0; c < 3; c++)
+				for (int r = 0; r < 6; r++)
+					t[c] += Wk[r * 3 + c] * dc[r];
+		}
+
+		const double *Vi_inv = &Vinv[9 * i];
+		for (int r = 0; r < 3; r++)
+			d_pt[3 * i + r] = -(Vi_inv[r * 3] * t[0] + Vi_inv[r * 3 + 1] * t[1] + Vi_inv[r * 3 + 2] * t[2]);
+	}
+
+	return true;
+}
+
+void BundleAdjustment::applyDelta(const vector<double> &d_cam, const vector<double> &d_pt) {
+	for (unsigned int j = 0; j < photos.size(); j++) {
+		const double *d = &d_cam[6 * j];
+		Point3D T = photos[j].getT();
+
+		T.x += d[0];
+		T.y += d[1];
+		T.z += d[2];
+		angles[j].omega += d[3];
+		angles[j].phi += d[4];
+		angles[j].kappa += d[5];
+
+		photos[j].setOrientation(T, angles[j]);
+	}
+
+	for (unsigned int i = 0; i < points.size(); i++) {
+		points[i].x += d_pt[3 * i];
+		points[i].y += d_pt[3 * i + 1];
+		points[i].z += d_pt[3 * i + 2];
+	}
+}
+
+void BundleAdjustment::computeAdjustment(double threshold) {
+	groupObservations();
+
+	report = SolverReport();
+	cg_report = CGReport();
+	d_cam_prev.clear();
+
+	vector<double> U, V, W, u_cam, u_pt, d_cam, d_pt;
+
+	double cost = buildNormals(U, V, W, u_cam, u_pt);
+	double damping = options.initial_damping;
+	double nu = 2.0;
+
+	report.initial_cost = cost;
+
+	while (true) {
+		if (report.iterations >= options.max_iterations) {
+			report.reason = ConvergenceReason::MaxIterations;
+			break;
+		}
+
+		bool solved = solveReduced(U, V, W, u_cam, u_pt, damping, d_cam, d_pt);
+		report.iterations++;
+
+		// a damped system that cannot be solved counts as a rejected step
+		if (!solved) {
+			damping *= nu;
+			nu *= 2.0;
+
+			if (damping > options.max_damping) {
+				report.reason = ConvergenceReason::SingularSystem;
+				break;
+			}
+			continue;
+		}
+
+		// reduction predicted by the linearized model: -d_trans * u + damping * d_trans * diag(N) * d
+		double predicted = 0.0;
+		double max_delta = 0.0;
+		for (unsigned int j = 0; j < photos.size(); j++)
+			for (int a = 0; a < 6; a++) {
+				double d = d_cam[6 * j + a];
+				double n = U[36 * j + a * 6 + a];
+				predicted += -d * u_cam[6 * j + a] + damping * ((n > 0.0) ? n : 1.0) * d * d;
+				max_delta = fmax(max_delta, fabs(d));
+			}
+		for (unsigned int i = 0; i < points.size(); i++)
+			for (int a = 0; a < 3; a++) {
+				double d = d_pt[3 * i + a];
+				double n = V[9 * i + a * 3 + a];
+				predicted += -d * u_pt[3 * i + a] + damping * ((n > 0.0) ? n : 1.0) * d * d;
+				max_delta = fmax(max_delta, fabs(d));
+			}
+
+		vector<Angles> angles_saved = angles;
+		vector<Point3D> points_saved = points;
+		vector<Point3D> T_saved;
+		for (unsigned int j = 0; j < photos.size(); j++)
+			T_saved.push_back(photos[j].getT());
+
+		applyDelta(d_cam, d_pt);
+		double cost_new = computeCost();
+
+		if (std::isfinite(cost_new) && cost_new <= cost) {
+			report.accepted++;
+
+			double rho = (predicted > 0.0) ? (cost - cost_new) / predicted : 1.0;
+			damping *= fmax(1.0 / 3.0, 1.0 - pow(2.0 * rho - 1.0, 3));
+			nu = 2.0;
+
+			cost = buildNormals(U, V, W, u_cam, u_pt);
+
+			if (max_delta < threshold) {
+				report.reason = ConvergenceReason::Converged;
+				break;
+			}
+		}
+		else {
+			angles = angles_saved;
+			points = points_saved;
+			for (unsigned int j = 0; j < photos.size(); j++)
+				photos[j].setOrientation(T_saved[j], angles[j]);
+
+			if (report.accepted > 0 && max_delta < threshold) {
+				report.reason = ConvergenceReason::Converged;
+				break;
+			}
+
+			damping *= nu;
+			nu *= 2.0;
+
+			if (damping > options.max_damping) {
+				report.reason = ConvergenceReason::Stalled;
+				break;
+			}
+		}
+	}
+
+	report.final_cost = cost;
+	report.damping = damping;
+
+	v.resize(2 * observations.size(), 1);
+	for (unsigned int k = 0; k < observations.size(); k++) {
+		Point2D est = photos[observations[k].photo].project(points[observations[k].point]);
+		v[2 * k][0] = est.x - observations[k].x;
+		v[2 * k + 1][0] = est.y - observations[k].y;
+	}
+}
+
+void BundleAdjustment::setSolverOptions(const SolverOptions &options) {
+	this->options = options;
+}
+
+void BundleAdjustment::setLinearSolver(LinearSolver solver, const CGOptions &cg_options) {
+	this->linear_solver = solver;
+	this->cg_options = cg_options;
+}
+
+CGReport BundleAdjustment::getCGReport() {
+	return cg_report;
+}
+
+SolverReport BundleAdjustment::getReport() {
+	return report;
+}
+
+unsigned int BundleAdjustment::getNumPhotos() {
+	return photos.size();
+}
+
+unsigned int BundleAdjustment::getNumPoints() {
+	return points.size();
+}
+
+RotationMatrix BundleAdjustment::getM(unsigned int photo) {
+	return photos.at(photo).getM();
+}
+
+Point3D BundleAdjustment::getT(unsigned int photo) {
+	return photos.at(photo).getT();
+}
+
+Point3D BundleAdjustment::getPoint(unsigned int point) {
+	return points.at(point);
+}
+
+vector<Point3D> BundleAdjustment::getPoints() {
+	return points;
+}
+
+Matrix BundleAdjustment::getResiduals() {
+	return v;
+}
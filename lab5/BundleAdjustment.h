@@ -0,0 +1,142 @@
+#pragma once
+
+#include "Adjustment.h"
+#include "Camera.h"
+#include "ConjugateGradient.h"
+#include "Resection.h"
+#include "SparseCholesky.h"
+#include "Point.h"
+
+enum class LinearSolver {
+	Cholesky,			// sparse block Cholesky decomposition of the reduced camera system
+	ConjugateGradient	// block-Jacobi preconditioned conjugate gradients, for very large blocks
+};
+
+class BundleAdjustment {
+public:
+	/** BundleAdjustment
+	 * the constructor of this class; a simultaneous adjustment of the exterior
+	 * orientation of many photos and the object coordinates of their tie points
+	 *
+	 * The datum is defined by the control points, which are held fixed; at least
+	 * three well distributed control points are required
+	 */
+	BundleAdjustment();
+
+	/** addPhoto
+	 * adds a photo with its point of expansion to the adjustment
+	 *
+	 * @param T	  - the point of expansion for the perspective centre
+	 * @param ang - the point of expansion for the rotation angles
+	 * @param c	  - the focal length of the photo
+	 *
+	 * @return	  - the index of the photo
+	 */
+	unsigned int addPhoto(const Point3D &T, const Angles &ang, double c);
+
+	/** addPoint
+	 * adds an object point to the adjustment
+	 *
+	 * @param point	  - the (approximate) object coordinates
+	 * @param control - true if the point is a fixed control point
+	 *
+	 * @return		  - the index of the point
+	 */
+	unsigned int addPoint(const Point3D &point, bool control = false);
+
+	/** addObservation
+	 * adds the image measurement of an object point in a photo
+	 */
+	void addObservation(unsigned int photo, unsigned int point, double x, double y);
+
+	/** computeAdjustment
+	 * computes all photo and tie point parameters of the bundle; the normal equations
+	 * are stored in camera-block / point-block form and the tie points are eliminated
+	 * with the Schur complement before the reduced camera system is solved
+	 *
+	 * @param threshold - the tolerance on the absolute values of all delta components
+	 */
+	void computeAdjustment(double threshold = 1e-6);
+
+	void setSolverOptions(const SolverOptions &options);
+	SolverReport getReport();
+
+	/** setLinearSolver
+	 * selects how the reduced camera system is solved in every iteration; the
+	 * conjugate gradients are warm started from the previous photo deltas
+	 *
+	 * @param solver	 - the linear solver
+	 * @param cg_options - iteration cap and tolerance of the conjugate gradients
+	 */
+	void setLinearSolver(LinearSolver solver, const CGOptions &cg_options = CGOptions());
+	CGReport getCGReport(); // conjugate gradient report of the last iteration
+
+	unsigned int getNumPhotos();
+	unsigned int getNumPoints();
+
+	RotationMatrix getM(unsigned int photo);
+	Point3D getT(unsigned int photo);
+	Point3D getPoint(unsigned int point);
+	vector<Point3D> getPoints();
+
+	Matrix getResiduals(); // 2m-by-1 vector of image residuals, in the order of the observations
+
+private:
+	vector<Resection> photos;	// per-photo exterior orientation and collinearity model
+	vector<Angles> angles;
+	vector<Point3D> points;
+	vector<bool> control;
+	vector<ImageObservation> observations;
+
+	// observations grouped by object point (CSR)
+	vector<unsigned int> point_offsets;
+	vector<unsigned int> point_obs;
+
+	SolverOptions options;
+	SolverReport report;
+
+	LinearSolver linear_solver;
+	CGOptions cg_options;
+	CGReport cg_report;
+	vector<double> d_cam_prev;
+	SparseCholesky cholesky;
+
+	Matrix v;
+
+	/** groupObservations
+	 * builds the point -> observations index used to form the Schur complement
+	 */
+	void groupObservations();
+
+	/** buildNormals
+	 * accumulates the camera blocks U, point blocks V and the off-diagonal blocks W
+	 * of the normal equations at the current estimate
+	 *
+	 * @return - the cost w_trans * w
+	 */
+	double buildNormals(vector<double> &U, vector<double> &V, vector<double> &W,
+		vector<double> &u_cam, vector<double> &u_pt);
+
+	/** computeCost
+	 * computes w_trans * w at the current estimate
+	 */
+	double computeCost();
+
+	/** solveReduced
+	 * forms the Schur complement of the damped normals and solves for the photo and
+	 * point deltas
+	 *
+	 * S = U - W * V^-1 * W_trans
+	 *
+	 * @return - false if a damped point block is singular or the reduced camera system is
+	 *			  not positive definite
+	 */
+	bool solveReduced(const vector<double> &U, const vector<double> &V, const vector<double> &W,
+		const vector<double> &u_cam, const vector<double> &u_pt, double damping,
+		vector<double> &d_cam, vector<double> &d_pt);
+
+	/** applyDelta
+	 * adds the photo deltas [Tx, Ty, Tz, omega, phi, kappa] and tie point deltas [X, Y, Z]
+	 */
+	void applyDelta(const vector<double> &d_cam, const vector<double> &d_pt);
+};
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "Point.h"
+#include "RotationMatrix.h"
+
+struct ImageObservation {
+	unsigned int photo; // index of the photo the point was measured in
+	unsigned int point; // index of the object point
+	double x, y;		// measured image coordinates
+
+	ImageObservation() : photo(0), point(0), x(0), y(0) {}
+	ImageObservation(unsigned int _photo, unsigned int _point, double _x, double _y) :
+		photo(_photo), point(_point), x(_x), y(_y) {}
+};
+
+/** Camera
+ * the exterior and interior orientation of an oriented photo in a flat layout for the
+ * batch kernels; m is the row-major rotation matrix from object to image space
+ */
+struct Camera {
+	double m[9];
+	double T[3]; // the perspective centre
+	double c;	 // the focal length
+
+	Camera() : m{ 1, 0, 0, 0, 1, 0, 0, 0, 1 }, T{ 0, 0, 0 }, c(0) {}
+	Camera(const RotationMatrix &M, const Point3D &_T, double _c) : T{ _T.x, _T.y, _T.z }, c(_c) {
+		for (unsigned int i = 0; i < 3; i++)
+			for (unsigned int j = 0; j < 3; j++)
+				m[3 * i + j] = M.at(i, j);
+	}
+};
+
+struct SensorGeometry {
+	unsigned int width, height; // dimensions of the photo [pixels]
+	double pixel_size;			// size of a pixel in image units
+	double cx, cy;				// pixel position of the principal point
+
+	SensorGeometry() : width(0), height(0), pixel_size(1), cx(0), cy(0) {}
+	SensorGeometry(unsigned int _width, unsigned int _height, double _pixel_size) :
+		width(_width), height(_height), pixel_size(_pixel_size), cx((_width - 1) / 2.0), cy((_height - 1) / 2.0) {}
+};
@@ -0,0 +1,343 @@
+#include "ConjugateGradient.h"
+#include "SparseMatrix.h"
+
+static double dot(const vector<double> &a, const vector<double> &b) {
+	double s = 0.0;
+	for (unsigned int i = 0; i < a.size(); i++)
+		s += a[i] * b[i];
+	return s;
+}
+
+NormalOperator::NormalOperator(Matrix &A, const vector<double> &p) : A(&A), p(p) {
+	if (p.size() != A.getrows()) {
+		cout << "Error: NormalOperator - Number of weights does not match the design matrix" << endl;
+		exit(1);
+	}
+}
+
+unsigned int NormalOperator::size() const {
+	return A->getcols();
+}
+
+void NormalOperator::apply(const vector<double> &x, vector<double> &y) const {
+	unsigned int n = A->getrows();
+	unsigned int m = A->getcols();
+
+	y.assign(m, 0.0);
+
+	// y = A_trans * (p .* (A * x)), one pass over the rows of A
+	for (unsigned int i = 0; i < n; i++) {
+		const vector<double> &row = (*A)[i];
+
+		double ax = 0.0;
+		for (unsigned int j = 0; j < m; j++)
+			ax += row[j] * x[j];
+
+		ax *= p[i];
+		for (unsigned int j = 0; j < m; j++)
+			y[j] += row[j] * ax;
+	}
+}
+
+vector<double> NormalOperator::diagonalBlocks(unsigned int block_size) const {
+	unsigned int n = A->getrows();
+	unsigned int m = A->getcols();
+
+	vector<double> blocks;
+	vector<unsigned int> offsets;
+	for (unsigned int start = 0; start < m; start += block_size) {
+		unsigned int b = (start + block_size <= m) ? block_size : m - start;
+		offsets.push_back(blocks.size());
+		blocks.resize(blocks.size() + b * b, 0.0);
+	}
+
+	for (unsigned int i = 0; i < n; i++) {
+		const vector<double> &row = (*A)[i];
+		for (unsigned int start = 0, k = 0; start < m; start += block_size, k++) {
+			unsigned int b = (start + block_size <= m) ? block_size : m - start;
+			double *blk = &blocks[offsets[k]];
+			for (unsigned int r = 0; r < b; r++) {
+				double pa = p[i] * row[start + r];
+				for (unsigned int c = 0; c < b; c++)
+					blk[r * b + c] += pa * row[start + c];
+			}
+		}
+	}
+
+	return blocks;
+}
+
+JacobiPreconditioner::JacobiPreconditioner(const vector<double> &diagonal) {
+	inv_diagonal.resize(diagonal.size());
+	for (unsigned int i = 0; i < diagonal.size(); i++)
+		inv_diagonal[i] = (diagonal[i] > 0.0) ? 1.0 / diagonal[i] : 1.0;
+}
+
+void JacobiPreconditioner::apply(const vector<double> &r, vector<double> &z) const {
+	z.resize(r.size());
+	for (unsigned int i = 0; i < r.size(); i++)
+		z[i] = inv_diagonal[i] * r[i];
+}
+
+BlockJacobiPreconditioner::BlockJacobiPreconditioner(const vector<double> &blocks, unsigned int size, unsigned int block_size) :
+	n(size), block_size(block_size), factors(blocks) {
+
+	unsigned int offset = 0;
+	for (unsigned int start = 0; start < n; start += block_size) {
+		unsigned int b = (start + block_size <= n) ? block_size : n - start;
+		double *L = &factors[offset];
+
+		// in-place Cholesky decomposition of the block; a singular block falls back to Jacobi
+		for (unsigned int j = 0; j < b; j++) {
+			double s = L[j * b + j];
+			for (unsigned int k = 0; k < j; k++)
+				s -= L[j * b + k] * L[j * b + k];
+
+			if (s <= 0.0) {
+				for (unsigned int r = 0; r < b; r++)
+					for (unsigned int c = 0; c < b; c++)
+						L[r * b + c] = (r == c) ? sqrt(fmax(blocks[offset + r * b + r], 1.0E-300)) : 0.0;
+				break;
+			}
+
+			L[j * b + j] = sqrt(s);
+			for (unsigned int i = j + 1; i < b; i++) {
+				double t = L[i * b + j];
+				for (unsigned int k = 0; k < j; k++)
+					t -= L[i * b + k] * L[j * b + k];
+				L[i * b + j] = t / L[j * b + j];
+			}
+		}
+
+		offset += b * b;
+	}
+}
+
+void BlockJacobiPreconditioner::apply(const vector<double> &r, vector<double> &z) const {
+	z = r;
+
+	unsigned int offset = 0;
+	for (unsigned int start = 0; start < n; start += block_size) {
+		unsigned int b = (start + block_size <= n) ? block_size : n - start;
+		const double *L = &factors[offset];
+		double *x = &z[start];
+
+		for (unsigned int i = 0; i < b; i++) {
+			for (unsigned int k = 0; k < i; k++)
+				x[i] -= L[i * b + k] * x[k];
+			x[i] /= L[i * b + i];
+		}
+		for (unsigned int i = b; i-- > 0;) {
+			for (unsigned int k = i + 1; k < b; k++)
+				x[i] -= L[k * b + i] * x[k];
+			x[i] /= L[i * b + i];
+		}
+
+		offset += b * b;
+	}
+}
+
+IncompleteCholeskyPreconditioner::IncompleteCholeskyPreconditioner(const SparseMatrix &N) : n(N.size()),
+	shift(0.0), jacobi(false) {
+
+	double max_diag = 0.0;
+	for (unsigned int j = 0; j < n; j++)
+		max_diag = fmax(max_diag, fabs(N.at(j, j)));
+	if (!(max_diag > 0.0) || !std::isfinite(max_diag))
+		max_diag = 1.0;
+
+	// Manteuffel shift: retry with a growing diagonal shift on breakdown
+	while (!factor(N, shift)) {
+		shift = (shift == 0.0) ? 1.0E-3 * max_diag : 2.0 * shift;
+		if (shift > 1.0E3 * max_diag) {
+			factorDiagonal(N);
+			return;
+		}
+	}
+}
+
+bool IncompleteCholeskyPreconditioner::factor(const SparseMatrix &N, double shift) {
+	const vector<unsigned int> &N_ptr = N.colPointers();
+	const vector<unsigned int> &N_rows = N.rowIndices();
+	const vector<double> &N_vals = N.values();
+
+	// the pattern of N, with the diagonal first in every column even if N does not store it
+	col_ptr.assign(1, 0);
+	row_idx.clear();
+	vals.clear();
+	for (unsigned int j = 0; j < n; j++) {
+		row_idx.push_back(j);
+		vals.push_back(N.at(j, j) + shift);
+		for (unsigned int e = N_ptr[j]; e < N_ptr[j + 1]; e++) {
+			if (N_rows[e] > j) {
+				row_idx.push_back(N_rows[e]);
+				vals.push_back(N_vals[e]);
+			}
+		}
+		col_ptr.push_back(row_idx.size());
+	}
+
+	// the position of each row in the column being updated
+	vector<int> position(n, -1);
+
+	// right-looking: column j is finished, then updates the later columns within the pattern
+	for (unsigned int j = 0; j < n; j++) {
+		double d = vals[col_ptr[j]];
+		if (!(d > 0.0) || !std::isfinite(d))
+			return false;
+
+		d = sqrt(d);
+		vals[col_ptr[j]] = d;
+		for (unsigned int e = col_ptr[j] + 1; e < col_ptr[j + 1]; e++)
+			vals[e] /= d;
+
+		// L_ik -= L_ij * L_kj for every i >= k > j in the pattern of column k
+		for (unsigned int e = col_ptr[j] + 1; e < col_ptr[j + 1]; e++) {
+			unsigned int k = row_idx[e];
+			for (unsigned int f = col_ptr[k]; f < col_ptr[k + 1]; f++)
+				position[row_idx[f]] = f;
+
+			for (unsigned int g = e; g < col_ptr[j + 1]; g++) {
+				int pos = position[row_idx[g]];
+				if (pos >= 0)
+					vals[pos] -= vals[g] * vals[e];
+			}
+
+			for (unsigned int f = col_ptr[k]; f < col_ptr[k + 1]; f++)
+				position[row_idx[f]] = -1;
+		}
+	}
+
+	return true;
+}
+
+void IncompleteCholeskyPreconditioner::factorDiagonal(const SparseMatrix &N) {
+	jacobi = true;
+
+	col_ptr.resize(n + 1);
+	row_idx.resize(n);
+	vals.resize(n);
+	for (unsigned int j = 0; j < n; j++) {
+		double d = N.at(j, j);
+		col_ptr[j] = j;
+		row_idx[j] = j;
+		vals[j] = (d > 0.0 && std::isfinite(d)) ? sqrt(d) : 1.0;
+	}
+	col_ptr[n] = n;
+}
+
+void IncompleteCholeskyPreconditioner::apply(const vector<double> &r, vector<double> &z) const {
+	z = r;
+
+	// L * y = r, column by column
+	for (unsigned int j = 0; j < n; j++) {
+		z[j] /= vals[col_ptr[j]];
+		for (unsigned int e = col_ptr[j] + 1; e < col_ptr[j + 1]; e++)
+			z[row_idx[e]] -= vals[e] * z[j];
+	}
+
+	// L_trans * z = y, with the columns of L as the rows of L_trans
+	for (unsigned int j = n; j-- > 0;) {
+		for (unsigned int e = col_ptr[j] + 1; e < col_ptr[j + 1]; e++)
+			z[j] -= vals[e] * z[row_idx[e]];
+		z[j] /= vals[col_ptr[j]];
+	}
+}
+
+double IncompleteCholeskyPreconditioner::getShift() const {
+	return shift;
+}
+
+bool IncompleteCholeskyPreconditioner::isJacobi() const {
+	return jacobi;
+}
+
+CGReport conjugateGradient(const LinearOperator &N, const vector<double> &b, vector<double> &x,
+	const Preconditioner &M, const CGOptions &options) {
+
+	CGReport report;
+	unsigned int n = N.size();
+
+	if (x.size() != n)
+		x.assign(n, 0.0);
+
+	vector<double> r(n), z, d, q;
+
+	N.apply(x, q);
+	for (unsigned int i = 0; i < n; i++)
+		r[i] = b[i] - q[i];
+
+	double b_norm = sqrt(dot(b, b));
+	double r_norm = sqrt(dot(r, r));
+	report.initial_residual = r_norm;
+
+	if (b_norm == 0.0) {
+		x.assign(n, 0.0);
+		report.converged = true;
+		return report;
+	}
+
+	M.apply(r, z);
+	d = z;
+	double rz = dot(r, z);
+
+	while (r_norm / b_norm > options.tolerance) {
+		if (report.iterations >= options.max_iterations) {
+			report.residual = r_norm;
+			return report;
+		}
+
+		N.apply(d, q);
+		double dq = dot(d, q);
+		if (dq <= 0.0)
+			break; // operator not positive definite along d; keep the current iterate
+
+		double alpha = rz / dq;
+		for (unsigned int i = 0; i < n; i++) {
+			x[i] += alpha * d[i];
+			r[i] -= alpha * q[i];
+		}
+
+		M.apply(r, z);
+		double rz_new = dot(r, z);
+		double beta = rz_new / rz;
+		rz = rz_new;
+
+		for (unsigned int i = 0; i < n; i++)
+			d[i] = z[i] + beta * d[i];
+
+		r_norm = sqrt(dot(r, r));
+		report.iterations++;
+	}
+
+	report.converged = (r_norm / b_norm <= options.tolerance);
+	report.residual = r_norm;
+
+	return report;
+}
+
+CGReport delta(Matrix &A, const vector<double> &p, const Matrix &w, Matrix &del, const CGOptions &options) {
+	unsigned int m = A.getcols();
+
+	NormalOperator N(A, p);
+	JacobiPreconditioner M(N.diagonalBlocks(1));
+
+	Matrix u = normalVector(A, p, w);
+	vector<double> b(m), x;
+	for (unsigned int j = 0; j < m; j++)
+		b[j] = -u[j][0];
+
+	if (del.getrows() == m && del.getcols() == 1) {
+		x.resize(m);
+		for (unsigned int j = 0; j < m; j++)
+			x[j] = del[j][0];
+	}
+
+	CGReport report = conjugateGradient(N, b, x, M, options);
+
+	del.resize(m, 1);
+	for (unsigned int j = 0; j < m; j++)
+		del[j][0] = x[j];
+
+	return report;
+}
@@ -0,0 +1,166 @@
+/*
+ * The purpose of this header is to provide an iterative alternative to the
+ * Cholesky decomposition in Matrix::inv() for normal equations that are too large
+ * to factor: the preconditioned conjugate gradient (PCG) method. The normal matrix
+ * only has to be applied to a vector, so it never has to be formed.
+ */
+
+#pragma once
+
+#include "LeastSquares.h"
+
+class SparseMatrix;
+
+class LinearOperator {
+public:
+	virtual ~LinearOperator() {}
+
+	virtual unsigned int size() const = 0;
+
+	/** apply
+	 * computes y = N * x for the symmetric positive definite operator N
+	 */
+	virtual void apply(const vector<double> &x, vector<double> &y) const = 0;
+};
+
+class NormalOperator : public LinearOperator {
+public:
+	/** NormalOperator
+	 * the normal matrix of a Least-Squares adjustment applied matrix-free
+	 *
+	 * y = A_trans * diag(p) * (A * x)
+	 *
+	 * @param A - design matrix for the adjustment (not copied; must outlive the operator)
+	 * @param p - the n diagonal weights of the observations
+	 */
+	NormalOperator(Matrix &A, const vector<double> &p);
+
+	unsigned int size() const;
+	void apply(const vector<double> &x, vector<double> &y) const;
+
+	/** diagonalBlocks
+	 * computes the diagonal blocks of N without forming N; the last block may be smaller
+	 *
+	 * @param block_size - the size of the blocks (1 for the diagonal of N)
+	 *
+	 * @return			 - the row-major blocks, one after the other
+	 */
+	vector<double> diagonalBlocks(unsigned int block_size) const;
+private:
+	Matrix *A;
+	vector<double> p;
+};
+
+class Preconditioner {
+public:
+	virtual ~Preconditioner() {}
+
+	/** apply
+	 * computes z = M^-1 * r for the preconditioner M ~ N
+	 */
+	virtual void apply(const vector<double> &r, vector<double> &z) const = 0;
+};
+
+class JacobiPreconditioner : public Preconditioner {
+public:
+	/** JacobiPreconditioner
+	 * M = diag(N)
+	 *
+	 * @param diagonal - the diagonal of the normal matrix
+	 */
+	JacobiPreconditioner(const vector<double> &diagonal);
+	void apply(const vector<double> &r, vector<double> &z) const;
+private:
+	vector<double> inv_diagonal;
+};
+
+class BlockJacobiPreconditioner : public Preconditioner {
+public:
+	/** BlockJacobiPreconditioner
+	 * M = blockdiag(N), e.g. one 6-by-6 block per photo; the blocks are factored once
+	 *
+	 * @param blocks	 - the row-major diagonal blocks (see NormalOperator::diagonalBlocks)
+	 * @param size		 - the dimension of the operator
+	 * @param block_size - the size of the blocks
+	 */
+	BlockJacobiPreconditioner(const vector<double> &blocks, unsigned int size, unsigned int block_size);
+	void apply(const vector<double> &r, vector<double> &z) const;
+private:
+	unsigned int n, block_size;
+	vector<double> factors; // Cholesky factors of the blocks
+};
+
+class IncompleteCholeskyPreconditioner : public Preconditioner {
+public:
+	/** IncompleteCholeskyPreconditioner
+	 * M = L * L_trans where L has the sparsity pattern of the stored lower triangle of N
+	 * (IC(0)). If the incomplete decomposition breaks down, the diagonal is shifted and the
+	 * decomposition retried; if that fails too, M falls back to diag(N) (Jacobi)
+	 *
+	 * @param N - the sparse normal matrix
+	 */
+	IncompleteCholeskyPreconditioner(const SparseMatrix &N);
+	void apply(const vector<double> &r, vector<double> &z) const;
+
+	double getShift() const;  // the diagonal shift of the decomposition
+	bool isJacobi() const;	  // true if the decomposition failed and M = diag(N)
+private:
+	unsigned int n;
+	vector<unsigned int> col_ptr; // column j of L is entries [col_ptr[j], col_ptr[j + 1]), diagonal first
+	vector<unsigned int> row_idx;
+	vector<double> vals;
+	double shift;
+	bool jacobi;
+
+	bool factor(const SparseMatrix &N, double shift);
+	void factorDiagonal(const SparseMatrix &N);
+};
+
+struct CGOptions {
+	unsigned int max_iterations;
+	double tolerance; // on the relative residual |b - N * x| / |b|
+
+	CGOptions() : max_iterations(1000), tolerance(1e-10) {}
+	CGOptions(unsigned int _max_iterations, double _tolerance) :
+		max_iterations(_max_iterations), tolerance(_tolerance) {}
+};
+
+struct CGReport {
+	bool converged;
+	unsigned int iterations;
+	double initial_residual; // |b - N * x0| of the (warm) starting vector
+	double residual;		 // |b - N * x| at termination
+
+	CGReport() : converged(false), iterations(0), initial_residual(0), residual(0) {}
+};
+
+/** conjugateGradient
+ * solves N * x = b with the preconditioned conjugate gradient method
+ *
+ * @param N		  - the symmetric positive definite operator
+ * @param b		  - the right hand side
+ * @param x		  - on input the starting vector (warm start, zero if empty); on output the solution
+ * @param M		  - the preconditioner
+ * @param options - iteration cap and tolerance
+ *
+ * @return		  - the number of iterations and residual norms
+ */
+CGReport conjugateGradient(const LinearOperator &N, const vector<double> &b, vector<double> &x,
+	const Preconditioner &M, const CGOptions &options = CGOptions());
+
+/** delta
+ * Computes the delta vector of a Least-Squares adjustment with a diagonal weight
+ * matrix iteratively (Jacobi-preconditioned CG) instead of through N.inv()
+ *
+ * delta = -(A_trans * diag(p) * A)^-1 * A_trans * diag(p) * w
+ *
+ * @param A		  - design matrix for the adjustment (constant)
+ * @param p		  - the n diagonal weights of the observations
+ * @param w		  - misclosure vector for the adjustment
+ * @param del	  - on input the starting vector, e.g. the delta of the previous
+ *					iteration (warm start); on output the delta vector
+ * @param options - iteration cap and tolerance
+ *
+ * @return		  - the number of iterations and residual norms
+ */
+CGReport delta(Matrix &A, const vector<double> &p, const Matrix &w, Matrix &del, const CGOptions &options);
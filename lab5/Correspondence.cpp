@@ -0,0 +1,169 @@
+#include "Correspondence.h"
+
+// indices 0..n-1 sorted stably by their 32-bit keys with two 16-bit counting sort passes
+static vector<unsigned int> radixSort(const vector<uint32_t> &keys) {
+	unsigned int n = keys.size();
+	vector<unsigned int> order(n), buffer(n);
+	for (unsigned int i = 0; i < n; i++)
+		order[i] = i;
+
+	vector<unsigned int> counts(65537);
+	for (int shift = 0; shift < 32; shift += 16) {
+		counts.assign(65537, 0);
+		for (unsigned int i = 0; i < n; i++)
+			counts[((keys[i] >> shift) & 0xFFFF) + 1]++;
+		for (unsigned int d = 0; d < 65536; d++)
+			counts[d + 1] += counts[d];
+
+		for (unsigned int i = 0; i < n; i++) {
+			unsigned int k = order[i];
+			buffer[counts[(keys[k] >> shift) & 0xFFFF]++] = k;
+		}
+		order.swap(buffer);
+	}
+
+	return order;
+}
+
+static Correspondence hashJoin(const vector<uint32_t> &a, const vector<uint32_t> &b) {
+	Correspondence match;
+	match.first.reserve(min(a.size(), b.size()));
+	match.second.reserve(min(a.size(), b.size()));
+
+	PointIndex index(b);
+	vector<unsigned char> used(b.size(), 0);
+
+	for (unsigned int i = 0; i < a.size(); i++) {
+		// the first unused occurrence of the id in b
+		unsigned int j = index.find(a[i]);
+		while (j != PointIndex::npos && used[j])
+			j = index.next(j);
+
+		if (j == PointIndex::npos) {
+			match.unmatched_first.push_back(i);
+			continue;
+		}
+
+		used[j] = 1;
+		match.first.push_back(i);
+		match.second.push_back(j);
+	}
+
+	for (unsigned int j = 0; j < b.size(); j++)
+		if (!used[j])
+			match.unmatched_second.push_back(j);
+
+	return match;
+}
+
+static Correspondence sortMergeJoin(const vector<uint32_t> &a, const vector<uint32_t> &b) {
+	Correspondence match;
+
+	vector<unsigned int> sa = radixSort(a);
+	vector<unsigned int> sb = radixSort(b);
+
+	unsigned int i = 0, j = 0;
+	while (i < sa.size() && j < sb.size()) {
+		uint32_t ka = a[sa[i]];
+		uint32_t kb = b[sb[j]];
+
+		if (ka < kb)
+			match.unmatched_first.push_back(sa[i++]);
+		else if (kb < ka)
+			match.unmatched_second.push_back(sb[j++]);
+		else {
+			match.first.push_back(sa[i++]);
+			match.second.push_back(sb[j++]);
+		}
+	}
+	while (i < sa.size())
+		match.unmatched_first.push_back(sa[i++]);
+	while (j < sb.size())
+		match.unmatched_second.push_back(sb[j++]);
+
+	return match;
+}
+
+Correspondence matchIds(const vector<uint32_t> &a, const vector<uint32_t> &b, JoinMethod method) {
+	if (method == JoinMethod::SortMerge)
+		return sortMergeJoin(a, b);
+	return hashJoin(a, b);
+}
+
+// the ids of b in terms of the IdTable of a; ids unknown to a become IdTable::npos
+static vector<uint32_t> translateIds(const vector<uint32_t> &ids, const IdTable &from, const IdTable &to) {
+	vector<uint32_t> map(from.size());
+	for (unsigned int k = 0; k < map.size(); k++)
+		map[k] = to.find(from.name(k));
+
+	vector<uint32_t> translated(ids.size());
+	for (unsigned int i = 0; i < ids.size(); i++)
+		translated[i] = map[ids[i]];
+	return translated;
+}
+
+template <typename CloudA, typename CloudB>
+static Correspondence joinClouds(const CloudA &a, const CloudB &b, JoinMethod method) {
+	if (a.table == b.table)
+		return matchIds(a.id, b.id, method);
+	return matchIds(a.id, translateIds(b.id, *b.table, *a.table), method);
+}
+
+Correspondence joinPoints(const PointCloud2D &a, const PointCloud2D &b, JoinMethod method) {
+	return joinClouds(a, b, method);
+}
+
+Correspondence joinPoints(const PointCloud3D &a, const PointCloud2D &b, JoinMethod method) {
+	return joinClouds(a, b, method);
+}
+
+Correspondence joinPoints(const PointCloud3D &a, const PointCloud3D &b, JoinMethod method) {
+	return joinClouds(a, b, method);
+}
+
+PointCloud2D selectPoints(const PointCloud2D &points, const vector<unsigned int> &indices) {
+	PointCloud2D selected(points.table);
+	selected.reserve(indices.size());
+	for (unsigned int k = 0; k < indices.size(); k++) {
+		unsigned int i = indices[k];
+		selected.push_back(points.id[i], points.x[i], points.y[i]);
+	}
+	return selected;
+}
+
+PointCloud3D selectPoints(const PointCloud3D &points, const vector<unsigned int> &indices) {
+	PointCloud3D selected(points.table);
+	selected.reserve(indices.size());
+	for (unsigned int k = 0; k < indices.size(); k++) {
+		unsigned int i = indices[k];
+		selected.push_back(points.id[i], points.x[i], points.y[i], points.z[i]);
+	}
+	return selected;
+}
+
+Correspondence alignPoints(const PointCloud2D &a, const PointCloud2D &b, PointCloud2D &aligned_a, PointCloud2D &aligned_b,
+	JoinMethod method) {
+
+	Correspondence match = joinPoints(a, b, method);
+	aligned_a = selectPoints(a, match.first);
+	aligned_b = selectPoints(b, match.second);
+	return match;
+}
+
+Correspondence alignPoints(const PointCloud3D &a, const PointCloud2D &b, PointCloud3D &aligned_a, PointCloud2D &aligned_b,
+	JoinMethod method) {
+
+	Correspondence match = joinPoints(a, b, method);
+	aligned_a = selectPoints(a, match.first);
+	aligned_b = selectPoints(b, match.second);
+	return match;
+}
+
+Correspondence alignPoints(const PointCloud3D &a, const PointCloud3D &b, PointCloud3D &aligned_a, PointCloud3D &aligned_b,
+	JoinMethod method) {
+
+	Correspondence match = joinPoints(a, b, method);
+	aligned_a = selectPoints(a, match.first);
+	aligned_b = selectPoints(b, match.second);
+	return match;
+}
@@ -0,0 +1,68 @@
+/*
+ * The purpose of this header is to align two point sets by their ids before they are handed
+ * to the solvers, which assume that the i-th points of both sets correspond. The sets may
+ * come in any order and with points missing from either side; the points without a partner
+ * are reported.
+ */
+
+#pragma once
+
+#include "PointCloud.h"
+#include "PointIndex.h"
+
+enum class JoinMethod {
+	Hash,	  // probe an index of the second set with every point of the first; pairs in the order of the first set
+	SortMerge // radix sort both sets by id and merge them; pairs in the order of the ids
+};
+
+struct Correspondence {
+	vector<unsigned int> first, second;						// indices of the matched pairs
+	vector<unsigned int> unmatched_first, unmatched_second; // indices of the points without a partner
+
+	unsigned int size() const {
+		return first.size();
+	}
+};
+
+/** matchIds
+ * matches two sets of interned ids from the same IdTable. A point id occurring several
+ * times on both sides is paired in order of occurrence (the k-th with the k-th)
+ *
+ * @param a, b	 - the interned ids of both sets
+ * @param method - the join algorithm
+ *
+ * @return		 - the matched pairs and the unmatched points of both sets
+ */
+Correspondence matchIds(const vector<uint32_t> &a, const vector<uint32_t> &b, JoinMethod method = JoinMethod::Hash);
+
+/** joinPoints
+ * matches two point clouds by id; the ids of the second cloud are translated by name if
+ * the clouds do not share their IdTable
+ */
+Correspondence joinPoints(const PointCloud2D &a, const PointCloud2D &b, JoinMethod method = JoinMethod::Hash);
+Correspondence joinPoints(const PointCloud3D &a, const PointCloud2D &b, JoinMethod method = JoinMethod::Hash);
+Correspondence joinPoints(const PointCloud3D &a, const PointCloud3D &b, JoinMethod method = JoinMethod::Hash);
+
+/** selectPoints
+ * gathers the points at the given indices into a new cloud sharing the ids
+ */
+PointCloud2D selectPoints(const PointCloud2D &points, const vector<unsigned int> &indices);
+PointCloud3D selectPoints(const PointCloud3D &points, const vector<unsigned int> &indices);
+
+/** alignPoints
+ * joins two point clouds by id and returns them as aligned clouds, where the i-th points
+ * correspond, e.g. for RelativeOrientation (left, right), Resection (object, image) or
+ * AbsoluteOrientation (object, model)
+ *
+ * @param a, b				   - the point clouds to align
+ * @param aligned_a, aligned_b - the aligned clouds
+ * @param method			   - the join algorithm
+ *
+ * @return					   - the correspondence, including the unmatched points
+ */
+Correspondence alignPoints(const PointCloud2D &a, const PointCloud2D &b, PointCloud2D &aligned_a, PointCloud2D &aligned_b,
+	JoinMethod method = JoinMethod::Hash);
+Correspondence alignPoints(const PointCloud3D &a, const PointCloud2D &b, PointCloud3D &aligned_a, PointCloud2D &aligned_b,
+	JoinMethod method = JoinMethod::Hash);
+Correspondence alignPoints(const PointCloud3D &a, const PointCloud3D &b, PointCloud3D &aligned_a, PointCloud3D &aligned_b,
+	JoinMethod method = JoinMethod::Hash);
@@ -0,0 +1,243 @@
+#include "Geodesy.h"
+#include "Parallel.h"
+#include "SimdMath.h"
+
+static const double DEG_TO_RAD = 0.017453292519943295769;
+static const double RAD_TO_DEG = 57.295779513082320877;
+
+// the points [begin, end) of geodeticToECEF; scale converts the angles to radians
+static void geodeticRange(const double *lat, const double *lon, const double *h, unsigned int begin, unsigned int end,
+	double a, double e2, double scale, double *X, double *Y, double *Z) {
+
+	unsigned int i = begin;
+
+#ifdef __AVX2__
+	const __m256d va = _mm256_set1_pd(a), ve2 = _mm256_set1_pd(e2), vscale = _mm256_set1_pd(scale);
+	const __m256d one = _mm256_set1_pd(1.0), one_e2 = _mm256_set1_pd(1.0 - e2);
+
+	for (; i + 4 <= end; i += 4) {
+		__m256d slat, clat, slon, clon;
+		sincos4(_mm256_mul_pd(_mm256_loadu_pd(lat + i), vscale), slat, clat);
+		sincos4(_mm256_mul_pd(_mm256_loadu_pd(lon + i), vscale), slon, clon);
+		const __m256d ph = _mm256_loadu_pd(h + i);
+
+		// N = a / sqrt(1 - e^2 sin^2(lat))
+		const __m256d w = _mm256_sqrt_pd(_mm256_sub_pd(one, _mm256_mul_pd(ve2, _mm256_mul_pd(slat, slat))));
+		const __m256d N = _mm256_div_pd(va, w);
+		const __m256d r = _mm256_mul_pd(_mm256_add_pd(N, ph), clat);
+
+		_mm256_storeu_pd(X + i, _mm256_mul_pd(r, clon));
+		_mm256_storeu_pd(Y + i, _mm256_mul_pd(r, slon));
+		_mm256_storeu_pd(Z + i, _mm256_mul_pd(_mm256_add_pd(_mm256_mul_pd(N, one_e2), ph), slat));
+	}
+#endif
+
+	for (; i < end; i++) {
+		double slat = sin(lat[i] * scale), clat = cos(lat[i] * scale);
+		double slon = sin(lon[i] * scale), clon = cos(lon[i] * scale);
+
+		double N = a / sqrt(1.0 - e2 * slat * slat);
+		double r = (N + h[i]) * clat;
+
+		X[i] = r * clon;
+		Y[i] = r * slon;
+		Z[i] = (N * (1.0 - e2) + h[i]) * slat;
+	}
+}
+
+void geodeticToECEF(const double *lat, const double *lon, const double *h, unsigned int n, const Ellipsoid &ellipsoid,
+	double *X, double *Y, double *Z, bool degrees, unsigned int num_threads) {
+
+	double a = ellipsoid.a, e2 = ellipsoid.e2();
+	double scale = degrees ? DEG_TO_RAD : 1.0;
+
+	parallelFor(n, [&](unsigned int begin, unsigned int end) {
+		geodeticRange(lat, lon, h, begin, end, a, e2, scale, X, Y, Z);
+	}, num_threads, 16384);
+}
+
+/*
+ * Bowring's method, kept in terms of the sine and cosine of the parametric latitude beta so
+ * that no trigonometry is needed until the final arc tangents. With p = sqrt(X^2 + Y^2):
+ *
+ * tan(lat) = (Z + e'^2 b sin^3(beta)) / (p - e^2 a cos^3(beta)), tan(beta) = (1 - f) tan(lat)
+ *
+ * starting from tan(beta) = a Z / (b p). Each iteration cubes the error, so two leave
+ * nothing measurable outside the deep interior, and the pole (p = 0) needs no special case.
+ */
+static void ecefRange(const double *X, const double *Y, const double *Z, unsigned int begin, unsigned int end,
+	double a, double b, double e2, double ep2, double scale, double *lat, double *lon, double *h) {
+
+	unsigned int i = begin;
+
+#ifdef __AVX2__
+	const __m256d va = _mm256_set1_pd(a), vb = _mm256_set1_pd(b), one_f = _mm256_set1_pd(b / a);
+	const __m256d ve2 = _mm256_set1_pd(e2), vep2b = _mm256_set1_pd(ep2 * b), ve2a = _mm256_set1_pd(e2 * a);
+	const __m256d one = _mm256_set1_pd(1.0), vscale = _mm256_set1_pd(scale);
+
+	for (; i + 4 <= end; i += 4) {
+		const __m256d pX = _mm256_loadu_pd(X + i), pY = _mm256_loadu_pd(Y + i), pZ = _mm256_loadu_pd(Z + i);
+		const __m256d p = _mm256_sqrt_pd(_mm256_add_pd(_mm256_mul_pd(pX, pX), _mm256_mul_pd(pY, pY)));
+
+		// (sin(beta), cos(beta)) up to a common factor
+		__m256d s = _mm256_mul_pd(va, pZ), c = _mm256_mul_pd(vb, p);
+		__m256d num, den;
+		for (int iteration = 0; iteration < 2; iteration++) {
+			const __m256d r = _mm256_div_pd(one, _mm256_sqrt_pd(_mm256_add_pd(_mm256_mul_pd(s, s), _mm256_mul_pd(c, c))));
+			const __m256d sb = _mm256_mul_pd(s, r), cb = _mm256_mul_pd(c, r);
+			num = _mm256_add_pd(pZ, _mm256_mul_pd(vep2b, _mm256_mul_pd(sb, _mm256_mul_pd(sb, sb))));
+			den = _mm256_sub_pd(p, _mm256_mul_pd(ve2a, _mm256_mul_pd(cb, _mm256_mul_pd(cb, cb))));
+			s = _mm256_mul_pd(one_f, num);
+			c = den;
+		}
+
+		const __m256d r = _mm256_div_pd(one, _mm256_sqrt_pd(_mm256_add_pd(_mm256_mul_pd(num, num), _mm256_mul_pd(den, den))));
+		const __m256d slat = _mm256_mul_pd(num, r), clat = _mm256_mul_pd(den, r);
+
+		// h = p cos(lat) + Z sin(lat) - a sqrt(1 - e^2 sin^2(lat)), well conditioned at any latitude
+		const __m256d w = _mm256_sqrt_pd(_mm256_sub_pd(one, _mm256_mul_pd(ve2, _mm256_mul_pd(slat, slat))));
+		const __m256d ph = _mm256_sub_pd(_mm256_add_pd(_mm256_mul_pd(p, clat), _mm256_mul_pd(pZ, slat)), _mm256_mul_pd(va, w));
+
+		_mm256_storeu_pd(lat + i, _mm256_mul_pd(atan2_4(num, den), vscale));
+		_mm256_storeu_pd(lon + i, _mm256_mul_pd(atan2_4(pY, pX), vscale));
+		_mm256_storeu_pd(h + i, ph);
+	}
+#endif
+
+	for (; i < end; i++) {
+		double pX = X[i], pY = Y[i], pZ = Z[i];
+		double p = sqrt(pX * pX + pY * pY);
+
+		double s = a * pZ, c = b * p;
+		double num = 0, den = 0;
+		for (int iteration = 0; iteration < 2; iteration++) {
+			double r = 1.0 / sqrt(s * s + c * c);
+			double sb = s * r, cb = c * r;
+			num = pZ + ep2 * b * sb * sb * sb;
+			den = p - e2 * a * cb * cb * cb;
+			s = (b / a) * num;
+			c = den;
+		}
+
+		double r = 1.0 / sqrt(num * num + den * den);
+		double slat = num * r, clat = den * r;
+
+		lat[i] = atan2(num, den) * scale;
+		lon[i] = atan2(pY, pX) * scale;
+		h[i] = p * clat + pZ * slat - a * sqrt(1.0 - e2 * slat * slat);
+	}
+}
+
+void ecefToGeodetic(const double *X, const double *Y, const double *Z, unsigned int n, const Ellipsoid &ellipsoid,
+	double *lat, double *lon, double *h, bool degrees, unsigned int num_threads) {
+
+	double a = ellipsoid.a, b = ellipsoid.b(), e2 = ellipsoid.e2(), ep2 = ellipsoid.ep2();
+	double scale = degrees ? RAD_TO_DEG : 1.0;
+
+	parallelFor(n, [&](unsigned int begin, unsigned int end) {
+		ecefRange(X, Y, Z, begin, end, a, b, e2, ep2, scale, lat, lon, h);
+	}, num_threads, 16384);
+}
+
+// an empty cloud of n points sharing the ids of another
+static PointCloud3D sameIds(const PointCloud3D &points) {
+	unsigned int n = points.size();
+
+	PointCloud3D result(points.table);
+	result.id = points.id;
+	result.x.resize(n);
+	result.y.resize(n);
+	result.z.resize(n);
+	return result;
+}
+
+PointCloud3D geodeticToECEF(const PointCloud3D &geodetic, const Ellipsoid &ellipsoid, bool degrees,
+	unsigned int num_threads) {
+
+	PointCloud3D ecef = sameIds(geodetic);
+	geodeticToECEF(geodetic.x.data(), geodetic.y.data(), geodetic.z.data(), geodetic.size(), ellipsoid,
+		ecef.x.data(), ecef.y.data(), ecef.z.data(), degrees, num_threads);
+	return ecef;
+}
+
+PointCloud3D geodeticToECEF(const vector<GeodeticPoint> &geodetic, const Ellipsoid &ellipsoid, bool degrees,
+	unsigned int num_threads) {
+
+	PointCloud3D points;
+	points.reserve(geodetic.size());
+	for (unsigned int i = 0; i < geodetic.size(); i++)
+		points.push_back(geodetic[i].id, geodetic[i].lat, geodetic[i].lon, geodetic[i].h);
+
+	geodeticToECEF(points.x.data(), points.y.data(), points.z.data(), points.size(), ellipsoid,
+		points.x.data(), points.y.data(), points.z.data(), degrees, num_threads);
+	return points;
+}
+
+PointCloud3D ecefToGeodetic(const PointCloud3D &ecef, const Ellipsoid &ellipsoid, bool degrees,
+	unsigned int num_threads) {
+
+	PointCloud3D geodetic = sameIds(ecef);
+	ecefToGeodetic(ecef.x.data(), ecef.y.data(), ecef.z.data(), ecef.size(), ellipsoid,
+		geodetic.x.data(), geodetic.y.data(), geodetic.z.data(), degrees, num_threads);
+	return geodetic;
+}
+
+TangentPlane::TangentPlane(double lat, double lon, double h, const Ellipsoid &_ellipsoid, bool degrees) :
+	ellipsoid(_ellipsoid) {
+
+	if (degrees) {
+		lat *= DEG_TO_RAD;
+		lon *= DEG_TO_RAD;
+	}
+
+	double slat = sin(lat), clat = cos(lat);
+	double slon = sin(lon), clon = cos(lon);
+
+	// east, north and up as the rows
+	R.at(0, 0) = -slon;
+	R.at(0, 1) = clon;
+	R.at(0, 2) = 0;
+	R.at(1, 0) = -slat * clon;
+	R.at(1, 1) = -slat * slon;
+	R.at(1, 2) = clat;
+	R.at(2, 0) = clat * clon;
+	R.at(2, 1) = clat * slon;
+	R.at(2, 2) = slat;
+
+	geodeticToECEF(&lat, &lon, &h, 1, ellipsoid, &origin.x, &origin.y, &origin.z);
+}
+
+PointCloud3D ecefToENU(const PointCloud3D &ecef, const TangentPlane &plane, unsigned int num_threads) {
+	// enu = R * X - R * X0
+	Point3D T = plane.origin;
+	T.rotateBy(plane.R);
+	T.scaleBy(-1);
+
+	return transformPoints(ecef, 1.0, plane.R, T, num_threads);
+}
+
+PointCloud3D enuToECEF(const PointCloud3D &enu, const TangentPlane &plane, unsigned int num_threads) {
+	RotationMatrix R = plane.R;
+	return transformPoints(enu, 1.0, R.trans(), plane.origin, num_threads);
+}
+
+PointCloud3D geodeticToENU(const PointCloud3D &geodetic, const TangentPlane &plane, bool degrees,
+	unsigned int num_threads) {
+
+	PointCloud3D enu = geodeticToECEF(geodetic, plane.ellipsoid, degrees, num_threads);
+
+	Point3D T = plane.origin;
+	T.rotateBy(plane.R);
+	T.scaleBy(-1);
+	transformPointsInPlace(enu, 1.0, plane.R, T, num_threads);
+	return enu;
+}
+
+PointCloud3D enuToGeodetic(const PointCloud3D &enu, const TangentPlane &plane, bool degrees,
+	unsigned int num_threads) {
+
+	PointCloud3D geodetic = enuToECEF(enu, plane, num_threads);
+	ecefToGeodetic(geodetic.x.data(), geodetic.y.data(), geodetic.z.data(), geodetic.size(), plane.ellipsoid,
+		geodetic.x.data(), geodetic.y.data(), geodetic.z.data(), degrees, num_threads);
+	return geodetic;
+}
@@ -0,0 +1,106 @@
+/*
+ * The purpose of this header is to convert GNSS-derived coordinates into the frames the
+ * photogrammetric solutions work in: geodetic latitude, longitude and ellipsoidal height,
+ * earth-centred earth-fixed (ECEF) cartesian coordinates, and a local east-north-up (ENU)
+ * tangent plane about a chosen origin. The conversions run over coordinate arrays,
+ * vectorized across points where AVX2 is available and threaded across chunks, and the
+ * cloud versions write straight into PointCloud3D buffers.
+ *
+ * Geodetic coordinates in a cloud are stored as x=lat, y=lon, z=h, as read by
+ * parseGeodeticPoints.
+ */
+
+#pragma once
+
+#include "PointCloud.h"
+
+struct Ellipsoid {
+	double a; // semi-major axis [m]
+	double f; // flattening
+
+	Ellipsoid(double _a, double _f) : a(_a), f(_f) {}
+
+	double b() const { return a * (1.0 - f); }		   // semi-minor axis [m]
+	double e2() const { return f * (2.0 - f); }		   // first eccentricity squared
+	double ep2() const { return e2() / (1.0 - e2()); } // second eccentricity squared
+
+	static Ellipsoid WGS84() { return Ellipsoid(6378137.0, 1.0 / 298.257223563); }
+	static Ellipsoid GRS80() { return Ellipsoid(6378137.0, 1.0 / 298.257222101); }
+};
+
+/** geodeticToECEF
+ * converts geodetic coordinates to ECEF:
+ *
+ * X = (N + h) cos(lat) cos(lon), Y = (N + h) cos(lat) sin(lon), Z = (N (1 - e^2) + h) sin(lat)
+ *
+ * @param lat, lon, h - the n geodetic coordinates [rad or deg, m]
+ * @param n			  - the number of points
+ * @param ellipsoid	  - the reference ellipsoid
+ * @param X, Y, Z	  - the n ECEF coordinates [m]
+ * @param degrees	  - the latitudes and longitudes are in degrees instead of radians
+ * @param num_threads - the maximum number of threads (0: one per hardware thread)
+ */
+void geodeticToECEF(const double *lat, const double *lon, const double *h, unsigned int n, const Ellipsoid &ellipsoid,
+	double *X, double *Y, double *Z, bool degrees = false, unsigned int num_threads = 0);
+
+/** ecefToGeodetic
+ * converts ECEF coordinates to geodetic coordinates with two iterations of Bowring's
+ * method, accurate to well below a micrometre from the depths of the crust out past
+ * satellite orbits. The output arrays may be the input arrays (in place)
+ *
+ * @param X, Y, Z	  - the n ECEF coordinates [m]
+ * @param n			  - the number of points
+ * @param ellipsoid	  - the reference ellipsoid
+ * @param lat, lon, h - the n geodetic coordinates [rad or deg, m]
+ * @param degrees	  - return the latitudes and longitudes in degrees instead of radians
+ * @param num_threads - the maximum number of threads (0: one per hardware thread)
+ */
+void ecefToGeodetic(const double *X, const double *Y, const double *Z, unsigned int n, const Ellipsoid &ellipsoid,
+	double *lat, double *lon, double *h, bool degrees = false, unsigned int num_threads = 0);
+
+/** geodeticToECEF, ecefToGeodetic
+ * the conversions of whole clouds; the ids are shared with the input
+ */
+PointCloud3D geodeticToECEF(const PointCloud3D &geodetic, const Ellipsoid &ellipsoid = Ellipsoid::WGS84(),
+	bool degrees = false, unsigned int num_threads = 0);
+PointCloud3D geodeticToECEF(const vector<GeodeticPoint> &geodetic, const Ellipsoid &ellipsoid = Ellipsoid::WGS84(),
+	bool degrees = false, unsigned int num_threads = 0);
+PointCloud3D ecefToGeodetic(const PointCloud3D &ecef, const Ellipsoid &ellipsoid = Ellipsoid::WGS84(),
+	bool degrees = false, unsigned int num_threads = 0);
+
+/** TangentPlane
+ * a local east-north-up frame with its origin on (or above) the ellipsoid:
+ *
+ * enu = R * (X - X0), X = R^T * enu + X0
+ *
+ * where the rows of R are the east, north and up directions at the origin
+ */
+struct TangentPlane {
+	Ellipsoid ellipsoid;
+	RotationMatrix R; // ECEF to ENU
+	Point3D origin;	  // ECEF coordinates of the origin
+
+	/** TangentPlane
+	 * the constructor of this struct
+	 *
+	 * @param lat, lon, h - the geodetic coordinates of the origin [rad or deg, m]
+	 * @param ellipsoid	  - the reference ellipsoid
+	 * @param degrees	  - the latitude and longitude are in degrees instead of radians
+	 */
+	TangentPlane(double lat, double lon, double h, const Ellipsoid &ellipsoid = Ellipsoid::WGS84(), bool degrees = false);
+};
+
+/** ecefToENU, enuToECEF
+ * moves a cloud between ECEF and a tangent plane; the ids are shared with the input
+ */
+PointCloud3D ecefToENU(const PointCloud3D &ecef, const TangentPlane &plane, unsigned int num_threads = 0);
+PointCloud3D enuToECEF(const PointCloud3D &enu, const TangentPlane &plane, unsigned int num_threads = 0);
+
+/** geodeticToENU, enuToGeodetic
+ * moves a cloud of geodetic coordinates into a tangent plane and back, in the ellipsoid
+ * of the plane
+ */
+PointCloud3D geodeticToENU(const PointCloud3D &geodetic, const TangentPlane &plane, bool degrees = false,
+	unsigned int num_threads = 0);
+PointCloud3D enuToGeodetic(const PointCloud3D &enu, const TangentPlane &plane, bool degrees = false,
+	unsigned int num_threads = 0);
@@ -0,0 +1,395 @@
+#include <charconv>
+#include <cstring>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include "ImageRefinement.h"
+#include "BufferedWriter.h"
+#include "Parallel.h"
+
+ImageCorrection::ImageCorrection() : a(1), b(0), dx(0), c(0), d(1), dy(0), xp(0), yp(0), k1(0), k2(0), k3(0),
+	p1(0), p2(0), focal(0), refraction(0) {}
+
+ImageCorrection::ImageCorrection(const AffineParams &params) : ImageCorrection() {
+	a = params.a;
+	b = params.b;
+	dx = params.dx;
+	c = params.c;
+	d = params.d;
+	dy = params.dy;
+}
+
+ImageCorrection::ImageCorrection(const SimilarityParams &params) : ImageCorrection() {
+	a = params.a;
+	b = -params.b;
+	dx = params.dx;
+	c = params.b;
+	d = params.a;
+	dy = params.dy;
+}
+
+double refractionCoefficient(double flying_height, double terrain_height) {
+	// the heights of the model are in km
+	double H = flying_height / 1000.0, h = terrain_height / 1000.0;
+	if (H <= 0)
+		return 0;
+
+	return (2410.0 * H / (H * H - 6.0 * H + 250.0) - 2410.0 * h * h / ((h * h - 6.0 * h + 250.0) * H)) * 1e-6;
+}
+
+// the correction stack of a photo, with the principal point folded into the translation
+struct CorrectionCoefficients {
+	double a, b, dx, c, d, dy;
+	double k1, k2, k3, p1, p2;
+	double K, K_c2; // K and K / c^2
+};
+
+static CorrectionCoefficients coefficients(const ImageCorrection &corr) {
+	CorrectionCoefficients coef;
+	coef.a = corr.a;
+	coef.b = corr.b;
+	coef.dx = corr.dx - corr.xp;
+	coef.c = corr.c;
+	coef.d = corr.d;
+	coef.dy = corr.dy - corr.yp;
+	coef.k1 = corr.k1;
+	coef.k2 = corr.k2;
+	coef.k3 = corr.k3;
+	coef.p1 = corr.p1;
+	coef.p2 = corr.p2;
+	coef.K = corr.refraction;
+	coef.K_c2 = (corr.focal != 0) ? corr.refraction / (corr.focal * corr.focal) : 0.0;
+	return coef;
+}
+
+static inline void refinePoint(const CorrectionCoefficients &k, double x, double y, double &x_out, double &y_out) {
+	double xt = k.a * x + k.b * y + k.dx;
+	double yt = k.c * x + k.d * y + k.dy;
+
+	double r2 = xt * xt + yt * yt;
+	double radial = r2 * (k.k1 + r2 * (k.k2 + r2 * k.k3));
+	double xl = xt - xt * radial - (k.p1 * (r2 + 2.0 * xt * xt) + 2.0 * k.p2 * xt * yt);
+	double yl = yt - yt * radial - (k.p2 * (r2 + 2.0 * yt * yt) + 2.0 * k.p1 * xt * yt);
+
+	double refraction = k.K + k.K_c2 * (xl * xl + yl * yl);
+	x_out = xl - xl * refraction;
+	y_out = yl - yl * refraction;
+}
+
+/*
+ * the points [begin, end) of refineImageCoordinates. Measurements come grouped by photo, so
+ * four points of one photo are corrected together with the coefficients broadcast; a group
+ * that straddles two photos is corrected point by point
+ */
+static void refineRange(const double *x, const double *y, const uint32_t *photo, unsigned int begin, unsigned int end,
+	const vector<CorrectionCoefficients> &coef, double *x_out, double *y_out) {
+
+	unsigned int i = begin;
+
+#ifdef __AVX2__
+	const __m256d two = _mm256_set1_pd(2.0);
+
+	while (i + 4 <= end) {
+		uint32_t j = photo[i];
+		if (photo[i + 1] != j || photo[i + 2] != j || photo[i + 3] != j) {
+			refinePoint(coef[j], x[i], y[i], x_out[i], y_out[i]);
+			i++;
+			continue;
+		}
+
+		const CorrectionCoefficients &k = coef[j];
+		const __m256d a = _mm256_set1_pd(k.a), b = _mm256_set1_pd(k.b), dx = _mm256_set1_pd(k.dx);
+		const __m256d c = _mm256_set1_pd(k.c), d = _mm256_set1_pd(k.d), dy = _mm256_set1_pd(k.dy);
+		const __m256d k1 = _mm256_set1_pd(k.k1), k2 = _mm256_set1_pd(k.k2), k3 = _mm256_set1_pd(k.k3);
+		const __m256d p1 = _mm256_set1_pd(k.p1), p2 = _mm256_set1_pd(k.p2);
+		const __m256d K = _mm256_set1_pd(k.K), K_c2 = _mm256_set1_pd(k.K_c2);
+
+		// the rest of the run of this photo, four points at a time
+		for (; i + 4 <= end && photo[i] == j && photo[i + 3] == j && photo[i + 1] == j && photo[i + 2] == j; i += 4) {
+			const __m256d px = _mm256_loadu_pd(x + i), py = _mm256_loadu_pd(y + i);
+
+			const __m256d xt = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(a, px), _mm256_mul_pd(b, py)), dx);
+			const __m256d yt = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(c, px), _mm256_mul_pd(d, py)), dy);
+
+			const __m256d xx = _mm256_mul_pd(xt, xt), yy = _mm256_mul_pd(yt, yt), xy = _mm256_mul_pd(xt, yt);
+			const __m256d r2 = _mm256_add_pd(xx, yy);
+			const __m256d radial = _mm256_mul_pd(r2,
+				_mm256_add_pd(k1, _mm256_mul_pd(r2, _mm256_add_pd(k2, _mm256_mul_pd(r2, k3)))));
+
+			const __m256d dec_x = _mm256_add_pd(_mm256_mul_pd(p1, _mm256_add_pd(r2, _mm256_mul_pd(two, xx))),
+				_mm256_mul_pd(_mm256_mul_pd(two, p2), xy));
+			const __m256d dec_y = _mm256_add_pd(_mm256_mul_pd(p2, _mm256_add_pd(r2, _mm256_mul_pd(two, yy))),
+				_mm256_mul_pd(_mm256_mul_pd(two, p1), xy));
+
+			const __m256d xl = _mm256_sub_pd(_mm256_sub_pd(xt, _mm256_mul_pd(xt, radial)), dec_x);
+			const __m256d yl = _mm256_sub_pd(_mm256_sub_pd(yt, _mm256_mul_pd(yt, radial)), dec_y);
+
+			const __m256d rl2 = _mm256_add_pd(_mm256_mul_pd(xl, xl), _mm256_mul_pd(yl, yl));
+			const __m256d refraction = _mm256_add_pd(K, _mm256_mul_pd(K_c2, rl2));
+
+			_mm256_storeu_pd(x_out + i, _mm256_sub_pd(xl, _mm256_mul_pd(xl, refraction)));
+			_mm256_storeu_pd(y_out + i, _mm256_sub_pd(yl, _mm256_mul_pd(yl, refraction)));
+		}
+	}
+#endif
+
+	for (; i < end; i++)
+		refinePoint(coef[photo[i]], x[i], y[i], x_out[i], y_out[i]);
+}
+
+static vector<CorrectionCoefficients> coefficients(const vector<ImageCorrection> &corrections) {
+	vector<CorrectionCoefficients> coef(corrections.size());
+	for (unsigned int k = 0; k < corrections.size(); k++)
+		coef[k] = coefficients(corrections[k]);
+	return coef;
+}
+
+void refineImageCoordinates(const double *x, const double *y, const uint32_t *photo, unsigned int n,
+	const vector<ImageCorrection> &corrections, double *x_out, double *y_out, unsigned int num_threads) {
+
+	for (unsigned int i = 0; i < n; i++) {
+		if (photo[i] >= corrections.size()) {
+			cout << "Error: refineImageCoordinates - No correction for photo " << photo[i] << endl;
+			exit(1);
+		}
+	}
+
+	vector<CorrectionCoefficients> coef = coefficients(corrections);
+
+	parallelFor(n, [&](unsigned int begin, unsigned int end) {
+		refineRange(x, y, photo, begin, end, coef, x_out, y_out);
+	}, num_threads, 65536);
+}
+
+PointCloud2D refineImageCoordinates(const PointCloud2D &points, const ImageCorrection &correction,
+	unsigned int num_threads) {
+
+	unsigned int n = points.size();
+
+	PointCloud2D refined(points.table);
+	refined.id = points.id;
+	refined.x.resize(n);
+	refined.y.resize(n);
+
+	vector<uint32_t> photo(n, 0);
+	refineImageCoordinates(points.x.data(), points.y.data(), photo.data(), n, vector<ImageCorrection>(1, correction),
+		refined.x.data(), refined.y.data(), num_threads);
+
+	return refined;
+}
+
+// the measurements of one piece of a block of the file, and its formatted output
+struct MeasurementPiece {
+	vector<const char *> photo_begin, point_begin, point_end;
+	vector<uint32_t> photo;
+	vector<double> x, y;
+	vector<char> text;
+	string error; // the first error of the piece, reported by the calling thread
+
+	void clear() {
+		photo_begin.clear();
+		point_begin.clear();
+		point_end.clear();
+		photo.clear();
+		x.clear();
+		y.clear();
+		text.clear();
+		error.clear();
+	}
+};
+
+static inline bool isBlank(char c) {
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+static bool malformedMeasurement(const char *line, const char *end, const char *filename, MeasurementPiece &piece) {
+	const char *stop = line;
+	while (stop < end && *stop != '\n' && *stop != '\r' && stop - line < 80)
+		stop++;
+
+	piece.error = "Malformed line \"" + string(line, stop) + "\" in file " + filename;
+	return false;
+}
+
+// parses the lines in [p, end) of the block: photo id, point id, x, y; false with the
+// error in the piece if a line cannot be read
+static bool parseMeasurements(const char *p, const char *end, const char *filename, const IdTable &photos,
+	unsigned int num_photos, MeasurementPiece &piece) {
+
+	// the measurements of a photo come together, so the last photo id is remembered
+	const char *last_begin = NULL, *last_end = NULL;
+	uint32_t last_photo = 0;
+	string name;
+
+	while (p < end) {
+		while (p < end && (isBlank(*p) || *p == '\n'))
+			p++;
+		if (p == end)
+			break;
+
+		const char *line = p;
+		while (p < end && !isBlank(*p) && *p != '\n')
+			p++;
+		const char *photo_end = p;
+
+		size_t length = photo_end - line;
+		if (last_begin == NULL || (size_t)(last_end - last_begin) != length || memcmp(last_begin, line, length) != 0) {
+			name.assign(line, photo_end);
+			last_photo = photos.find(name);
+			if (last_photo == IdTable::npos || last_photo >= num_photos) {
+				piece.error = "No correction for photo " + name;
+				return false;
+			}
+			last_begin = line;
+			last_end = photo_end;
+		}
+
+		while (p < end && isBlank(*p))
+			p++;
+		const char *point = p;
+		while (p < end && !isBlank(*p) && *p != '\n')
+			p++;
+		if (p == point)
+			return malformedMeasurement(line, end, filename, piece);
+
+		piece.photo_begin.push_back(line);
+		piece.point_begin.push_back(point);
+		piece.point_end.push_back(p);
+		piece.photo.push_back(last_photo);
+
+		for (int k = 0; k < 2; k++) {
+			while (p < end && isBlank(*p))
+				p++;
+
+			double value;
+			std::from_chars_result result = std::from_chars(p, end, value);
+			if (result.ec != std::errc() || result.ptr == p)
+				return malformedMeasurement(line, end, filename, piece);
+
+			(k == 0 ? piece.x : piece.y).push_back(value);
+			p = result.ptr;
+		}
+
+		while (p < end && isBlank(*p))
+			p++;
+		if (p < end && *p != '\n')
+			return malformedMeasurement(line, end, filename, piece);
+	}
+
+	return true;
+}
+
+// formats the refined measurements of a piece: photo id, point id, x, y
+static void formatMeasurements(MeasurementPiece &piece, int prec) {
+	char number[64];
+	for (unsigned int i = 0; i < piece.photo.size(); i++) {
+		// the photo id ends where the blanks before the point id begin
+		const char *photo_end = piece.photo_begin[i];
+		while (!isBlank(*photo_end))
+			photo_end++;
+
+		piece.text.insert(piece.text.end(), piece.photo_begin[i], photo_end);
+		piece.text.push_back(' ');
+		piece.text.insert(piece.text.end(), piece.point_begin[i], piece.point_end[i]);
+
+		for (int k = 0; k < 2; k++) {
+			double value = (k == 0) ? piece.x[i] : piece.y[i];
+			std::to_chars_result result = std::to_chars(number, number + sizeof(number), value,
+				std::chars_format::fixed, prec);
+			piece.text.push_back(' ');
+			piece.text.insert(piece.text.end(), number, result.ptr);
+		}
+		piece.text.push_back('\n');
+	}
+}
+
+size_t refineMeasurementFile(const char *input, const char *output, const IdTable &photos,
+	const vector<ImageCorrection> &corrections, int prec, unsigned int num_threads) {
+
+	std::ifstream infile(input, ios_base::in | ios_base::binary);
+	if (!infile.is_open()) {
+		cout << "Error: refineMeasurementFile - Error opening file " << input << endl;
+		exit(1);
+	}
+
+	if (num_threads == 0)
+		num_threads = std::max(1u, std::thread::hardware_concurrency());
+	prec = std::max(0, std::min(prec, 30));
+
+	vector<CorrectionCoefficients> coef = coefficients(corrections);
+	BufferedWriter out(output, false, true);
+
+	// blocks of 16 MB; the unfinished last line of a block is carried into the next
+	vector<char> block(1 << 24);
+	size_t carried = 0, total = 0;
+	vector<MeasurementPiece> pieces(num_threads);
+
+	while (true) {
+		infile.read(block.data() + carried, block.size() - carried);
+		size_t length = carried + (size_t)infile.gcount();
+		bool last = infile.eof() || infile.fail();
+		if (length == 0)
+			break;
+
+		const char *data = block.data();
+		size_t used = length;
+		if (!last) {
+			while (used > 0 && data[used - 1] != '\n')
+				used--;
+			if (used == 0) {
+				// a single line longer than the block
+				carried = length;
+				block.resize(2 * block.size());
+				continue;
+			}
+		}
+
+		// the block is split after line breaks into one piece per thread; a block shorter than
+		// the number of threads leaves the trailing pieces empty
+		const char *end = data + used;
+		vector<const char *> bounds(num_threads + 1, end);
+		bounds[0] = data;
+		for (unsigned int k = 1; k < num_threads; k++) {
+			const char *p = std::max(bounds[k - 1], data + std::max((size_t)1, used * k / num_threads));
+			while (p < end && p[-1] != '\n')
+				p++;
+			bounds[k] = p;
+		}
+
+		parallelFor(num_threads, [&](unsigned int begin, unsigned int stop) {
+			for (unsigned int k = begin; k < stop; k++) {
+				MeasurementPiece &piece = pieces[k];
+				piece.clear();
+				if (!parseMeasurements(bounds[k], bounds[k + 1], input, photos, coef.size(), piece))
+					continue;
+				refineRange(piece.x.data(), piece.y.data(), piece.photo.data(), 0, piece.photo.size(), coef,
+					piece.x.data(), piece.y.data());
+				formatMeasurements(piece, prec);
+			}
+		}, num_threads, 1);
+
+		// the pieces are in the order of the file, so the first error is that of the first bad line
+		for (unsigned int k = 0; k < num_threads; k++) {
+			if (!pieces[k].error.empty()) {
+				cout << "Error: refineMeasurementFile - " << pieces[k].error << endl;
+				exit(1);
+			}
+		}
+
+		for (unsigned int k = 0; k < num_threads; k++) {
+			out.write(pieces[k].text.data(), pieces[k].text.size());
+			total += pieces[k].photo.size();
+		}
+
+		if (last)
+			break;
+
+		carried = length - used;
+		memmove(block.data(), block.data() + used, carried);
+	}
+
+	out.close();
+	return total;
+}
@@ -0,0 +1,90 @@
+/*
+ * The purpose of this header is to refine measured (comparator) image coordinates into
+ * photo coordinates ready for the orientations, in bulk. Every point goes through the
+ * correction stack of its photo:
+ *
+ * 1. the fitted interior orientation transformation into the fiducial system
+ * 2. the reduction to the principal point
+ * 3. the removal of radial and decentering lens distortion
+ * 4. the removal of atmospheric refraction
+ *
+ * The coordinates are corrected in vectorized, threaded chunks, and measurement files are
+ * streamed through the corrections block by block, so logs of any size can be refined in
+ * bounded memory.
+ */
+
+#pragma once
+
+#include "PointCloud.h"
+#include "SimilarityTransform2D.h"
+#include "AffineTransform2D.h"
+
+struct ImageCorrection {
+	double a, b, dx, c, d, dy; // x' = a * x + b * y + dx, y' = c * x + d * y + dy (comparator to fiducial)
+	double xp, yp;			   // the principal point in the fiducial system
+	double k1, k2, k3;		   // radial distortion: dr = k1 * r^3 + k2 * r^5 + k3 * r^7
+	double p1, p2;			   // decentering distortion
+	double focal;			   // the principal distance (needed for refraction only)
+	double refraction;		   // the refraction coefficient K [rad], see refractionCoefficient
+
+	/** ImageCorrection
+	 * the constructor of this struct; the identity, or the interior orientation
+	 * transformation of a fitted similarity or affine transformation, with no principal
+	 * point offset, distortion or refraction
+	 *
+	 * @param params - the fitted transformation from comparator to fiducial coordinates
+	 */
+	ImageCorrection();
+	ImageCorrection(const AffineParams &params);
+	ImageCorrection(const SimilarityParams &params);
+};
+
+/** refractionCoefficient
+ * the coefficient K of the standard atmosphere refraction model, with which the image
+ * displacement is dr = K * (r + r^3 / c^2)
+ *
+ * @param flying_height	 - the height of the exposure station above the datum [m]
+ * @param terrain_height - the height of the terrain above the datum [m]
+ *
+ * @return				 - the coefficient K [rad]
+ */
+double refractionCoefficient(double flying_height, double terrain_height);
+
+/** refineImageCoordinates
+ * applies the correction stack of their photos to measured image coordinates,
+ * vectorized across points where AVX2 is available and threaded across chunks. The
+ * output arrays may be the input arrays (in place)
+ *
+ * @param x, y		  - the n measured coordinates
+ * @param photo		  - the n indices of the photos of the points into corrections
+ * @param n			  - the number of points
+ * @param corrections - the correction stack of every photo
+ * @param x_out, y_out - the n refined coordinates
+ * @param num_threads - the maximum number of threads (0: one per hardware thread)
+ */
+void refineImageCoordinates(const double *x, const double *y, const uint32_t *photo, unsigned int n,
+	const vector<ImageCorrection> &corrections, double *x_out, double *y_out, unsigned int num_threads = 0);
+
+/** refineImageCoordinates
+ * refines the points of one photo; the ids are shared with the input
+ */
+PointCloud2D refineImageCoordinates(const PointCloud2D &points, const ImageCorrection &correction,
+	unsigned int num_threads = 0);
+
+/** refineMeasurementFile
+ * streams a file of measurements through the correction stacks of their photos. Every
+ * non-blank line holds a photo id, a point id and the measured x and y; the output has the
+ * same lines with the refined coordinates. The file is read in blocks, each block is
+ * parsed, corrected and formatted in parallel, and the output is written behind
+ *
+ * @param input		  - the file of measurements
+ * @param output	  - the file of refined measurements
+ * @param photos	  - the ids of the photos; corrections[k] belongs to the photo with id k
+ * @param corrections - the correction stack of every photo
+ * @param prec		  - the number of decimals of the refined coordinates
+ * @param num_threads - the maximum number of threads (0: one per hardware thread)
+ *
+ * @return			  - the number of measurements refined
+ */
+size_t refineMeasurementFile(const char *input, const char *output, const IdTable &photos,
+	const vector<ImageCorrection> &corrections, int prec = 4, unsigned int num_threads = 0);
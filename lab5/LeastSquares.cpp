@@ -13,9 +13,72 @@ Matrix delta(Matrix &A, const Matrix &w) {
 	return -1 * Qx * A.trans() * w;
 }
 
+Matrix delta(Matrix &A, const vector<double> &p, const Matrix &w) {
+	Matrix N = normalMatrix(A, p);
+	Matrix u = normalVector(A, p, w);
+
+	return -1 * N.inv() * u;
+}
+
+Matrix normalMatrix(Matrix &A, const vector<double> &p) {
+	unsigned int n = A.getrows();
+	unsigned int m = A.getcols();
+
+	if (p.size() != n) {
+		cout << "Error: normalMatrix - Number of weights does not match the design matrix" << endl;
+		exit(1);
+	}
+
+	Matrix N(m, m);
+
+	// accumulate the upper triangle row by row of A, then mirror
+	for (unsigned int i = 0; i < n; i++) {
+		if (p[i] == 0.0)
+			continue;
+
+		vector<double> &row = A[i];
+		for (unsigned int j = 0; j < m; j++) {
+			double pa = p[i] * row[j];
+			vector<double> &Nj = N[j];
+			for (unsigned int k = j; k < m; k++)
+				Nj[k] += pa * row[k];
+		}
+	}
+
+	for (unsigned int j = 0; j < m; j++)
+		for (unsigned int k = 0; k < j; k++)
+			N[j][k] = N[k][j];
+
+	return N;
+}
+
+Matrix normalVector(Matrix &A, const vector<double> &p, const Matrix &w) {
+	unsigned int n = A.getrows();
+	unsigned int m = A.getcols();
+
+	if (p.size() != n || w.getrows() != n) {
+		cout << "Error: normalVector - Weights and misclosure do not match the design matrix" << endl;
+		exit(1);
+	}
+
+	Matrix u(m, 1);
+
+	for (unsigned int i = 0; i < n; i++) {
+		double pw = p[i] * w.at(i, 0);
+		if (pw == 0.0)
+			continue;
+
+		vector<double> &row = A[i];
+		for (unsigned int j = 0; j < m; j++)
+			u[j][0] += row[j] * pw;
+	}
+
+	return u;
+}
+
 bool belowTolerances(const Matrix &delta, const Matrix &tolerances) {
 	for (unsigned int i = 0; i < delta.getrows(); i++) {
-		if (delta.at(i, 0) > tolerances.at(i, 0))
+		if (fabs(delta.at(i, 0)) > tolerances.at(i, 0))
 			return false;
 	}
 
@@ -38,6 +101,14 @@ double aposteriori(Matrix &v, double dof) {
 	return (v.trans() * v).at(0, 0) / dof;
 }
 
+double aposteriori(Matrix &v, const vector<double> &p, double dof) {
+	double vtpv = 0.0;
+	for (unsigned int i = 0; i < v.getrows(); i++)
+		vtpv += p.at(i) * v[i][0] * v[i][0];
+
+	return vtpv / dof;
+}
+
 Matrix cofactorMatrix(Matrix &A, const Matrix &P) {
 	Matrix N = A.trans() * P * A;
 	return N.inv();
@@ -48,6 +119,11 @@ Matrix cofactorMatrix(Matrix &A) {
 	return N.inv();
 }
 
+Matrix cofactorMatrix(Matrix &A, const vector<double> &p) {
+	Matrix N = normalMatrix(A, p);
+	return N.inv();
+}
+
 Matrix unknownCovariance(Matrix &A, const Matrix &P, double aposteriori) {
 	Matrix Qx = cofactorMatrix(A, P);
 	return aposteriori * Qx;
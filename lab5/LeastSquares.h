@@ -20,14 +20,53 @@
 Matrix delta(Matrix &A, const Matrix &P, const Matrix &w);
 Matrix delta(Matrix &A, const Matrix &w);
 
+/** delta
+ * Computes the delta vector of a Least-Squares adjustment with a DIAGONAL weight
+ * matrix, given only by its diagonal elements; P is never formed
+ *
+ * delta = -(A_trans * diag(p) * A)^-1 * A_trans * diag(p) * w
+ *
+ * @param A		- design matrix for the adjustment (constant)
+ * @param p		- the n diagonal weights of the observations
+ * @param w		- misclosure vector for the adjustment
+ *
+ * @return - the desired output delta vector
+ */
+Matrix delta(Matrix &A, const vector<double> &p, const Matrix &w);
+
+/** normalMatrix
+ * Computes the normal matrix of a Least-Squares adjustment with a diagonal weight matrix
+ *
+ * N = A_trans * diag(p) * A
+ *
+ * @param A - design matrix for the adjustment (constant)
+ * @param p - the n diagonal weights of the observations
+ *
+ * @return  - the u-by-u normal matrix
+ */
+Matrix normalMatrix(Matrix &A, const vector<double> &p);
+
+/** normalVector
+ * Computes the normal vector of a Least-Squares adjustment with a diagonal weight matrix
+ *
+ * u = A_trans * diag(p) * w
+ *
+ * @param A - design matrix for the adjustment (constant)
+ * @param p - the n diagonal weights of the observations
+ * @param w - misclosure vector for the adjustment
+ *
+ * @return  - the u-by-1 normal vector
+ */
+Matrix normalVector(Matrix &A, const vector<double> &p, const Matrix &w);
+
 /** belowTolerance
 * checks a delta vector against a given tolerance vector and returns whether
-* or not the delta is completely under the tolerance values
+* or not the ABSOLUTE delta is completely under the tolerance values
 *
 * @param delta		 - an n-by-1 delta vector to be checked
 * @param tolerances - an n-by-1 tolerances vector to be compared to
 *
-* @return			 - true if ALL the delta values are below their corresponding tolerance
+* @return			 - true if ALL the |delta| values are below their corresponding tolerance
 */
 bool belowTolerances(const Matrix &delta, const Matrix &tolerances);
 
@@ -73,6 +112,7 @@ Matrix residuals(Matrix &A, const Matrix &delta, const Matrix &w);
  */
 double aposteriori(Matrix &v, const Matrix &P, double dof);
 double aposteriori(Matrix &v, double dof);
+double aposteriori(Matrix &v, const vector<double> &p, double dof);
 
 /** cofactorMatrix
  * Computes the cofactor matrix of the Least-Squares adjustment
@@ -87,6 +127,7 @@ double aposteriori(Matrix &v, double dof);
  */
 Matrix cofactorMatrix(Matrix &A, const Matrix &P);
 Matrix cofactorMatrix(Matrix &A);
+Matrix cofactorMatrix(Matrix &A, const vector<double> &p);
 
 /** unknownCovariance
  * Computes the estimated covariance matrix of the Least-Squares adjustment
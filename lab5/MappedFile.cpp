@@ -0,0 +1,88 @@
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "MappedFile.h"
+#include "Matrix.h"
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const char *filename) : ptr(NULL), length(0), file(INVALID_HANDLE_VALUE), mapping(NULL) {
+	file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		cout << "Error: MappedFile - Error opening file " << filename << endl;
+		exit(1);
+	}
+
+	LARGE_INTEGER file_size;
+	GetFileSizeEx(file, &file_size);
+	length = (size_t)file_size.QuadPart;
+	if (length == 0)
+		return;
+
+	mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping != NULL)
+		ptr = (const char *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+
+	if (ptr == NULL) {
+		cout << "Error: MappedFile - Error mapping file " << filename << endl;
+		exit(1);
+	}
+}
+
+MappedFile::~MappedFile() {
+	if (ptr != NULL)
+		UnmapViewOfFile(ptr);
+	if (mapping != NULL)
+		CloseHandle(mapping);
+	if (file != INVALID_HANDLE_VALUE)
+		CloseHandle(file);
+}
+
+#else
+
+MappedFile::MappedFile(const char *filename) : ptr(NULL), length(0), fd(-1) {
+	fd = open(filename, O_RDONLY);
+	if (fd < 0) {
+		cout << "Error: MappedFile - Error opening file " << filename << endl;
+		exit(1);
+	}
+
+	struct stat st;
+	fstat(fd, &st);
+	length = (size_t)st.st_size;
+	if (length == 0)
+		return;
+
+	void *p = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (p == MAP_FAILED) {
+		cout << "Error: MappedFile - Error mapping file " << filename << endl;
+		exit(1);
+	}
+	madvise(p, length, MADV_SEQUENTIAL);
+	ptr = (const char *)p;
+}
+
+MappedFile::~MappedFile() {
+	if (ptr != NULL)
+		munmap((void *)ptr, length);
+	if (fd >= 0)
+		close(fd);
+}
+
+#endif
+
+const char *MappedFile::data() const {
+	return ptr;
+}
+
+size_t MappedFile::size() const {
+	return length;
+}
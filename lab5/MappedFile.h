@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+
+class MappedFile {
+public:
+	/** MappedFile
+	 * maps a whole file read-only into memory; the mapping is released by the destructor
+	 *
+	 * @param filename - the file to map
+	 */
+	MappedFile(const char *filename);
+	~MappedFile();
+
+	const char *data() const;
+	size_t size() const;
+private:
+	const char *ptr;
+	size_t length;
+
+#ifdef _WIN32
+	void *file;
+	void *mapping;
+#else
+	int fd;
+#endif
+
+	MappedFile(const MappedFile &);
+	MappedFile &operator=(const MappedFile &);
+};
@@ -1,7 +1,11 @@
 //Implemenation of a matrix class, Lab 4 version;
 //Author Kyle O'Keefe
 
+#include <charconv>
+
 #include "Matrix.h"
+#include "MappedFile.h"
+#include "BufferedWriter.h"
 
 //Constructor: Used to set size to zero
 Matrix::Matrix()
@@ -403,34 +407,37 @@ double Matrix::det()
 	   return det;
 }
 
-void Matrix::print(int prec, int width, const char *header,const char *footer )
+void Matrix::print(BufferedWriter &out, int prec, int width, const char *header, const char *footer)
 {
+	// overflow in fixed format can cause runtime error
+	// switch to scientific format if req'd
+	bool scientific = (maxAbsElem() > 1.0E+15);
 
-	   // set output format
-       cout.precision (prec);
-       cout.setf (std::ios::showpoint);
-       cout.setf (std::ios::fixed, std::ios::floatfield);
-
-       // overflow in fixed format can cause runtime error
-       // switch to scientific format if req'd
-       if (maxAbsElem() > 1.0E+15) 
-		   cout.setf (std::ios::scientific, std::ios::floatfield);
-
-	   cout<< header <<endl ;
+	out.write(header);
+	out.newline();
 
 	for (unsigned int i = 0; i < n_rows; i++)
 	{
 		for (unsigned int j = 0; j < n_cols; j++)
-			cout << setw(width)<<data[i][j] << flush;
+		{
+			if (scientific)
+				out.writeScientific(data[i][j], prec, width);
+			else
+				out.writeFixed(data[i][j], prec, width);
+		}
 		if ( i != n_rows-1)
-			cout << endl; //carriage return after the end of the ith row
+			out.newline(); //carriage return after the end of the ith row
 	}
-	
-	cout << "\t"<<footer << endl <<endl <<endl ;
 
-	cout.unsetf ( ios::fixed );
-	cout.setf(0,ios::floatfield);
-	return;
+	out.put('\t');
+	out.write(footer);
+	out.write("\n\n\n");
+}
+
+void Matrix::print(int prec, int width, const char *header,const char *footer )
+{
+	BufferedWriter out(cout);
+	print(out, prec, width, header, footer);
 }
 
 void Matrix::print(const char *filename,int prec, int width,const char *header,const char *footer ,ios_base::open_mode mode )
@@ -438,107 +445,70 @@ void Matrix::print(const char *filename,int prec, int width,const char *header,c
 	// mode can be on of the following:
 	// ios_base::app  --> Append to the file if it exists
 	// ios_base::out  --> Overwrite the file if it exists 
-	
-
-
-	ofstream outfile;
-	outfile.open  (filename, mode);
-
-	if (!outfile.is_open())
-	{
-		cout << "Error: print - Error opening file" << endl;
-		exit(1);
-	}
-
-//	 set output format
-       outfile.precision (prec);
-       outfile.setf (std::ios::showpoint);
-       outfile.setf (std::ios::fixed, std::ios::floatfield);
-
-//	 overflow in fixed format can cause runtime error
- //   // switch to scientific format if req'd
-	if (maxAbsElem() > 1.0E+15) 
-		cout.setf (std::ios::scientific, std::ios::floatfield);
-	
-	outfile << header << endl ;
+	BufferedWriter out(filename, (mode & ios_base::app) != 0);
+	print(out, prec, width, header, footer);
+}
 
-	for (unsigned int i = 0; i < n_rows; i++)
-	{
-			for (unsigned int j = 0; j < n_cols; j++)
-				outfile << setw(width)<<data[i][j];// << flush;
-	
-			if ( i != n_rows-1)
-				outfile << endl; //carriage return after the end of the ith row
-							
-   }
-	
-	outfile << "\t"<<footer << endl <<endl <<endl ;
+//Parse the next whitespace separated number of the text [p,end) into value and advance p
+template <typename T>
+static bool parseValue(const char *&p, const char *end, T &value)
+{
+	while (p < end && isspace((unsigned char)*p))
+		p++;
 
-	outfile.unsetf ( ios::fixed );
-	outfile.setf(0,ios::floatfield);
+	std::from_chars_result result = std::from_chars(p, end, value);
+	if (result.ec != std::errc() || result.ptr == p)
+		return false;
 
-	return; 
+	p = result.ptr;
+	return true;
+}
 
+//Parse rows*cols values of the text [p,end) into the matrix, row by row
+static void parseValues(Matrix &mat, const char *p, const char *end)
+{
+	for(unsigned int i=0; i<mat.getrows();i++)
+		for(unsigned int j=0;j<mat.getcols();j++)
+			if (!parseValue(p, end, mat.at(i,j)))
+			{
+				cout << "Error: read - Error reading element (" << i << "," << j << ")" << endl;
+				exit(1);
+			}
 }
 
 void Matrix::read(const char *filename)
 {
-	//Define and open the input file stream
-	ifstream infile;                    
-	infile.open  (filename, ifstream::in);
+	//Map the file into memory
+	MappedFile file(filename);
+	const char *p = file.data();
+	const char *end = p + file.size();
 
-	if (!infile.is_open())
+	// Read noRows and noCols from the text file
+	if (!parseValue(p, end, n_rows) || !parseValue(p, end, n_cols))
 	{
-		cout << "Error: read - Error opening file" << endl;
+		cout << "Error: read - Error reading the matrix size" << endl;
 		exit(1);
 	}
 
-	// Read noRows and noCols from the text file
-	infile >> n_rows >> n_cols;
-
 	this->resize(n_rows,n_cols);
 
-	// Define matrix to store data in
-	Matrix temp(n_rows,n_cols);
-
 	//Read in the values from the text file and store them into Read Matrix
-	for(unsigned int i=0; i<n_rows;i++)
-		for(unsigned int j=0;j<n_cols;j++)
-			infile>> this->at(i,j);
-		
-    // Close file
-	infile.close();
+	parseValues(*this, p, end);
 }
 
 
 void Matrix::read(const char *filename, unsigned int rows , unsigned int cols)
 {
-	//Define and open the input file stream
-	ifstream infile;                    
-	infile.open  (filename, ifstream::in);
-
-	if (!infile.is_open())
-	{
-		cout << "Error: read - Error opening file" << endl;
-		exit(1);
-	}
+	//Map the file into memory
+	MappedFile file(filename);
 
-	// Read noRows and noCols from the text file
 	n_rows = rows;
 	n_cols = cols;
 
 	this->resize(n_rows,n_cols);
 
-	// Define matrix to store data in
-	Matrix temp(n_rows,n_cols);
-
 	//Read in the values from the text file and store them into Read Matrix
-	for(unsigned int i=0; i<n_rows;i++)
-		for(unsigned int j=0;j<n_cols;j++)
-			infile>> this->at(i,j);
-		
-    // Close file
-	infile.close();
+	parseValues(*this, file.data(), file.data() + file.size());
 }
 
 	
@@ -11,6 +11,8 @@
 
 using namespace std;
 
+class BufferedWriter;
+
 class Matrix
 {
 	public:
@@ -53,6 +55,9 @@ class Matrix
 
 	void print(int prec = 3, int width = 12,const char *header = "",
         const char *footer = ""); //Print matrix to the screen
+
+	void print(BufferedWriter &out, int prec = 3, int width = 12, const char *header = "",
+		const char *footer = ""); //Print matrix to a buffered writer (see BufferedWriter.h)
 	
 	void read(const char* filename);  //Read a file into the matrix where the file is given by filename
 	void read(const char* filename, unsigned int rows , unsigned int cols);  //Read a file into the matrix where the file is given by filename
@@ -0,0 +1,109 @@
+#include <atomic>
+#include <mutex>
+#include "Orthophoto.h"
+#include "Parallel.h"
+#include "Projection.h"
+
+Orthophoto::Orthophoto(const Camera &camera, const SensorGeometry &sensor, const Raster &source, const DEM &dem) :
+	camera(camera), sensor(sensor), source(source), dem(dem) {
+
+	if (source.getWidth() != sensor.width || source.getHeight() != sensor.height) {
+		cout << "Error: Orthophoto - Source raster does not match the sensor geometry" << endl;
+		exit(1);
+	}
+}
+
+void Orthophoto::setOptions(const OrthoOptions &options) {
+	this->options = options;
+}
+
+unsigned long long Orthophoto::computeOrthophoto(const char *filename) {
+	if (options.cols == 0 || options.rows == 0 || options.tile_size == 0) {
+		cout << "Error: Orthophoto::computeOrthophoto Output grid is empty" << endl;
+		exit(1);
+	}
+
+	ofstream file(filename, ios::out | ios::binary | ios::trunc);
+	if (!file.is_open()) {
+		cout << "Error: Orthophoto::computeOrthophoto Could not open " << filename << endl;
+		exit(1);
+	}
+
+	unsigned int ts = options.tile_size;
+	unsigned int tile_rows = (options.rows + ts - 1) / ts;
+	unsigned int tile_cols = (options.cols + ts - 1) / ts;
+
+	std::mutex file_mutex;
+	std::atomic<unsigned long long> filled(0);
+
+	parallelFor(tile_rows * tile_cols, [&](unsigned int begin, unsigned int end) {
+		vector<unsigned char> tile;
+
+		for (unsigned int t = begin; t < end; t++) {
+			unsigned int row0 = (t / tile_cols) * ts;
+			unsigned int col0 = (t % tile_cols) * ts;
+			unsigned int rows = min(ts, options.rows - row0);
+			unsigned int cols = min(ts, options.cols - col0);
+
+			filled += computeTile(row0, col0, rows, cols, tile);
+
+			// stream the tile into place, one output row at a time
+			std::lock_guard<std::mutex> lock(file_mutex);
+			for (unsigned int r = 0; r < rows; r++) {
+				file.seekp((std::streamoff)(row0 + r) * options.cols + col0);
+				file.write((const char *)&tile[(size_t)r * cols], cols);
+			}
+		}
+	}, options.num_threads, 1);
+
+	if (!file.good()) {
+		cout << "Error: Orthophoto::computeOrthophoto Could not write " << filename << endl;
+		exit(1);
+	}
+
+	return filled;
+}
+
+unsigned int Orthophoto::computeTile(unsigned int row0, unsigned int col0, unsigned int rows, unsigned int cols,
+	vector<unsigned char> &tile) const {
+
+	unsigned int n = rows * cols;
+	tile.assign(n, options.no_data);
+
+	// ground coordinates of the tile, lifted onto the DEM
+	vector<double> X(n), Y(n), Z(n), x, y;
+	vector<unsigned char> on_dem(n), visible;
+
+	for (unsigned int r = 0; r < rows; r++)
+		for (unsigned int c = 0; c < cols; c++) {
+			unsigned int i = r * cols + c;
+			X[i] = options.x0 + (col0 + c) * options.gsd;
+			Y[i] = options.y0 - (row0 + r) * options.gsd;
+			on_dem[i] = dem.height(X[i], Y[i], Z[i]) ? 1 : 0;
+		}
+
+	// the tiles are already spread over the threads
+	ProjectionOptions projection_options;
+	projection_options.num_threads = 1;
+
+	Projection projection(camera);
+	projection.setOptions(projection_options);
+	projection.project(X, Y, Z, x, y, visible);
+
+	unsigned int filled = 0;
+	for (unsigned int i = 0; i < n; i++) {
+		if (!on_dem[i] || !visible[i])
+			continue;
+
+		double col = sensor.cx + x[i] / sensor.pixel_size;
+		double row = sensor.cy - y[i] / sensor.pixel_size;
+
+		double value;
+		if (source.sample(col, row, value)) {
+			tile[i] = (unsigned char)(value + 0.5);
+			filled++;
+		}
+	}
+
+	return filled;
+}
@@ -0,0 +1,63 @@
+/*
+ * The purpose of this header is to provide the ortho-rectification of an oriented photo.
+ * Every ground cell of the output grid is lifted onto the DEM, projected into the photo
+ * with the collinearity equations and resampled bilinearly from the source raster.
+ *
+ * The output is processed in square tiles; each thread works on one tile at a time and
+ * writes it straight into the output file, so the memory used is bounded by the number
+ * of threads and the tile size, not by the size of the orthophoto.
+ */
+
+#pragma once
+
+#include "Camera.h"
+#include "Raster.h"
+
+struct OrthoOptions {
+	double x0, y0;			  // object coordinates of the centre of the upper left output pixel
+	double gsd;				  // ground sample distance of the output
+	unsigned int cols, rows;  // dimensions of the output [pixels]
+	unsigned int tile_size;	  // edge length of the square tiles [pixels]
+	unsigned int num_threads; // 0: one thread per hardware thread
+	unsigned char no_data;	  // value of cells outside of the DEM or the photo
+
+	OrthoOptions() : x0(0), y0(0), gsd(1), cols(0), rows(0), tile_size(256), num_threads(0), no_data(0) {}
+};
+
+class Orthophoto {
+public:
+	/** Orthophoto
+	 * the constructor of this class
+	 *
+	 * @param camera - the oriented photo (e.g. Resection::getCamera())
+	 * @param sensor - the pixel geometry of the source raster
+	 * @param source - the source raster of the photo
+	 * @param dem	 - the elevation model of the ground
+	 */
+	Orthophoto(const Camera &camera, const SensorGeometry &sensor, const Raster &source, const DEM &dem);
+
+	void setOptions(const OrthoOptions &options);
+
+	/** computeOrthophoto
+	 * ortho-rectifies the photo into a plain binary raster of cols * rows bytes
+	 *
+	 * @param filename - the output file
+	 *
+	 * @return		   - the number of output pixels filled from the photo
+	 */
+	unsigned long long computeOrthophoto(const char *filename);
+private:
+	Camera camera;
+	SensorGeometry sensor;
+	const Raster &source;
+	const DEM &dem;
+	OrthoOptions options;
+
+	/** computeTile
+	 * fills the tile buffer for the output pixels [row0, row0 + rows) x [col0, col0 + cols)
+	 *
+	 * @return - the number of pixels filled from the photo
+	 */
+	unsigned int computeTile(unsigned int row0, unsigned int col0, unsigned int rows, unsigned int cols,
+		vector<unsigned char> &tile) const;
+};
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+/** parallelFor
+ * splits the range [0, n) into contiguous chunks and calls body(begin, end) for each
+ * chunk on its own thread. Small ranges are run on the calling thread
+ *
+ * @param n			  - the size of the range
+ * @param body		  - callable as body(unsigned int begin, unsigned int end)
+ * @param num_threads - the maximum number of threads (0: one per hardware thread)
+ * @param min_chunk	  - the minimum number of items given to a thread
+ */
+template <typename Body>
+void parallelFor(unsigned int n, const Body &body, unsigned int num_threads = 0, unsigned int min_chunk = 1024) {
+	if (num_threads == 0)
+		num_threads = std::max(1u, std::thread::hardware_concurrency());
+
+	unsigned int chunks = std::min(num_threads, (n + min_chunk - 1) / std::max(1u, min_chunk));
+	if (chunks <= 1) {
+		if (n > 0)
+			body(0u, n);
+		return;
+	}
+
+	std::vector<std::thread> threads;
+	threads.reserve(chunks - 1);
+
+	unsigned int step = (n + chunks - 1) / chunks;
+	for (unsigned int begin = step; begin < n; begin += step)
+		threads.push_back(std::thread(body, begin, std::min(n, begin + step)));
+
+	body(0u, std::min(n, step));
+
+	for (unsigned int t = 0; t < threads.size(); t++)
+		threads[t].join();
+}
@@ -1,6 +1,13 @@
+#include <mutex>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
 #include "Photo.h"
+#include "Parallel.h"
 
-void similarity_A(Matrix &A, PointList &coordinates) {
+void similarity_A(Matrix &A, const vector<Point2D> &coordinates) {
 	int n = coordinates.size();
 	A.resize(2 * n, 4);
 	A.clear();
@@ -16,44 +23,50 @@ void similarity_A(Matrix &A, PointList &coordinates) {
 	}
 }
 
-void similarity_N(Matrix &N, PointList &coordinates) {
-	int n = coordinates.size();
-	N.resize(4, 4);
-	N.clear();
+typedef void (*Normals)(const double *, const double *, const double *, const double *, const double *,
+	unsigned int, const double *, double *, double *, unsigned int);
 
-	for (int i = 0; i < n; i++) {
-		N[0][0] += coordinates[i].x * coordinates[i].x + coordinates[i].y * coordinates[i].y;
-		N[0][2] += coordinates[i].x;
-		N[0][3] += coordinates[i].y;
+// the unweighted normals of a transformation from the points, through similarityNormals or
+// affineNormals; the origin is zero, so the parameters map the coordinates themselves
+static void pointNormals(Normals normals, unsigned int size, const vector<Point2D> &coordinates,
+	const vector<Point2D> &observations, Matrix *N, Matrix *u) {
+
+	unsigned int n = coordinates.size();
+	vector<double> x(n), y(n), X(n), Y(n);
+	for (unsigned int i = 0; i < n; i++) {
+		x[i] = coordinates[i].x;
+		y[i] = coordinates[i].y;
+		X[i] = observations[i].x;
+		Y[i] = observations[i].y;
 	}
-	N[1][1] = N[0][0];
-	N[2][2] = n;
-	N[3][3] = n;
 
-	N[2][0] = N[0][2];
-	N[1][3] = N[0][2];
-	N[3][1] = N[0][2];
+	const double origin[4] = { 0.0, 0.0, 0.0, 0.0 };
+	vector<double> n_rows(size * size), u_rows(size);
+	normals(x.data(), y.data(), X.data(), Y.data(), NULL, n, origin, n_rows.data(), u_rows.data(), 0);
+
+	if (N != NULL) {
+		N->resize(size, size);
+		for (unsigned int i = 0; i < size; i++)
+			for (unsigned int j = 0; j < size; j++)
+				(*N)[i][j] = n_rows[i * size + j];
+	}
 
-	N[3][0] = N[0][3];
-	N[1][2] = -N[0][3];
-	N[2][1] = -N[0][3];
+	if (u != NULL) {
+		u->resize(size, 1);
+		for (unsigned int i = 0; i < size; i++)
+			(*u)[i][0] = u_rows[i];
+	}
 }
 
-void similarity_u(Matrix &u, PointList &coordinates, PointList &observations) {
-	int n = coordinates.size();
-	u.resize(4, 1);
-	u.clear();
+void similarity_N(Matrix &N, const vector<Point2D> &coordinates) {
+	pointNormals(similarityNormals, 4, coordinates, coordinates, &N, NULL);
+}
 
-	int xy = 0;
-	for (int i = 0; i < n; i++) {
-		u[0][0] += coordinates[i].x * observations[i].x + coordinates[i].y * observations[i].y;
-		u[1][0] += coordinates[i].x * observations[i].y - coordinates[i].y * observations[i].x;
-		u[2][0] += observations[i].x;
-		u[3][0] += observations[i].y;
-	}
+void similarity_u(Matrix &u, const vector<Point2D> &coordinates, const vector<Point2D> &observations) {
+	pointNormals(similarityNormals, 4, coordinates, observations, NULL, &u);
 }
 
-void affine_A(Matrix &A, PointList &coordinates) {
+void affine_A(Matrix &A, const vector<Point2D> &coordinates) {
 	int n = coordinates.size();
 	A.resize(2 * n, 6);
 	A.clear();
@@ -68,38 +81,238 @@ void affine_A(Matrix &A, PointList &coordinates) {
 	}
 }
 
-void affine_N(Matrix &N, PointList &coordinates) {
-	int n = coordinates.size();
-	N.resize(6, 6);
-	N.clear();
-	
-	for (int j = 0; j <= 3; j += 3) {
-		for (int i = 0; i < n; i++) {
-			N[j][j] += coordinates[i].x * coordinates[i].x;
-			N[j][j + 1] += coordinates[i].x * coordinates[i].y;
-			N[j][j + 2] += coordinates[i].x;
-			N[j + 1][j + 1] += coordinates[i].y * coordinates[i].y;
-			N[j + 1][j + 2] += coordinates[i].y;
+void affine_N(Matrix &N, const vector<Point2D> &coordinates) {
+	pointNormals(affineNormals, 6, coordinates, coordinates, &N, NULL);
+}
+
+void affine_u(Matrix &u, const vector<Point2D> &coordinates, const vector<Point2D> &observations) {
+	pointNormals(affineNormals, 6, coordinates, observations, NULL, &u);
+}
+
+#ifdef __AVX2__
+// the weights of four points from the interleaved x, y weights at p
+static inline void loadWeights(const double *p, __m256d &px, __m256d &py) {
+	__m256d p0 = _mm256_loadu_pd(p), p1 = _mm256_loadu_pd(p + 4);
+	px = _mm256_permute4x64_pd(_mm256_unpacklo_pd(p0, p1), 0xD8);
+	py = _mm256_permute4x64_pd(_mm256_unpackhi_pd(p0, p1), 0xD8);
+}
+
+// adds the four lanes of each accumulator to the sums
+static inline void addLanes(const __m256d *acc, unsigned int count, double *sums) {
+	double lanes[4];
+	for (unsigned int k = 0; k < count; k++) {
+		_mm256_storeu_pd(lanes, acc[k]);
+		sums[k] += (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+	}
+}
+#endif
+
+/*
+ * the points [begin, end) of similarityNormals, into the 13 sums
+ *
+ * px x^2 + py y^2, px y^2 + py x^2, (py - px) x y, px x, py y, px y, py x, px, py,
+ * px X x + py Y y, py Y x - px X y, px X, py Y
+ */
+static void similarityRange(const double *x, const double *y, const double *X, const double *Y, const double *p,
+	unsigned int begin, unsigned int end, const double *origin, double *sums) {
+
+	unsigned int i = begin;
+
+#ifdef __AVX2__
+	const __m256d x0 = _mm256_set1_pd(origin[0]), y0 = _mm256_set1_pd(origin[1]);
+	const __m256d X0 = _mm256_set1_pd(origin[2]), Y0 = _mm256_set1_pd(origin[3]);
+	const __m256d one = _mm256_set1_pd(1.0);
+
+	__m256d acc[13];
+	for (unsigned int k = 0; k < 13; k++)
+		acc[k] = _mm256_setzero_pd();
+
+	for (; i + 4 <= end; i += 4) {
+		const __m256d xi = _mm256_sub_pd(_mm256_loadu_pd(x + i), x0), yi = _mm256_sub_pd(_mm256_loadu_pd(y + i), y0);
+		const __m256d Xi = _mm256_sub_pd(_mm256_loadu_pd(X + i), X0), Yi = _mm256_sub_pd(_mm256_loadu_pd(Y + i), Y0);
+
+		__m256d px = one, py = one;
+		if (p != NULL)
+			loadWeights(p + 2 * i, px, py);
+
+		const __m256d xx = _mm256_mul_pd(xi, xi), yy = _mm256_mul_pd(yi, yi), xy = _mm256_mul_pd(xi, yi);
+		const __m256d pxX = _mm256_mul_pd(px, Xi), pyY = _mm256_mul_pd(py, Yi);
+
+		acc[0] = _mm256_add_pd(acc[0], _mm256_add_pd(_mm256_mul_pd(px, xx), _mm256_mul_pd(py, yy)));
+		acc[1] = _mm256_add_pd(acc[1], _mm256_add_pd(_mm256_mul_pd(px, yy), _mm256_mul_pd(py, xx)));
+		acc[2] = _mm256_add_pd(acc[2], _mm256_mul_pd(_mm256_sub_pd(py, px), xy));
+		acc[3] = _mm256_add_pd(acc[3], _mm256_mul_pd(px, xi));
+		acc[4] = _mm256_add_pd(acc[4], _mm256_mul_pd(py, yi));
+		acc[5] = _mm256_add_pd(acc[5], _mm256_mul_pd(px, yi));
+		acc[6] = _mm256_add_pd(acc[6], _mm256_mul_pd(py, xi));
+		acc[7] = _mm256_add_pd(acc[7], px);
+		acc[8] = _mm256_add_pd(acc[8], py);
+		acc[9] = _mm256_add_pd(acc[9], _mm256_add_pd(_mm256_mul_pd(pxX, xi), _mm256_mul_pd(pyY, yi)));
+		acc[10] = _mm256_add_pd(acc[10], _mm256_sub_pd(_mm256_mul_pd(pyY, xi), _mm256_mul_pd(pxX, yi)));
+		acc[11] = _mm256_add_pd(acc[11], pxX);
+		acc[12] = _mm256_add_pd(acc[12], pyY);
+	}
+
+	addLanes(acc, 13, sums);
+#endif
+
+	for (; i < end; i++) {
+		double xi = x[i] - origin[0], yi = y[i] - origin[1];
+		double Xi = X[i] - origin[2], Yi = Y[i] - origin[3];
+		double px = (p != NULL) ? p[2 * i] : 1.0, py = (p != NULL) ? p[2 * i + 1] : 1.0;
+
+		sums[0] += px * xi * xi + py * yi * yi;
+		sums[1] += px * yi * yi + py * xi * xi;
+		sums[2] += (py - px) * xi * yi;
+		sums[3] += px * xi;
+		sums[4] += py * yi;
+		sums[5] += px * yi;
+		sums[6] += py * xi;
+		sums[7] += px;
+		sums[8] += py;
+		sums[9] += px * Xi * xi + py * Yi * yi;
+		sums[10] += py * Yi * xi - px * Xi * yi;
+		sums[11] += px * Xi;
+		sums[12] += py * Yi;
+	}
+}
+
+/*
+ * the points [begin, end) of affineNormals, into the 9 sums of the X rows followed by the 9
+ * sums of the Y rows
+ *
+ * p x^2, p x y, p y^2, p x, p y, p, p L x, p L y, p L
+ *
+ * where p and L are the weight and the observation (X or Y) of the row
+ */
+static void affineRange(const double *x, const double *y, const double *X, const double *Y, const double *p,
+	unsigned int begin, unsigned int end, const double *origin, double *sums) {
+
+	unsigned int i = begin;
+
+#ifdef __AVX2__
+	const __m256d x0 = _mm256_set1_pd(origin[0]), y0 = _mm256_set1_pd(origin[1]);
+	const __m256d X0 = _mm256_set1_pd(origin[2]), Y0 = _mm256_set1_pd(origin[3]);
+	const __m256d one = _mm256_set1_pd(1.0);
+
+	__m256d acc[18];
+	for (unsigned int k = 0; k < 18; k++)
+		acc[k] = _mm256_setzero_pd();
+
+	for (; i + 4 <= end; i += 4) {
+		const __m256d xi = _mm256_sub_pd(_mm256_loadu_pd(x + i), x0), yi = _mm256_sub_pd(_mm256_loadu_pd(y + i), y0);
+		const __m256d Xi = _mm256_sub_pd(_mm256_loadu_pd(X + i), X0), Yi = _mm256_sub_pd(_mm256_loadu_pd(Y + i), Y0);
+
+		__m256d pw[2] = { one, one };
+		if (p != NULL)
+			loadWeights(p + 2 * i, pw[0], pw[1]);
+
+		const __m256d xx = _mm256_mul_pd(xi, xi), yy = _mm256_mul_pd(yi, yi), xy = _mm256_mul_pd(xi, yi);
+		const __m256d L[2] = { Xi, Yi };
+
+		for (unsigned int r = 0; r < 2; r++) {
+			__m256d *a = acc + 9 * r;
+			const __m256d pL = _mm256_mul_pd(pw[r], L[r]);
+
+			a[0] = _mm256_add_pd(a[0], _mm256_mul_pd(pw[r], xx));
+			a[1] = _mm256_add_pd(a[1], _mm256_mul_pd(pw[r], xy));
+			a[2] = _mm256_add_pd(a[2], _mm256_mul_pd(pw[r], yy));
+			a[3] = _mm256_add_pd(a[3], _mm256_mul_pd(pw[r], xi));
+			a[4] = _mm256_add_pd(a[4], _mm256_mul_pd(pw[r], yi));
+			a[5] = _mm256_add_pd(a[5], pw[r]);
+			a[6] = _mm256_add_pd(a[6], _mm256_mul_pd(pL, xi));
+			a[7] = _mm256_add_pd(a[7], _mm256_mul_pd(pL, yi));
+			a[8] = _mm256_add_pd(a[8], pL);
 		}
-		N[j + 2][j + 2] = n;
+	}
+
+	addLanes(acc, 18, sums);
+#endif
+
+	for (; i < end; i++) {
+		double xi = x[i] - origin[0], yi = y[i] - origin[1];
+		double L[2] = { X[i] - origin[2], Y[i] - origin[3] };
+
+		for (unsigned int r = 0; r < 2; r++) {
+			double pr = (p != NULL) ? p[2 * i + r] : 1.0;
+			double *s = sums + 9 * r;
 
-		N[j + 1][j] = N[j][j + 1];
-		N[j + 2][j] = N[j][j + 2];
-		N[j + 2][j + 1] = N[j + 1][j + 2];
+			s[0] += pr * xi * xi;
+			s[1] += pr * xi * yi;
+			s[2] += pr * yi * yi;
+			s[3] += pr * xi;
+			s[4] += pr * yi;
+			s[5] += pr;
+			s[6] += pr * L[r] * xi;
+			s[7] += pr * L[r] * yi;
+			s[8] += pr * L[r];
+		}
 	}
 }
 
-void affine_u(Matrix &u, PointList &coordinates, PointList &observations) {
-	int n = coordinates.size();
-	u.resize(6, 1);
-	u.clear();
+// sums a range kernel over [0, n) on several threads
+template <typename Range>
+static void sumPoints(unsigned int n, unsigned int count, double *sums, unsigned int num_threads, const Range &range) {
+	std::fill(sums, sums + count, 0.0);
+	std::mutex sums_mutex;
 
-	for (int i = 0; i < n; i++) {
-		u[0][0] += coordinates[i].x * observations[i].x;
-		u[1][0] += coordinates[i].y * observations[i].x;
-		u[2][0] += observations[i].x;
-		u[3][0] += coordinates[i].x * observations[i].y;
-		u[4][0] += coordinates[i].y * observations[i].y;
-		u[5][0] += observations[i].y;
+	parallelFor(n, [&](unsigned int begin, unsigned int end) {
+		double local[18] = {};
+		range(begin, end, local);
+
+		std::lock_guard<std::mutex> lock(sums_mutex);
+		for (unsigned int k = 0; k < count; k++)
+			sums[k] += local[k];
+	}, num_threads, 65536);
+}
+
+void similarityNormals(const double *x, const double *y, const double *X, const double *Y, const double *p,
+	unsigned int n, const double *origin, double *N, double *u, unsigned int num_threads) {
+
+	double s[13];
+	sumPoints(n, 13, s, num_threads, [&](unsigned int begin, unsigned int end, double *sums) {
+		similarityRange(x, y, X, Y, p, begin, end, origin, sums);
+	});
+
+	const double rows[16] = {
+		s[0],  s[2], s[3], s[4],
+		s[2],  s[1], -s[5], s[6],
+		s[3], -s[5], s[7], 0.0,
+		s[4],  s[6], 0.0,  s[8] };
+	std::copy(rows, rows + 16, N);
+
+	u[0] = s[9];
+	u[1] = s[10];
+	u[2] = s[11];
+	u[3] = s[12];
+}
+
+void affineNormals(const double *x, const double *y, const double *X, const double *Y, const double *p,
+	unsigned int n, const double *origin, double *N, double *u, unsigned int num_threads) {
+
+	double s[18];
+	sumPoints(n, 18, s, num_threads, [&](unsigned int begin, unsigned int end, double *sums) {
+		affineRange(x, y, X, Y, p, begin, end, origin, sums);
+	});
+
+	// two independent 3-by-3 blocks, for [a, b, dx] and [c, d, dy]
+	std::fill(N, N + 36, 0.0);
+	for (unsigned int r = 0; r < 2; r++) {
+		const double *b = s + 9 * r;
+		double *block = N + 21 * r; // N[3r][3r]
+
+		block[0] = b[0];
+		block[1] = b[1];
+		block[2] = b[3];
+		block[6] = b[1];
+		block[7] = b[2];
+		block[8] = b[4];
+		block[12] = b[3];
+		block[13] = b[4];
+		block[14] = b[5];
+
+		u[3 * r] = b[6];
+		u[3 * r + 1] = b[7];
+		u[3 * r + 2] = b[8];
 	}
-}
\ No newline at end of file
+}
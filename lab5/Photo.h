@@ -1,6 +1,7 @@
 /*
  * The purpose of this header is to provide the design matrices to the user that
- * are required when attempting complete an affine and/or similarity transformation
+ * are required when attempting complete an affine and/or similarity transformation,
+ * and the normal equations of both transformations summed directly from the points
  */
 
 #pragma once
@@ -14,17 +15,19 @@
  * @param A			  - the desired output design matrix
  * @param coordinates - "from" coordinates for determinng the design matrix
  */
-void similarity_A(Matrix &A, PointList &coordinates);
+void similarity_A(Matrix &A, const vector<Point2D> &coordinates);
 
 /** similarity_N
  * Computes a 4-by-4 normal matrix for a linear similarity transformation
  * 
  * N = A_trans * A
  * 
+ * summed by similarityNormals with unit weights and a zero origin
+ * 
  * @param N			  - the desired output normal matrix
  * @param coordinates - "from" coordinates for determining the normal matrix
  */
-void similarity_N(Matrix &N, PointList &coordinates);
+void similarity_N(Matrix &N, const vector<Point2D> &coordinates);
 
 /** similarity_u
  * Computes a 4-by-1 normal vector for a linear similarity transformation
@@ -36,7 +39,7 @@ void similarity_N(Matrix &N, PointList &coordinates);
  * @param coordinates  - "from" coordinates for determining the normal vector
  * @param observations - "to" coordinates acting as the misclosure vector with f(x) = 0
  */
-void similarity_u(Matrix &u, PointList &coordinates, PointList &observations);
+void similarity_u(Matrix &u, const vector<Point2D> &coordinates, const vector<Point2D> &observations);
 
 /** affine_A
  * Computes an N-by-6 design matrix for a linear affine transformation
@@ -44,17 +47,19 @@ void similarity_u(Matrix &u, PointList &coordinates, PointList &observations);
  * @param A			  - the desired output design matrix
  * @param coordinates - "from" coordinates for determining the design matrix
  */
-void affine_A(Matrix &A, PointList &coordinates);
+void affine_A(Matrix &A, const vector<Point2D> &coordinates);
 
 /** affine_N
  * Computes a 6-by-6 normal matrix for a linear affine transformation
  * 
  * N = A_trans * A
  * 
+ * summed by affineNormals with unit weights and a zero origin
+ * 
  * @param N			  - the desired output normal matrix
  * @param coordinates - "from" coordinates for determining the normal matrix
  */
-void affine_N(Matrix &N, PointList &coordinates);
+void affine_N(Matrix &N, const vector<Point2D> &coordinates);
 
 /** affine_u
  * Computes a 6-by-1 normal vector for a linear affine transformation
@@ -66,4 +71,91 @@ void affine_N(Matrix &N, PointList &coordinates);
  * @param coordinates  - "from" coordinates for determining the normal vector
  * @param observations - "to" coordinates acting as the misclosure vector with f(x) = 0
  */
-void affine_u(Matrix &u, PointList &coordinates, PointList &observations);
+void affine_u(Matrix &u, const vector<Point2D> &coordinates, const vector<Point2D> &observations);
+
+/** similarityNormals
+ * accumulates the 4-by-4 normal matrix and 4-by-1 normal vector of a weighted linear
+ * similarity transformation in one pass over the points, without a design matrix;
+ * vectorized across points where AVX2 is available and threaded across chunks
+ *
+ * X = a * x - b * y + dx
+ * Y = b * x + a * y + dy
+ *
+ * The coordinates are reduced by an origin as they are summed, which keeps the sums
+ * accurate for large coordinates; the parameters then map the reduced coordinates
+ *
+ * @param x, y		  - the n "from" coordinates
+ * @param X, Y		  - the n "to" coordinates, the observations
+ * @param p			  - the 2n weights of the observations in the order x0, y0, x1, y1, ...
+ *						(NULL for unit weights)
+ * @param n			  - the number of points
+ * @param origin	  - the origins {x0, y0, X0, Y0} of the "from" and "to" coordinates
+ * @param N			  - 16 elements, the row-major normal matrix of [a, b, dx, dy]
+ * @param u			  - 4 elements, the normal vector
+ * @param num_threads - the maximum number of threads (0: one per hardware thread)
+ */
+void similarityNormals(const double *x, const double *y, const double *X, const double *Y, const double *p,
+	unsigned int n, const double *origin, double *N, double *u, unsigned int num_threads = 0);
+
+/** affineNormals
+ * accumulates the 6-by-6 normal matrix and 6-by-1 normal vector of a weighted linear
+ * affine transformation in one pass over the points, like similarityNormals
+ *
+ * X = a * x + b * y + dx
+ * Y = c * x + d * y + dy
+ *
+ * @param N - 36 elements, the row-major normal matrix of [a, b, dx, c, d, dy]
+ * @param u - 6 elements, the normal vector
+ */
+void affineNormals(const double *x, const double *y, const double *X, const double *Y, const double *p,
+	unsigned int n, const double *origin, double *N, double *u, unsigned int num_threads = 0);
+
+/** choleskySolve
+ * solves a small symmetric positive definite system N * x = u by a Cholesky
+ * decomposition; the size is a template parameter, so the loops have constant bounds
+ * and unroll
+ *
+ * @param N - the size-by-size row-major matrix (only the lower triangle is read)
+ * @param u - the right-hand side
+ * @param x - the solution (may be u)
+ *
+ * @return  - false if N is not positive definite
+ */
+template <unsigned int size>
+bool choleskySolve(const double *N, const double *u, double *x) {
+	double L[size * size];
+
+	for (unsigned int i = 0; i < size; i++) {
+		for (unsigned int j = 0; j <= i; j++) {
+			double s = N[i * size + j];
+			for (unsigned int k = 0; k < j; k++)
+				s -= L[i * size + k] * L[j * size + k];
+
+			if (i == j) {
+				if (!(s > 0.0))
+					return false;
+				L[i * size + i] = sqrt(s);
+			}
+			else
+				L[i * size + j] = s / L[j * size + j];
+		}
+	}
+
+	// L * y = u, then L_trans * x = y
+	double y[size];
+	for (unsigned int i = 0; i < size; i++) {
+		double s = u[i];
+		for (unsigned int k = 0; k < i; k++)
+			s -= L[i * size + k] * y[k];
+		y[i] = s / L[i * size + i];
+	}
+
+	for (unsigned int i = size; i-- > 0;) {
+		double s = y[i];
+		for (unsigned int k = i + 1; k < size; k++)
+			s -= L[k * size + i] * x[k];
+		x[i] = s / L[i * size + i];
+	}
+
+	return true;
+}
@@ -1,4 +1,8 @@
 #include "Point.h"
+#include "PointCloud.h"
+#include "TextParser.h"
+#include "BinaryFormat.h"
+#include "BufferedWriter.h"
 
 vector<Point3D> increaseDimension(const vector<Point2D> &points2D) {
 	return increaseDimension(points2D, 0);
@@ -6,8 +10,9 @@ vector<Point3D> increaseDimension(const vector<Point2D> &points2D) {
 
 vector<Point3D> increaseDimension(const vector<Point2D> &points2D, double value) {
 	vector<Point3D> points3D;
+	points3D.reserve(points2D.size());
 
-	for (Point2D p : points2D) {
+	for (const Point2D &p : points2D) {
 		points3D.push_back(Point3D(p.x, p.y, value));
 	}
 	
@@ -16,8 +21,9 @@ vector<Point3D> increaseDimension(const vector<Point2D> &points2D, double value)
 
 vector<Point2D> decreaseDimension(const vector<Point3D> &points3D) {
 	vector<Point2D> points2D;
+	points2D.reserve(points3D.size());
 
-	for (Point3D p : points3D) {
+	for (const Point3D &p : points3D) {
 		points2D.push_back(Point2D(p.x, p.y));
 	}
 
@@ -25,13 +31,22 @@ vector<Point2D> decreaseDimension(const vector<Point3D> &points3D) {
 }
 
 vector<Point3D> transformPoints(const vector<Point3D> &points, double scale, const RotationMatrix &R, const Point3D &T) {
-	vector<Point3D> transformed;
+	unsigned int n = points.size();
 
-	for (Point3D p : points) {
-		p.transform(scale, R, T);
-		transformed.push_back(p);
+	vector<double> X(n), Y(n), Z(n);
+	for (unsigned int i = 0; i < n; i++) {
+		X[i] = points[i].x;
+		Y[i] = points[i].y;
+		Z[i] = points[i].z;
 	}
 
+	transformPoints(X.data(), Y.data(), Z.data(), n, scale, R, T, X.data(), Y.data(), Z.data());
+
+	vector<Point3D> transformed;
+	transformed.reserve(n);
+	for (unsigned int i = 0; i < n; i++)
+		transformed.push_back(Point3D(points[i].id, X[i], Y[i], Z[i]));
+
 	return transformed;
 }
 
@@ -59,7 +74,7 @@ Matrix convertToVector(const vector<Point3D> &points) {
 }
 
 GeodeticPoint findPoint(const vector<GeodeticPoint> &points, string id) {
-	for (GeodeticPoint gp : points) {
+	for (const GeodeticPoint &gp : points) {
 		if (gp.id == id)
 			return gp;
 	}
@@ -67,7 +82,7 @@ GeodeticPoint findPoint(const vector<GeodeticPoint> &points, string id) {
 }
 
 Point2D findPoint(const vector<Point2D> &points, string id) {
-	for (Point2D p : points) {
+	for (const Point2D &p : points) {
 		if (p.id == id)
 			return p;
 	}
@@ -75,7 +90,7 @@ Point2D findPoint(const vector<Point2D> &points, string id) {
 }
 
 Point3D findPoint(const vector<Point3D> &points, string id) {
-	for (Point3D p : points) {
+	for (const Point3D &p : points) {
 		if (p.id == id)
 			return p;
 	}
@@ -85,7 +100,7 @@ Point3D findPoint(const vector<Point3D> &points, string id) {
 vector<GeodeticPoint> findPoints(const vector<GeodeticPoint> &points, string id) {
 	vector<GeodeticPoint> found;
 	
-	for (GeodeticPoint gp : points) {
+	for (const GeodeticPoint &gp : points) {
 		if (gp.id == id)
 			found.push_back(gp);
 	}
@@ -96,7 +111,7 @@ vector<GeodeticPoint> findPoints(const vector<GeodeticPoint> &points, string id)
 vector<Point2D> findPoints(const vector<Point2D> &points, string id) {
 	vector<Point2D> found;
 
-	for (Point2D p : points) {
+	for (const Point2D &p : points) {
 		if (p.id == id)
 			found.push_back(p);
 	}
@@ -107,7 +122,7 @@ vector<Point2D> findPoints(const vector<Point2D> &points, string id) {
 vector<Point3D> findPoints(const vector<Point3D> &points, string id) {
 	vector<Point3D> found;
 
-	for (Point3D p : points) {
+	for (const Point3D &p : points) {
 		if (p.id == id)
 			found.push_back(p);
 	}
@@ -115,28 +130,31 @@ vector<Point3D> findPoints(const vector<Point3D> &points, string id) {
 	return found;
 }
 
+// the 3D points of a binary file, which must be tagged with the content the reader expects;
+// geodetic and cartesian clouds share a layout, so only the tag tells them apart
+static PointCloud3D binaryCloud3D(const string &filename, BinaryContent content, const char *function) {
+	BinaryFile file(filename.c_str());
+	if (file.getContent() != content) {
+		cout << "Error: " << function << " - " << filename << " does not hold "
+			<< (content == BinaryContent::Geodetic ? "geodetic" : "3D") << " points" << endl;
+		exit(1);
+	}
+	return file.toCloud3D();
+}
+
 vector<GeodeticPoint> readGeodeticPoints(string prompt) {
 	string filename;
 	std::cout << prompt;
 	getline(std::cin, filename);
 
-	ifstream infile;
-	infile.open(filename, ifstream::in);
-
-	if (!infile.is_open())
-	{
-		std::cout << "Error: read - Error opening file" << std::endl;
-		exit(1);
-	}
+	PointCloud3D cloud = isBinaryFile(filename.c_str())
+		? binaryCloud3D(filename, BinaryContent::Geodetic, "readGeodeticPoints")
+		: parseGeodeticPoints(filename.c_str());
 
 	vector<GeodeticPoint> points;
-
-	GeodeticPoint p;
-	while (infile >> p.id >> p.lat >> p.lon >> p.h) {
-		points.push_back(p);
-	}
-
-	infile.close();
+	points.reserve(cloud.size());
+	for (unsigned int i = 0; i < cloud.size(); i++)
+		points.push_back(GeodeticPoint(cloud.name(i), cloud.x[i], cloud.y[i], cloud.z[i]));
 
 	return points;
 }
@@ -146,25 +164,9 @@ vector<Point2D> read2DPoints(string prompt) {
 	std::cout << prompt;
 	std::getline(std::cin, filename);
 
-	ifstream infile;
-	infile.open(filename, ifstream::in);
-
-	if (!infile.is_open())
-	{
-		std::cout << "Error: read - Error opening file" << std::endl;
-		exit(1);
-	}
-
-	vector<Point2D> points;
-
-	Point2D p;
-	while (infile >> p.id >> p.x >> p.y) {
-		points.push_back(p);
-	}
-
-	infile.close();
-
-	return points;
+	if (isBinaryFile(filename.c_str()))
+		return BinaryFile(filename.c_str()).toCloud2D().toPoints();
+	return parse2DPoints(filename.c_str()).toPoints();
 }
 
 vector<Point3D> read3DPoints(string prompt) {
@@ -172,63 +174,35 @@ vector<Point3D> read3DPoints(string prompt) {
 	std::cout << prompt;
 	std::getline(std::cin, filename);
 
-	ifstream infile;
-	infile.open(filename, ifstream::in);
-
-	if (!infile.is_open())
-	{
-		std::cout << "Error: read - Error opening file" << std::endl;
-		exit(1);
-	}
-
-	vector<Point3D> points;
-
-	Point3D p;
-	while (infile >> p.id >> p.x >> p.y >> p.z) {
-		points.push_back(p);
-	}
-
-	infile.close();
-
-	return points;
+	if (isBinaryFile(filename.c_str()))
+		return binaryCloud3D(filename, BinaryContent::Points3D, "read3DPoints").toPoints();
+	return parse3DPoints(filename.c_str()).toPoints();
 }
 
 void printPoints(const vector<Point2D> &points, const char *filename, int prec, int width) {
-	ofstream outfile;
-	outfile.open(filename);
-
-	if (!outfile.is_open())
-	{
-		cout << "Error: print - Error opening file" << endl;
-		exit(1);
-	}
-
-	outfile.precision(prec);
-	outfile.setf(std::ios::showpoint);
-	outfile.setf(std::ios::fixed, std::ios::floatfield);
+	BufferedWriter out(filename);
 
-	for (Point2D p : points) {
-		outfile << p.id << "\t";
-		outfile << setw(width) << p.x << "\t" << p.y << endl;
+	for (const Point2D &p : points) {
+		out.write(p.id);
+		out.put('\t');
+		out.writeFixed(p.x, prec, width);
+		out.put('\t');
+		out.writeFixed(p.y, prec);
+		out.newline();
 	}
 }
 
 void printPoints(const vector<Point3D> &points, const char *filename, int prec, int width) {
-	ofstream outfile;
-	outfile.open(filename);
-
-	if (!outfile.is_open())
-	{
-		cout << "Error: print - Error opening file" << endl;
-		exit(1);
-	}
-
-	outfile.precision(prec);
-	outfile.setf(std::ios::showpoint);
-	outfile.setf(std::ios::fixed, std::ios::floatfield);
-
-	for (Point3D p : points) {
-		outfile << p.id << "\t";
-		outfile << setw(width) << p.x << "\t" << p.y << "\t" << p.z << endl;
+	BufferedWriter out(filename);
+
+	for (const Point3D &p : points) {
+		out.write(p.id);
+		out.put('\t');
+		out.writeFixed(p.x, prec, width);
+		out.put('\t');
+		out.writeFixed(p.y, prec);
+		out.put('\t');
+		out.writeFixed(p.z, prec);
+		out.newline();
 	}
 }
\ No newline at end of file
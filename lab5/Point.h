@@ -62,16 +62,10 @@ struct Point3D {
 	 * @param R - the rotation matrix in which to rotate the entire 3D point by
 	 */
 	void rotateBy(const RotationMatrix &R) {
-		Matrix vec(3, 1);
-		vec[0][0] = x;
-		vec[1][0] = y;
-		vec[2][0] = z;
-
-		vec = R * vec;
-
-		x = vec[0][0];
-		y = vec[1][0];
-		z = vec[2][0];
+		double _x = x, _y = y, _z = z;
+		x = R.at(0, 0) * _x + R.at(0, 1) * _y + R.at(0, 2) * _z;
+		y = R.at(1, 0) * _x + R.at(1, 1) * _y + R.at(1, 2) * _z;
+		z = R.at(2, 0) * _x + R.at(2, 1) * _y + R.at(2, 2) * _z;
 	}
 
 	/** transform
@@ -161,7 +155,8 @@ vector<Point2D> findPoints(const vector<Point2D> &points, string id);
 vector<Point3D> findPoints(const vector<Point3D> &points, string id);
 
 /** readGeodeticPoints
- * reads in a set of geodetic points from a text file
+ * reads in a set of geodetic points from a text file or a binary file written by writeBinary
+ * (which must hold Geodetic content)
  * 
  * DOEST NOT REQUIRE A HEADER CONTAINING THE NUMBER OF POINTS
  * 
@@ -170,7 +165,7 @@ vector<Point3D> findPoints(const vector<Point3D> &points, string id);
 vector<GeodeticPoint> readGeodeticPoints(string prompt);
 
 /** read2DPoints
- * reads in a set of 2D points from a text file
+ * reads in a set of 2D points from a text file or a binary file written by writeBinary
  * 
  * DOEST NOT REQUIRE A HEADER CONTAINING THE NUMBER OF POINTS
  * 
@@ -179,7 +174,8 @@ vector<GeodeticPoint> readGeodeticPoints(string prompt);
 vector<Point2D> read2DPoints(string prompt);
 
 /** read3DPoints
-* reads in a set of 3D points from a text file
+* reads in a set of 3D points from a text file or a binary file written by writeBinary
+* (which must hold Points3D content)
 *
 * DOEST NOT REQUIRE A HEADER CONTAINING THE NUMBER OF POINTS
 *
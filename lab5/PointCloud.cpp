@@ -0,0 +1,250 @@
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+#include "PointCloud.h"
+#include "Parallel.h"
+
+const uint32_t IdTable::npos;
+
+uint32_t IdTable::intern(const string &name) {
+	std::unordered_map<string, uint32_t>::const_iterator it = lookup.find(name);
+	if (it != lookup.end())
+		return it->second;
+
+	uint32_t id = names.size();
+	names.push_back(name);
+	lookup.insert(std::make_pair(name, id));
+	return id;
+}
+
+uint32_t IdTable::find(const string &name) const {
+	std::unordered_map<string, uint32_t>::const_iterator it = lookup.find(name);
+	return (it != lookup.end()) ? it->second : npos;
+}
+
+const string &IdTable::name(uint32_t id) const {
+	if (id >= names.size()) {
+		cout << "Error: IdTable::name Unknown id " << id << endl;
+		exit(1);
+	}
+	return names[id];
+}
+
+unsigned int IdTable::size() const {
+	return names.size();
+}
+
+PointCloud2D::PointCloud2D(std::shared_ptr<IdTable> table) : table(table ? table : std::make_shared<IdTable>()) {}
+
+PointCloud2D::PointCloud2D(const vector<Point2D> &points, std::shared_ptr<IdTable> table) :
+	table(table ? table : std::make_shared<IdTable>()) {
+
+	reserve(points.size());
+	for (unsigned int i = 0; i < points.size(); i++)
+		push_back(points[i]);
+}
+
+void PointCloud2D::reserve(unsigned int n) {
+	id.reserve(n);
+	x.reserve(n);
+	y.reserve(n);
+}
+
+void PointCloud2D::push_back(const string &name, double _x, double _y) {
+	push_back(table->intern(name), _x, _y);
+}
+
+void PointCloud2D::push_back(uint32_t _id, double _x, double _y) {
+	id.push_back(_id);
+	x.push_back(_x);
+	y.push_back(_y);
+}
+
+void PointCloud2D::push_back(const Point2D &p) {
+	push_back(p.id, p.x, p.y);
+}
+
+unsigned int PointCloud2D::size() const {
+	return x.size();
+}
+
+const string &PointCloud2D::name(unsigned int i) const {
+	return table->name(id[i]);
+}
+
+Point2D PointCloud2D::operator[](unsigned int i) const {
+	return Point2D(name(i), x[i], y[i]);
+}
+
+vector<Point2D> PointCloud2D::toPoints() const {
+	vector<Point2D> points;
+	points.reserve(size());
+	for (unsigned int i = 0; i < size(); i++)
+		points.push_back(Point2D(name(i), x[i], y[i]));
+	return points;
+}
+
+PointCloud3D::PointCloud3D(std::shared_ptr<IdTable> table) : table(table ? table : std::make_shared<IdTable>()) {}
+
+PointCloud3D::PointCloud3D(const vector<Point3D> &points, std::shared_ptr<IdTable> table) :
+	table(table ? table : std::make_shared<IdTable>()) {
+
+	reserve(points.size());
+	for (unsigned int i = 0; i < points.size(); i++)
+		push_back(points[i]);
+}
+
+void PointCloud3D::reserve(unsigned int n) {
+	id.reserve(n);
+	x.reserve(n);
+	y.reserve(n);
+	z.reserve(n);
+}
+
+void PointCloud3D::push_back(const string &name, double _x, double _y, double _z) {
+	push_back(table->intern(name), _x, _y, _z);
+}
+
+void PointCloud3D::push_back(uint32_t _id, double _x, double _y, double _z) {
+	id.push_back(_id);
+	x.push_back(_x);
+	y.push_back(_y);
+	z.push_back(_z);
+}
+
+void PointCloud3D::push_back(const Point3D &p) {
+	push_back(p.id, p.x, p.y, p.z);
+}
+
+unsigned int PointCloud3D::size() const {
+	return x.size();
+}
+
+const string &PointCloud3D::name(unsigned int i) const {
+	return table->name(id[i]);
+}
+
+Point3D PointCloud3D::operator[](unsigned int i) const {
+	return Point3D(name(i), x[i], y[i], z[i]);
+}
+
+vector<Point3D> PointCloud3D::toPoints() const {
+	vector<Point3D> points;
+	points.reserve(size());
+	for (unsigned int i = 0; i < size(); i++)
+		points.push_back(Point3D(name(i), x[i], y[i], z[i]));
+	return points;
+}
+
+PointCloud3D increaseDimension(const PointCloud2D &points2D, double value) {
+	PointCloud3D points3D(points2D.table);
+	points3D.id = points2D.id;
+	points3D.x = points2D.x;
+	points3D.y = points2D.y;
+	points3D.z.assign(points2D.size(), value);
+	return points3D;
+}
+
+PointCloud2D decreaseDimension(const PointCloud3D &points3D) {
+	PointCloud2D points2D(points3D.table);
+	points2D.id = points3D.id;
+	points2D.x = points3D.x;
+	points2D.y = points3D.y;
+	return points2D;
+}
+
+// the points [begin, end) of the kernel; r is the scaled rotation lambda * R
+static void transformRange(const double *X, const double *Y, const double *Z, unsigned int begin, unsigned int end,
+	const double *r, const Point3D &T, double *x, double *y, double *z) {
+
+	unsigned int i = begin;
+
+#ifdef __AVX2__
+	const __m256d r0 = _mm256_set1_pd(r[0]), r1 = _mm256_set1_pd(r[1]), r2 = _mm256_set1_pd(r[2]);
+	const __m256d r3 = _mm256_set1_pd(r[3]), r4 = _mm256_set1_pd(r[4]), r5 = _mm256_set1_pd(r[5]);
+	const __m256d r6 = _mm256_set1_pd(r[6]), r7 = _mm256_set1_pd(r[7]), r8 = _mm256_set1_pd(r[8]);
+	const __m256d Tx = _mm256_set1_pd(T.x), Ty = _mm256_set1_pd(T.y), Tz = _mm256_set1_pd(T.z);
+
+	for (; i + 4 <= end; i += 4) {
+		__m256d pX = _mm256_loadu_pd(X + i);
+		__m256d pY = _mm256_loadu_pd(Y + i);
+		__m256d pZ = _mm256_loadu_pd(Z + i);
+
+		__m256d px = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(r0, pX), _mm256_mul_pd(r1, pY)), _mm256_mul_pd(r2, pZ));
+		__m256d py = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(r3, pX), _mm256_mul_pd(r4, pY)), _mm256_mul_pd(r5, pZ));
+		__m256d pz = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(r6, pX), _mm256_mul_pd(r7, pY)), _mm256_mul_pd(r8, pZ));
+
+		_mm256_storeu_pd(x + i, _mm256_add_pd(px, Tx));
+		_mm256_storeu_pd(y + i, _mm256_add_pd(py, Ty));
+		_mm256_storeu_pd(z + i, _mm256_add_pd(pz, Tz));
+	}
+#endif
+
+	for (; i < end; i++) {
+		double pX = X[i], pY = Y[i], pZ = Z[i];
+		x[i] = r[0] * pX + r[1] * pY + r[2] * pZ + T.x;
+		y[i] = r[3] * pX + r[4] * pY + r[5] * pZ + T.y;
+		z[i] = r[6] * pX + r[7] * pY + r[8] * pZ + T.z;
+	}
+}
+
+void transformPoints(const double *X, const double *Y, const double *Z, unsigned int n, double lambda,
+	const RotationMatrix &R, const Point3D &T, double *x, double *y, double *z, unsigned int num_threads) {
+
+	// scaled rotation applied element-wise over the coordinate arrays
+	double r[9];
+	for (unsigned int i = 0; i < 3; i++)
+		for (unsigned int j = 0; j < 3; j++)
+			r[3 * i + j] = lambda * R.at(i, j);
+
+	parallelFor(n, [&](unsigned int begin, unsigned int end) {
+		transformRange(X, Y, Z, begin, end, r, T, x, y, z);
+	}, num_threads, 65536);
+}
+
+PointCloud3D transformPoints(const PointCloud3D &points, double lambda, const RotationMatrix &R, const Point3D &T,
+	unsigned int num_threads) {
+
+	unsigned int n = points.size();
+
+	PointCloud3D transformed(points.table);
+	transformed.id = points.id;
+	transformed.x.resize(n);
+	transformed.y.resize(n);
+	transformed.z.resize(n);
+
+	transformPoints(points.x.data(), points.y.data(), points.z.data(), n, lambda, R, T,
+		transformed.x.data(), transformed.y.data(), transformed.z.data(), num_threads);
+
+	return transformed;
+}
+
+void transformPointsInPlace(PointCloud3D &points, double lambda, const RotationMatrix &R, const Point3D &T,
+	unsigned int num_threads) {
+
+	transformPoints(points.x.data(), points.y.data(), points.z.data(), points.size(), lambda, R, T,
+		points.x.data(), points.y.data(), points.z.data(), num_threads);
+}
+
+Matrix convertToVector(const PointCloud2D &points) {
+	Matrix vect(points.size() * 2, 1);
+
+	for (unsigned int i = 0; i < points.size(); i++) {
+		vect.at(2 * i, 0) = points.x[i];
+		vect.at(2 * i + 1, 0) = points.y[i];
+	}
+
+	return vect;
+}
+
+Matrix convertToVector(const PointCloud3D &points) {
+	Matrix vect(points.size() * 3, 1);
+
+	for (unsigned int i = 0; i < points.size(); i++) {
+		vect.at(3 * i, 0) = points.x[i];
+		vect.at(3 * i + 1, 0) = points.y[i];
+		vect.at(3 * i + 2, 0) = points.z[i];
+	}
+
+	return vect;
+}
@@ -0,0 +1,138 @@
+/*
+ * The purpose of this header is to provide point containers for large point sets. The
+ * coordinates are stored in separate contiguous arrays (structure of arrays) and the
+ * point ids are interned into 32-bit integers by an IdTable, which may be shared by
+ * several clouds so that their ids can be compared directly.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+
+#include "Point.h"
+
+class IdTable {
+public:
+	static const uint32_t npos = 0xFFFFFFFF;
+
+	/** intern
+	 * returns the integer id of a point id, adding it to the table if it is new
+	 */
+	uint32_t intern(const string &name);
+
+	/** find
+	 * returns the integer id of a point id, or npos if it is not in the table
+	 */
+	uint32_t find(const string &name) const;
+
+	const string &name(uint32_t id) const;
+	unsigned int size() const;
+private:
+	vector<string> names;
+	std::unordered_map<string, uint32_t> lookup;
+};
+
+struct PointCloud2D {
+	vector<uint32_t> id; // interned ids
+	vector<double> x, y;
+	std::shared_ptr<IdTable> table;
+
+	/** PointCloud2D
+	 * the constructor of this struct
+	 *
+	 * @param table	 - the id table to intern the ids into (a new one if not given)
+	 * @param points - points to copy into the cloud
+	 */
+	PointCloud2D(std::shared_ptr<IdTable> table = std::shared_ptr<IdTable>());
+	PointCloud2D(const vector<Point2D> &points, std::shared_ptr<IdTable> table = std::shared_ptr<IdTable>());
+
+	void reserve(unsigned int n);
+	void push_back(const string &name, double _x, double _y);
+	void push_back(uint32_t _id, double _x, double _y); // id already interned in the table
+	void push_back(const Point2D &p);
+
+	unsigned int size() const;
+	const string &name(unsigned int i) const;
+
+	Point2D operator[](unsigned int i) const;
+	vector<Point2D> toPoints() const;
+};
+
+struct PointCloud3D {
+	vector<uint32_t> id; // interned ids
+	vector<double> x, y, z;
+	std::shared_ptr<IdTable> table;
+
+	/** PointCloud3D
+	 * the constructor of this struct
+	 *
+	 * @param table	 - the id table to intern the ids into (a new one if not given)
+	 * @param points - points to copy into the cloud
+	 */
+	PointCloud3D(std::shared_ptr<IdTable> table = std::shared_ptr<IdTable>());
+	PointCloud3D(const vector<Point3D> &points, std::shared_ptr<IdTable> table = std::shared_ptr<IdTable>());
+
+	void reserve(unsigned int n);
+	void push_back(const string &name, double _x, double _y, double _z);
+	void push_back(uint32_t _id, double _x, double _y, double _z); // id already interned in the table
+	void push_back(const Point3D &p);
+
+	unsigned int size() const;
+	const string &name(unsigned int i) const;
+
+	Point3D operator[](unsigned int i) const;
+	vector<Point3D> toPoints() const;
+};
+
+/** increaseDimension
+ * increases a cloud of 2D points into the plane z=value; the ids are shared
+ */
+PointCloud3D increaseDimension(const PointCloud2D &points2D, double value = 0);
+
+/** decreaseDimension
+ * projects a cloud of 3D points down into the plane z=0; the ids are shared
+ */
+PointCloud2D decreaseDimension(const PointCloud3D &points3D);
+
+/** transformPoints
+ * does a complete 3D transformation of a cloud of 3D points
+ *
+ * @param points - the desired 3D points to be transformed
+ * @param lambda - the scale of the transformation
+ * @param R		 - the 3D rotation matrix of the transformation
+ * @param T		 - the 3D translation vector of the transformaiton
+ *
+ * @return		 - the fully transformed cloud, sharing the ids of the input
+ */
+PointCloud3D transformPoints(const PointCloud3D &points, double lambda, const RotationMatrix &R, const Point3D &T,
+	unsigned int num_threads = 0);
+
+/** transformPointsInPlace
+ * does a complete 3D transformation of a cloud of 3D points, overwriting its coordinates
+ */
+void transformPointsInPlace(PointCloud3D &points, double lambda, const RotationMatrix &R, const Point3D &T,
+	unsigned int num_threads = 0);
+
+/** transformPoints
+ * the batch kernel behind the cloud transformations: x = lambda * R * X + T over
+ * coordinate arrays, vectorized across points where AVX2 is available and threaded
+ * across chunks. The output arrays may be the input arrays (in place)
+ *
+ * @param X, Y, Z	  - the n input coordinates
+ * @param n			  - the number of points
+ * @param lambda	  - the scale of the transformation
+ * @param R			  - the 3D rotation matrix of the transformation
+ * @param T			  - the 3D translation vector of the transformation
+ * @param x, y, z	  - the n output coordinates
+ * @param num_threads - the maximum number of threads (0: one per hardware thread)
+ */
+void transformPoints(const double *X, const double *Y, const double *Z, unsigned int n, double lambda,
+	const RotationMatrix &R, const Point3D &T, double *x, double *y, double *z, unsigned int num_threads = 0);
+
+/** convertToVector
+ * converts a cloud to a vector of alternating [x,y,{z}] pairs
+ */
+Matrix convertToVector(const PointCloud2D &points);
+Matrix convertToVector(const PointCloud3D &points);
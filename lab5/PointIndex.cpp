@@ -0,0 +1,137 @@
+#include "PointIndex.h"
+
+const unsigned int PointIndex::npos;
+const uint32_t PointIndex::empty;
+
+PointIndex::PointIndex() : mask(0), shift(32), num_keys(0) {}
+
+PointIndex::PointIndex(const vector<uint32_t> &ids) {
+	build(ids);
+}
+
+PointIndex::PointIndex(const PointCloud2D &points) {
+	build(points.id);
+}
+
+PointIndex::PointIndex(const PointCloud3D &points) {
+	build(points.id);
+}
+
+unsigned int PointIndex::slot(uint32_t id) const {
+	// Fibonacci hashing: the high bits of the product depend on all bits of the id, so
+	// sequential ids spread over the table; then linear probing
+	unsigned int s = (uint32_t)(id * 2654435769u) >> shift;
+	while (slots[s].key != empty && slots[s].key != id)
+		s = (s + 1) & mask;
+	return s;
+}
+
+void PointIndex::build(const vector<uint32_t> &ids) {
+	unsigned int capacity = 16;
+	shift = 28;
+	while (capacity < 2 * ids.size()) {
+		capacity *= 2;
+		shift--;
+	}
+
+	mask = capacity - 1;
+	num_keys = 0;
+	Slot free_slot = { empty, npos };
+	slots.assign(capacity, free_slot);
+	next_index.assign(ids.size(), npos);
+
+	// insert in reverse so that every chain runs in the order of the points
+	for (unsigned int i = ids.size(); i-- > 0;) {
+		if (ids[i] == empty)
+			continue; // not a valid interned id (e.g. IdTable::npos), never found
+
+		unsigned int s = slot(ids[i]);
+		if (slots[s].key == empty) {
+			slots[s].key = ids[i];
+			num_keys++;
+		}
+		next_index[i] = slots[s].first;
+		slots[s].first = i;
+	}
+}
+
+unsigned int PointIndex::find(uint32_t id) const {
+	if (slots.empty() || id == empty)
+		return npos;
+	return slots[slot(id)].first;
+}
+
+unsigned int PointIndex::next(unsigned int index) const {
+	return next_index[index];
+}
+
+unsigned int PointIndex::count(uint32_t id) const {
+	unsigned int n = 0;
+	for (unsigned int i = find(id); i != npos; i = next(i))
+		n++;
+	return n;
+}
+
+unsigned int PointIndex::size() const {
+	return num_keys;
+}
+
+unsigned int findPoint(const PointCloud2D &points, const PointIndex &index, const string &id) {
+	return index.find(points.table->find(id));
+}
+
+unsigned int findPoint(const PointCloud3D &points, const PointIndex &index, const string &id) {
+	return index.find(points.table->find(id));
+}
+
+vector<unsigned int> findPoints(const PointCloud2D &points, const PointIndex &index, const string &id) {
+	vector<unsigned int> found;
+	for (unsigned int i = index.find(points.table->find(id)); i != PointIndex::npos; i = index.next(i))
+		found.push_back(i);
+	return found;
+}
+
+vector<unsigned int> findPoints(const PointCloud3D &points, const PointIndex &index, const string &id) {
+	vector<unsigned int> found;
+	for (unsigned int i = index.find(points.table->find(id)); i != PointIndex::npos; i = index.next(i))
+		found.push_back(i);
+	return found;
+}
+
+vector<ImageObservation> joinObservations(const PointCloud2D &image, const vector<unsigned int> &photo,
+	const PointCloud3D &object, const PointIndex &index, vector<unsigned int> *unmatched) {
+
+	if (photo.size() != image.size()) {
+		cout << "Error: joinObservations - Number of photo indices does not match the measurements" << endl;
+		exit(1);
+	}
+
+	// ids of the image table in terms of the object table, translated once per distinct id
+	bool shared = (image.table == object.table);
+	vector<uint32_t> translated;
+	if (!shared) {
+		translated.resize(image.table->size());
+		for (unsigned int k = 0; k < translated.size(); k++)
+			translated[k] = object.table->find(image.table->name(k));
+	}
+
+	vector<ImageObservation> observations;
+	observations.reserve(image.size());
+	if (unmatched != NULL)
+		unmatched->clear();
+
+	for (unsigned int i = 0; i < image.size(); i++) {
+		uint32_t id = shared ? image.id[i] : translated[image.id[i]];
+		unsigned int point = index.find(id);
+
+		if (point == PointIndex::npos) {
+			if (unmatched != NULL)
+				unmatched->push_back(i);
+			continue;
+		}
+
+		observations.push_back(ImageObservation(photo[i], point, image.x[i], image.y[i]));
+	}
+
+	return observations;
+}
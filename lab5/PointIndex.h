@@ -0,0 +1,93 @@
+/*
+ * The purpose of this header is to provide constant time lookups of points by id in place
+ * of the linear findPoint/findPoints scans. The index is an open-addressing hash table keyed
+ * by the interned ids of a point cloud, built once per point set; points sharing an id are
+ * chained so that all occurrences can be visited.
+ */
+
+#pragma once
+
+#include "Camera.h"
+#include "PointCloud.h"
+
+class PointIndex {
+public:
+	static const unsigned int npos = 0xFFFFFFFF;
+
+	/** PointIndex
+	 * the constructor of this class; builds the index of a set of interned ids
+	 *
+	 * @param ids	 - the interned ids, e.g. PointCloud3D::id
+	 * @param points - the point cloud to index
+	 */
+	PointIndex();
+	PointIndex(const vector<uint32_t> &ids);
+	PointIndex(const PointCloud2D &points);
+	PointIndex(const PointCloud3D &points);
+
+	void build(const vector<uint32_t> &ids);
+
+	/** find
+	 * returns the index of the first point with the given id, or npos
+	 */
+	unsigned int find(uint32_t id) const;
+
+	/** next
+	 * returns the index of the next point with the same id as the point at index, or npos
+	 *
+	 * for (unsigned int i = index.find(id); i != PointIndex::npos; i = index.next(i))
+	 */
+	unsigned int next(unsigned int index) const;
+
+	unsigned int count(uint32_t id) const; // number of points with the given id
+	unsigned int size() const;			   // number of distinct ids
+private:
+	static const uint32_t empty = 0xFFFFFFFF;
+
+	unsigned int mask;
+	unsigned int shift; // 32 - log2 of the capacity
+	unsigned int num_keys;
+
+	// key and first point side by side, so that a probe touches a single cache line
+	struct Slot {
+		uint32_t key;		// the interned id, empty for a free slot
+		unsigned int first; // the first point with the id
+	};
+
+	vector<Slot> slots;
+	vector<unsigned int> next_index; // the next point with the same id, for every point
+
+	unsigned int slot(uint32_t id) const;
+};
+
+/** findPoint
+ * finds the FIRST OCCURANCE of a point with a given id through the index of the cloud
+ *
+ * @return - the index of the point in the cloud, or PointIndex::npos if not found
+ */
+unsigned int findPoint(const PointCloud2D &points, const PointIndex &index, const string &id);
+unsigned int findPoint(const PointCloud3D &points, const PointIndex &index, const string &id);
+
+/** findPoints
+ * finds ALL OCCURANCES of a point with a given id through the index of the cloud
+ *
+ * @return - the indices of the points in the cloud
+ */
+vector<unsigned int> findPoints(const PointCloud2D &points, const PointIndex &index, const string &id);
+vector<unsigned int> findPoints(const PointCloud3D &points, const PointIndex &index, const string &id);
+
+/** joinObservations
+ * pairs the image measurements of any number of photos with their object points in one
+ * pass; the result feeds BundleAdjustment and SpaceIntersection directly. The clouds
+ * should share their IdTable, otherwise the ids are translated by name
+ *
+ * @param image		- the image measurements of all photos
+ * @param photo		- the photo index of every measurement
+ * @param object	- the object points
+ * @param index		- the index of the object points
+ * @param unmatched - receives the measurements without an object point (optional)
+ *
+ * @return			- one observation per matched measurement, in the order of the image cloud
+ */
+vector<ImageObservation> joinObservations(const PointCloud2D &image, const vector<unsigned int> &photo,
+	const PointCloud3D &object, const PointIndex &index, vector<unsigned int> *unmatched = NULL);
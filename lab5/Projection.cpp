@@ -0,0 +1,156 @@
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+#include <atomic>
+#include "Projection.h"
+#include "Parallel.h"
+
+Projection::Projection(const Camera &camera) : camera(camera) {}
+
+void Projection::setOptions(const ProjectionOptions &options) {
+	this->options = options;
+}
+
+unsigned int Projection::project(const double *X, const double *Y, const double *Z, unsigned int n,
+	double *x, double *y, unsigned char *visible, double *depth) const {
+
+	std::atomic<unsigned int> count(0);
+
+	parallelFor(n, [&](unsigned int begin, unsigned int end) {
+		count += projectRange(X, Y, Z, begin, end, x, y, visible, depth);
+	}, options.num_threads, 16384);
+
+	return count;
+}
+
+unsigned int Projection::project(const vector<double> &X, const vector<double> &Y, const vector<double> &Z,
+	vector<double> &x, vector<double> &y, vector<unsigned char> &visible) const {
+
+	if (Y.size() != X.size() || Z.size() != X.size()) {
+		cout << "Error: Projection::project Coordinate arrays differ in size" << endl;
+		exit(1);
+	}
+
+	x.resize(X.size());
+	y.resize(X.size());
+	visible.resize(X.size());
+
+	return project(X.data(), Y.data(), Z.data(), X.size(), x.data(), y.data(), visible.data());
+}
+
+vector<Point2D> Projection::project(const vector<Point3D> &points, bool omit_culled) const {
+	unsigned int n = points.size();
+
+	vector<double> X(n), Y(n), Z(n), x, y;
+	vector<unsigned char> visible;
+	for (unsigned int i = 0; i < n; i++) {
+		X[i] = points[i].x;
+		Y[i] = points[i].y;
+		Z[i] = points[i].z;
+	}
+
+	project(X, Y, Z, x, y, visible);
+
+	vector<Point2D> image;
+	image.reserve(n);
+	for (unsigned int i = 0; i < n; i++)
+		if (!omit_culled || visible[i])
+			image.push_back(Point2D(points[i].id, x[i], y[i]));
+
+	return image;
+}
+
+unsigned int Projection::projectRange(const double *X, const double *Y, const double *Z, unsigned int begin, unsigned int end,
+	double *x, double *y, unsigned char *visible, double *depth) const {
+
+	const double *m = camera.m;
+	const double *T = camera.T;
+	const double c = camera.c;
+	const ImageFormat &f = options.format;
+	const bool cull_behind = options.cull_behind;
+	const bool cull_format = options.cull_format;
+
+	unsigned int count = 0;
+	unsigned int i = begin;
+
+#ifdef __AVX2__
+	const __m256d m0 = _mm256_set1_pd(m[0]), m1 = _mm256_set1_pd(m[1]), m2 = _mm256_set1_pd(m[2]);
+	const __m256d m3 = _mm256_set1_pd(m[3]), m4 = _mm256_set1_pd(m[4]), m5 = _mm256_set1_pd(m[5]);
+	const __m256d m6 = _mm256_set1_pd(m[6]), m7 = _mm256_set1_pd(m[7]), m8 = _mm256_set1_pd(m[8]);
+	const __m256d Tx = _mm256_set1_pd(T[0]), Ty = _mm256_set1_pd(T[1]), Tz = _mm256_set1_pd(T[2]);
+	const __m256d neg_c = _mm256_set1_pd(-c);
+	const __m256d zero = _mm256_setzero_pd();
+	const __m256d xmin = _mm256_set1_pd(f.x_min), xmax = _mm256_set1_pd(f.x_max);
+	const __m256d ymin = _mm256_set1_pd(f.y_min), ymax = _mm256_set1_pd(f.y_max);
+
+	for (; i + 4 <= end; i += 4) {
+		__m256d dX = _mm256_sub_pd(_mm256_loadu_pd(X + i), Tx);
+		__m256d dY = _mm256_sub_pd(_mm256_loadu_pd(Y + i), Ty);
+		__m256d dZ = _mm256_sub_pd(_mm256_loadu_pd(Z + i), Tz);
+
+		__m256d U = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(m0, dX), _mm256_mul_pd(m1, dY)), _mm256_mul_pd(m2, dZ));
+		__m256d V = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(m3, dX), _mm256_mul_pd(m4, dY)), _mm256_mul_pd(m5, dZ));
+		__m256d W = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(m6, dX), _mm256_mul_pd(m7, dY)), _mm256_mul_pd(m8, dZ));
+
+		// points in the plane of the perspective centre (W = 0) cannot be projected, they get
+		// zero coordinates and are never visible
+		__m256d front = _mm256_cmp_pd(W, zero, _CMP_LT_OQ);
+		__m256d projectable = _mm256_cmp_pd(W, zero, _CMP_NEQ_OQ);
+		__m256d s = _mm256_and_pd(_mm256_div_pd(neg_c, W), projectable);
+		__m256d px = _mm256_mul_pd(s, U);
+		__m256d py = _mm256_mul_pd(s, V);
+
+		_mm256_storeu_pd(x + i, px);
+		_mm256_storeu_pd(y + i, py);
+		if (depth != NULL)
+			_mm256_storeu_pd(depth + i, _mm256_sub_pd(zero, W));
+
+		__m256d keep = cull_behind ? front : projectable;
+		if (cull_format) {
+			__m256d inside = _mm256_and_pd(
+				_mm256_and_pd(_mm256_cmp_pd(px, xmin, _CMP_GE_OQ), _mm256_cmp_pd(px, xmax, _CMP_LE_OQ)),
+				_mm256_and_pd(_mm256_cmp_pd(py, ymin, _CMP_GE_OQ), _mm256_cmp_pd(py, ymax, _CMP_LE_OQ)));
+			keep = _mm256_and_pd(keep, inside);
+		}
+
+		int mask = _mm256_movemask_pd(keep);
+		for (int k = 0; k < 4; k++) {
+			unsigned char bit = (mask >> k) & 1;
+			if (visible != NULL)
+				visible[i + k] = bit;
+			count += bit;
+		}
+	}
+#endif
+
+	for (; i < end; i++) {
+		double dX = X[i] - T[0];
+		double dY = Y[i] - T[1];
+		double dZ = Z[i] - T[2];
+
+		double U = m[0] * dX + m[1] * dY + m[2] * dZ;
+		double V = m[3] * dX + m[4] * dY + m[5] * dZ;
+		double W = m[6] * dX + m[7] * dY + m[8] * dZ;
+
+		bool front = W < 0.0;
+		bool projectable = W != 0.0;
+		double s = projectable ? -c / W : 0.0;
+		double px = s * U;
+		double py = s * V;
+
+		x[i] = px;
+		y[i] = py;
+		if (depth != NULL)
+			depth[i] = -W;
+
+		bool keep = cull_behind ? front : projectable;
+		if (cull_format)
+			keep = keep && px >= f.x_min && px <= f.x_max && py >= f.y_min && py <= f.y_max;
+
+		if (visible != NULL)
+			visible[i] = keep ? 1 : 0;
+		count += keep ? 1 : 0;
+	}
+
+	return count;
+}
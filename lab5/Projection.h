@@ -0,0 +1,79 @@
+/*
+ * The purpose of this header is to provide a standalone projection of object points into
+ * an oriented photo with the collinearity equations
+ *
+ * x = -c * U / W,  y = -c * V / W,  {U, V, W} = M * ({X, Y, Z} - T)
+ *
+ * for large batches of points stored as separate coordinate arrays. The points are split
+ * into chunks over all hardware threads, and each chunk is projected four points at a time
+ * with AVX2 when the compiler targets it (a scalar kernel is used otherwise).
+ */
+
+#pragma once
+
+#include "Camera.h"
+#include "Point.h"
+
+struct ImageFormat {
+	double x_min, x_max; // extent of the format in image coordinates
+	double y_min, y_max;
+
+	ImageFormat() : x_min(-1.0E300), x_max(1.0E300), y_min(-1.0E300), y_max(1.0E300) {}
+	ImageFormat(double width, double height) :
+		x_min(-width / 2), x_max(width / 2), y_min(-height / 2), y_max(height / 2) {}
+	ImageFormat(double _x_min, double _x_max, double _y_min, double _y_max) :
+		x_min(_x_min), x_max(_x_max), y_min(_y_min), y_max(_y_max) {}
+};
+
+struct ProjectionOptions {
+	bool cull_behind;		  // flag points behind the perspective centre (W >= 0) as not visible
+	bool cull_format;		  // flag points projecting outside the format as not visible
+	ImageFormat format;
+	unsigned int num_threads; // 0: one thread per hardware thread
+
+	ProjectionOptions() : cull_behind(true), cull_format(false), format(), num_threads(0) {}
+};
+
+class Projection {
+public:
+	/** Projection
+	 * the constructor of this class
+	 *
+	 * @param camera - the oriented photo to project into
+	 */
+	Projection(const Camera &camera);
+
+	void setOptions(const ProjectionOptions &options);
+
+	/** project
+	 * projects n object points into the image. Culled points still receive their image
+	 * coordinates but are flagged as not visible; points in the plane of the perspective
+	 * centre (W = 0) cannot be projected, so they get zero coordinates and are never visible
+	 *
+	 * @param X, Y, Z - the object coordinates, n each
+	 * @param n		  - the number of points
+	 * @param x, y	  - the output image coordinates, n each
+	 * @param visible - the output visibility flags (may be NULL)
+	 * @param depth	  - the output depth -W along the optical axis (may be NULL)
+	 *
+	 * @return		  - the number of visible points
+	 */
+	unsigned int project(const double *X, const double *Y, const double *Z, unsigned int n,
+		double *x, double *y, unsigned char *visible = NULL, double *depth = NULL) const;
+
+	unsigned int project(const vector<double> &X, const vector<double> &Y, const vector<double> &Z,
+		vector<double> &x, vector<double> &y, vector<unsigned char> &visible) const;
+
+	/** project
+	 * projects a set of object points; the ids are kept
+	 *
+	 * @return - the image points (not visible points are omitted if omit_culled is set)
+	 */
+	vector<Point2D> project(const vector<Point3D> &points, bool omit_culled = false) const;
+private:
+	Camera camera;
+	ProjectionOptions options;
+
+	unsigned int projectRange(const double *X, const double *Y, const double *Z, unsigned int begin, unsigned int end,
+		double *x, double *y, unsigned char *visible, double *depth) const;
+};
@@ -0,0 +1,176 @@
+#include "Quaternion.h"
+
+Quaternion Quaternion::fromRotationVector(double rx, double ry, double rz) {
+	double theta2 = rx * rx + ry * ry + rz * rz;
+	double theta = sqrt(theta2);
+
+	// sin(theta / 2) / theta, by its series for tiny angles
+	double w, k;
+	if (theta < 1e-8) {
+		w = 1.0 - theta2 / 8.0;
+		k = 0.5 - theta2 / 48.0;
+	}
+	else {
+		w = cos(0.5 * theta);
+		k = sin(0.5 * theta) / theta;
+	}
+
+	return Quaternion(w, k * rx, k * ry, k * rz);
+}
+
+Quaternion Quaternion::fromMatrix(const RotationMatrix &M) {
+	// the matrix is the transpose of the active rotation of the quaternion
+	double m00 = M.at(0, 0), m01 = M.at(0, 1), m02 = M.at(0, 2);
+	double m10 = M.at(1, 0), m11 = M.at(1, 1), m12 = M.at(1, 2);
+	double m20 = M.at(2, 0), m21 = M.at(2, 1), m22 = M.at(2, 2);
+
+	// Shepperd's method: divide by the largest of the four components
+	Quaternion q;
+	double trace = m00 + m11 + m22;
+	if (trace > 0) {
+		double s = 2.0 * sqrt(trace + 1.0);
+		q = Quaternion(0.25 * s, (m12 - m21) / s, (m20 - m02) / s, (m01 - m10) / s);
+	}
+	else if (m00 > m11 && m00 > m22) {
+		double s = 2.0 * sqrt(1.0 + m00 - m11 - m22);
+		q = Quaternion((m12 - m21) / s, 0.25 * s, (m01 + m10) / s, (m02 + m20) / s);
+	}
+	else if (m11 > m22) {
+		double s = 2.0 * sqrt(1.0 + m11 - m00 - m22);
+		q = Quaternion((m20 - m02) / s, (m01 + m10) / s, 0.25 * s, (m12 + m21) / s);
+	}
+	else {
+		double s = 2.0 * sqrt(1.0 + m22 - m00 - m11);
+		q = Quaternion((m01 - m10) / s, (m02 + m20) / s, (m12 + m21) / s, 0.25 * s);
+	}
+
+	if (q.w < 0)
+		q = Quaternion(-q.w, -q.x, -q.y, -q.z);
+	q.normalize();
+	return q;
+}
+
+void Quaternion::toMatrix(double *m) const {
+	double xx = x * x, yy = y * y, zz = z * z;
+	double xy = x * y, xz = x * z, yz = y * z;
+	double wx = w * x, wy = w * y, wz = w * z;
+
+	m[0] = 1.0 - 2.0 * (yy + zz);
+	m[1] = 2.0 * (xy + wz);
+	m[2] = 2.0 * (xz - wy);
+	m[3] = 2.0 * (xy - wz);
+	m[4] = 1.0 - 2.0 * (xx + zz);
+	m[5] = 2.0 * (yz + wx);
+	m[6] = 2.0 * (xz + wy);
+	m[7] = 2.0 * (yz - wx);
+	m[8] = 1.0 - 2.0 * (xx + yy);
+}
+
+RotationMatrix Quaternion::toRotationMatrix() const {
+	double m[9];
+	toMatrix(m);
+
+	RotationMatrix M;
+	for (unsigned int i = 0; i < 3; i++) {
+		vector<double> &row = M[i];
+		row[0] = m[3 * i];
+		row[1] = m[3 * i + 1];
+		row[2] = m[3 * i + 2];
+	}
+	return M;
+}
+
+void Quaternion::toRotationVector(double *r) const {
+	// q and -q are the same rotation; take the one with the smaller angle
+	double sign = (w < 0) ? -1.0 : 1.0;
+	double n = sqrt(x * x + y * y + z * z);
+	double theta = 2.0 * atan2(n, sign * w);
+
+	double f = (n < 1e-12) ? 2.0 / (sign * w) : theta / n;
+	r[0] = sign * f * x;
+	r[1] = sign * f * y;
+	r[2] = sign * f * z;
+}
+
+void Quaternion::normalize() {
+	double n = sqrt(w * w + x * x + y * y + z * z);
+	w /= n;
+	x /= n;
+	y /= n;
+	z /= n;
+}
+
+Quaternion Quaternion::operator*(const Quaternion &q) const {
+	return Quaternion(w * q.w - x * q.x - y * q.y - z * q.z,
+					  w * q.x + x * q.w + y * q.z - z * q.y,
+					  w * q.y - x * q.z + y * q.w + z * q.x,
+					  w * q.z + x * q.y - y * q.x + z * q.w);
+}
+
+unsigned int rotationParameters(RotationParameterization parameterization) {
+	return (parameterization == RotationParameterization::Quaternion) ? 4 : 3;
+}
+
+void getRotation(RotationParameterization parameterization, const Angles &ang, const Quaternion &q, Matrix &x,
+	unsigned int row) {
+
+	switch (parameterization) {
+	case RotationParameterization::Angles:
+		x[row][0] = ang.omega;
+		x[row + 1][0] = ang.phi;
+		x[row + 2][0] = ang.kappa;
+		break;
+	case RotationParameterization::Quaternion:
+		x[row][0] = q.w;
+		x[row + 1][0] = q.x;
+		x[row + 2][0] = q.y;
+		x[row + 3][0] = q.z;
+		break;
+	case RotationParameterization::Rodrigues: {
+		double r[3];
+		q.toRotationVector(r);
+		x[row][0] = r[0];
+		x[row + 1][0] = r[1];
+		x[row + 2][0] = r[2];
+		break;
+	}
+	}
+}
+
+void setRotation(RotationParameterization parameterization, const Matrix &x, unsigned int row, Angles &ang,
+	Quaternion &q, RotationMatrix &M) {
+
+	switch (parameterization) {
+	case RotationParameterization::Angles:
+		ang = Angles(x.at(row, 0), x.at(row + 1, 0), x.at(row + 2, 0));
+		M.rotate(ang);
+		return;
+	case RotationParameterization::Quaternion:
+		q = Quaternion(x.at(row, 0), x.at(row + 1, 0), x.at(row + 2, 0), x.at(row + 3, 0));
+		q.normalize();
+		break;
+	case RotationParameterization::Rodrigues:
+		q = Quaternion::fromRotationVector(x.at(row, 0), x.at(row + 1, 0), x.at(row + 2, 0));
+		break;
+	}
+
+	M = q.toRotationMatrix();
+}
+
+void updateRotation(RotationParameterization parameterization, const Matrix &del, unsigned int row, Angles &ang,
+	Quaternion &q, RotationMatrix &M) {
+
+	if (parameterization == RotationParameterization::Angles) {
+		ang.omega += del.at(row, 0);
+		ang.phi += del.at(row + 1, 0);
+		ang.kappa += del.at(row + 2, 0);
+		M.rotate(ang);
+		return;
+	}
+
+	// R(q * dq) = R(dq) * R(q)
+	q = q * Quaternion::fromRotationVector(del.at(row, 0), del.at(row + 1, 0), del.at(row + 2, 0));
+	q.normalize();
+
+	M = q.toRotationMatrix();
+}
@@ -0,0 +1,92 @@
+/*
+ * The purpose of this header is to provide rotation parameterizations without the
+ * singularity of the omega-phi-kappa angles at phi = +-90 degrees. The solvers keep the
+ * rotation as a unit quaternion (or a rotation vector) and update it with a small local
+ * rotation, so that every iteration linearizes about the current rotation:
+ *
+ * M_new = R(d) * M
+ *
+ * R(d) rotates by the small angles d = {dx, dy, dz} about the axes of the system M rotates
+ * into, with the same sense as R1, R2, R3 of the omega-phi-kappa angles, so the increments
+ * are the familiar small angle corrections and need no trigonometry in the design matrix.
+ */
+
+#pragma once
+
+#include "RotationMatrix.h"
+
+enum class RotationParameterization {
+	Angles,		// omega, phi, kappa with additive updates (the default)
+	Quaternion, // a unit quaternion with local updates; four stored parameters
+	Rodrigues	// a rotation vector (axis * angle) with local updates; three stored parameters
+};
+
+struct Quaternion {
+	double w, x, y, z;
+
+	Quaternion() : w(1), x(0), y(0), z(0) {}
+	Quaternion(double _w, double _x, double _y, double _z) : w(_w), x(_x), y(_y), z(_z) {}
+
+	/** fromRotationVector
+	 * the quaternion of the rotation matrix R(r) = exp(-[r]x) of a rotation vector
+	 *
+	 * @param rx, ry, rz - the rotation vector, the axis times the angle [rad]
+	 */
+	static Quaternion fromRotationVector(double rx, double ry, double rz);
+
+	/** fromMatrix
+	 * the quaternion of a rotation matrix (with w >= 0)
+	 */
+	static Quaternion fromMatrix(const RotationMatrix &M);
+
+	/** toMatrix
+	 * the rotation matrix of the quaternion, written row-major into m[9]
+	 */
+	void toMatrix(double *m) const;
+	RotationMatrix toRotationMatrix() const;
+
+	/** toRotationVector
+	 * the rotation vector of the quaternion, with an angle of at most pi
+	 */
+	void toRotationVector(double *r) const;
+
+	void normalize();
+
+	/** operator*
+	 * the quaternion product; R(p * q) = R(q) * R(p)
+	 */
+	Quaternion operator*(const Quaternion &q) const;
+};
+
+/** rotationParameters
+ * the number of stored rotation parameters of a parameterization (3 or 4); the number of
+ * rotation increments is always 3
+ */
+unsigned int rotationParameters(RotationParameterization parameterization);
+
+/** getRotation
+ * stores the rotation in x, starting at the given row
+ *
+ * @param parameterization - the parameterization used by the solver
+ * @param ang, q		   - the current angles and quaternion
+ * @param x				   - the parameter vector
+ * @param row			   - the first row of the rotation parameters
+ */
+void getRotation(RotationParameterization parameterization, const Angles &ang, const Quaternion &q, Matrix &x,
+	unsigned int row);
+
+/** setRotation
+ * restores a rotation stored by getRotation, and updates the quaternion and matrix; the
+ * angles only with the Angles parameterization
+ */
+void setRotation(RotationParameterization parameterization, const Matrix &x, unsigned int row, Angles &ang,
+	Quaternion &q, RotationMatrix &M);
+
+/** updateRotation
+ * applies the three rotation increments starting at the given row of del: additive to the
+ * angles, or as a local rotation M_new = R(d) * M. With the local parameterizations the
+ * angles are left alone, since recovering them from M costs trigonometry every iteration
+ * and is singular at phi = +-90 degrees; they are taken from M when they are needed
+ */
+void updateRotation(RotationParameterization parameterization, const Matrix &del, unsigned int row, Angles &ang,
+	Quaternion &q, RotationMatrix &M);
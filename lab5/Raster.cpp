@@ -0,0 +1,153 @@
+#include "Raster.h"
+
+Raster::Raster() : width(0), height(0) {}
+
+Raster::Raster(unsigned int width, unsigned int height, unsigned char fill) :
+	width(width), height(height), pixels((size_t)width * height, fill) {}
+
+Raster::Raster(const char *filename, unsigned int width, unsigned int height) :
+	width(width), height(height), pixels((size_t)width * height) {
+
+	ifstream file(filename, ios::in | ios::binary);
+	if (!file.is_open()) {
+		cout << "Error: Raster - Could not open " << filename << endl;
+		exit(1);
+	}
+
+	file.read((char *)pixels.data(), pixels.size());
+	if ((size_t)file.gcount() != pixels.size()) {
+		cout << "Error: Raster - " << filename << " is smaller than " << width << "x" << height << " pixels" << endl;
+		exit(1);
+	}
+}
+
+void Raster::write(const char *filename) const {
+	ofstream file(filename, ios::out | ios::binary | ios::trunc);
+	if (!file.is_open()) {
+		cout << "Error: Raster::write Could not open " << filename << endl;
+		exit(1);
+	}
+
+	file.write((const char *)pixels.data(), pixels.size());
+}
+
+bool Raster::sample(double col, double row, double &value) const {
+	// the raster covers its pixels up to their outer edges; the outermost half pixel is
+	// sampled from the border pixels
+	if (width < 2 || height < 2 || !(col >= -0.5 && row >= -0.5 && col <= width - 0.5 && row <= height - 0.5))
+		return false;
+
+	col = fmin(fmax(col, 0.0), width - 1.0);
+	row = fmin(fmax(row, 0.0), height - 1.0);
+
+	unsigned int c = (unsigned int)col;
+	unsigned int r = (unsigned int)row;
+	if (c + 1 >= width)
+		c = width - 2;
+	if (r + 1 >= height)
+		r = height - 2;
+
+	double dc = col - c;
+	double dr = row - r;
+
+	const unsigned char *p = &pixels[(size_t)r * width + c];
+	double top = p[0] + dc * (p[1] - p[0]);
+	double bottom = p[width] + dc * (p[width + 1] - p[width]);
+	value = top + dr * (bottom - top);
+
+	return true;
+}
+
+unsigned int Raster::getWidth() const {
+	return width;
+}
+
+unsigned int Raster::getHeight() const {
+	return height;
+}
+
+unsigned char &Raster::at(unsigned int row, unsigned int col) {
+	return pixels[(size_t)row * width + col];
+}
+
+unsigned char Raster::at(unsigned int row, unsigned int col) const {
+	return pixels[(size_t)row * width + col];
+}
+
+const unsigned char *Raster::data() const {
+	return pixels.data();
+}
+
+DEM::DEM(unsigned int cols, unsigned int rows, double x0, double y0, double cell, const vector<float> &heights) :
+	cols(cols), rows(rows), x0(x0), y0(y0), cell(cell), heights(heights) {
+
+	if (heights.size() != (size_t)cols * rows || cols < 2 || rows < 2) {
+		cout << "Error: DEM - Grid dimensions do not match the number of heights" << endl;
+		exit(1);
+	}
+}
+
+DEM::DEM(const char *filename, unsigned int cols, unsigned int rows, double x0, double y0, double cell) :
+	cols(cols), rows(rows), x0(x0), y0(y0), cell(cell), heights((size_t)cols * rows) {
+
+	ifstream file(filename, ios::in | ios::binary);
+	if (!file.is_open()) {
+		cout << "Error: DEM - Could not open " << filename << endl;
+		exit(1);
+	}
+
+	file.read((char *)heights.data(), heights.size() * sizeof(float));
+	if ((size_t)file.gcount() != heights.size() * sizeof(float) || cols < 2 || rows < 2) {
+		cout << "Error: DEM - " << filename << " does not hold " << cols << "x" << rows << " heights" << endl;
+		exit(1);
+	}
+}
+
+bool DEM::height(double X, double Y, double &Z) const {
+	double col = (X - x0) / cell;
+	double row = (y0 - Y) / cell;
+
+	if (!(col >= 0.0 && row >= 0.0 && col <= cols - 1.0 && row <= rows - 1.0))
+		return false;
+
+	unsigned int c = (unsigned int)col;
+	unsigned int r = (unsigned int)row;
+	if (c + 1 >= cols)
+		c = cols - 2;
+	if (r + 1 >= rows)
+		r = rows - 2;
+
+	double dc = col - c;
+	double dr = row - r;
+
+	const float *h = &heights[(size_t)r * cols + c];
+	double top = h[0] + dc * (h[1] - h[0]);
+	double bottom = h[cols] + dc * (h[cols + 1] - h[cols]);
+	Z = top + dr * (bottom - top);
+
+	return true;
+}
+
+unsigned int DEM::getCols() const {
+	return cols;
+}
+
+unsigned int DEM::getRows() const {
+	return rows;
+}
+
+double DEM::getCellSize() const {
+	return cell;
+}
+
+double DEM::cellX(unsigned int col) const {
+	return x0 + col * cell;
+}
+
+double DEM::cellY(unsigned int row) const {
+	return y0 - row * cell;
+}
+
+double DEM::at(unsigned int row, unsigned int col) const {
+	return heights[(size_t)row * cols + col];
+}
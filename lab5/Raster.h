@@ -0,0 +1,82 @@
+/*
+ * The purpose of this header is to provide the gridded data used by the orthophoto and
+ * visibility pipelines: a single band 8-bit image raster and a digital elevation model.
+ * Both are read from plain binary files (row-major, no header), so the dimensions and
+ * georeferencing are passed in by the caller.
+ */
+
+#pragma once
+
+#include "Matrix.h"
+
+class Raster {
+public:
+	/** Raster
+	 * a single band 8-bit raster, stored row-major with the first row at the top
+	 *
+	 * @param width, height - the dimensions in pixels
+	 * @param fill			- the initial value of all pixels
+	 * @param filename		- a plain binary file of width * height bytes
+	 */
+	Raster();
+	Raster(unsigned int width, unsigned int height, unsigned char fill = 0);
+	Raster(const char *filename, unsigned int width, unsigned int height);
+
+	/** write
+	 * writes the raster to a plain binary file of width * height bytes
+	 */
+	void write(const char *filename) const;
+
+	/** sample
+	 * bilinear interpolation at a pixel position (col, row), the centre of the upper
+	 * left pixel being (0, 0)
+	 *
+	 * @return - false if the position is outside of the raster (beyond the outer pixel edges)
+	 */
+	bool sample(double col, double row, double &value) const;
+
+	unsigned int getWidth() const;
+	unsigned int getHeight() const;
+
+	unsigned char &at(unsigned int row, unsigned int col);
+	unsigned char at(unsigned int row, unsigned int col) const;
+	const unsigned char *data() const;
+private:
+	unsigned int width, height;
+	vector<unsigned char> pixels;
+};
+
+class DEM {
+public:
+	/** DEM
+	 * a grid of heights, stored row-major with the first row at the north (top). Cell
+	 * (row, col) is centred at X = x0 + col * cell, Y = y0 - row * cell
+	 *
+	 * @param cols, rows - the dimensions of the grid
+	 * @param x0, y0	 - the object coordinates of the centre of the upper left cell
+	 * @param cell		 - the cell size in object units
+	 * @param heights	 - rows * cols heights
+	 * @param filename	 - a plain binary file of rows * cols 32-bit floats
+	 */
+	DEM(unsigned int cols, unsigned int rows, double x0, double y0, double cell, const vector<float> &heights);
+	DEM(const char *filename, unsigned int cols, unsigned int rows, double x0, double y0, double cell);
+
+	/** height
+	 * bilinear interpolation of the height at (X, Y)
+	 *
+	 * @return - false if (X, Y) is outside of the grid
+	 */
+	bool height(double X, double Y, double &Z) const;
+
+	unsigned int getCols() const;
+	unsigned int getRows() const;
+	double getCellSize() const;
+
+	double cellX(unsigned int col) const; // X of the centre of a column
+	double cellY(unsigned int row) const; // Y of the centre of a row
+	double at(unsigned int row, unsigned int col) const;
+private:
+	unsigned int cols, rows;
+	double x0, y0, cell;
+	vector<float> heights;
+};
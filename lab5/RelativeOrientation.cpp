@@ -1,123 +1,366 @@
+#include <mutex>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
 #include "RelativeOrientation.h"
+#include "Parallel.h"
 
-RelativeOrientation::RelativeOrientation(const vector<Point2D> &coords_left, const vector<Point2D> &coords_right, double c) {
+RelativeOrientation::RelativeOrientation(const vector<Point2D> &coords_left, const vector<Point2D> &coords_right, double c) :
+	RelativeOrientation(PointCloud2D(coords_left), PointCloud2D(coords_right), c) {}
+
+RelativeOrientation::RelativeOrientation(const PointCloud2D &coords_left, const PointCloud2D &coords_right, double c) {
 	this->num_points = coords_left.size();
 	this->coords_left = increaseDimension(coords_left, -c);
 	this->coords_right = increaseDimension(coords_right, -c);
 	this->c = c;
+	this->parameterization = RotationParameterization::Angles;
 }
 
 void RelativeOrientation::computeOrientation(const Point3D &_B, const Angles &_ang) {
 	B = _B;
-	Angles ang = _ang;
+	ang = _ang;
 	M.rotate(ang.omega, ang.phi, ang.kappa);
-
-	Matrix w, del;
+	q = Quaternion::fromMatrix(M);
 
 	double threshold = 1e-6;
-	do {
-		coplanarityA();
-		w = coplanarityCond();
-		del = delta(A, w);
-
-		B.y += del[0][0];
-		B.z += del[1][0];
-		ang.omega += del[2][0];
-		ang.phi += del[3][0];
-		ang.kappa += del[4][0];
+	Matrix tolerances(5, 1, threshold);
 
-		M.rotate(ang);
-	} while (del.maxAbsElem() > threshold);
+	report = levenbergMarquardt(*this, tolerances, options);
 
+	A = Matrix(); // formed by getA() on request
 	computeModelSpace();
 }
 
-void RelativeOrientation::coplanarityA() {
+void RelativeOrientation::setSolverOptions(const SolverOptions &options) {
+	this->options = options;
+}
 
-	A.resize(num_points, 5);
+void RelativeOrientation::setParameterization(RotationParameterization parameterization) {
+	// the angles are not kept up to date by the local parameterizations
+	if (parameterization == RotationParameterization::Angles && this->parameterization != parameterization)
+		ang = M.getAngles();
+	this->parameterization = parameterization;
+}
 
-	Point3D pl, pr;
-	Matrix partials(3, 3);
+Matrix RelativeOrientation::designMatrix() {
+	coplanarityA();
+	return A;
+}
 
-	double omega = M.getOmega();
-	double phi = M.getPhi();
-	double kappa = M.getKappa();
+Matrix RelativeOrientation::misclosureVector() {
+	return coplanarityCond();
+}
 
-	for (unsigned int i = 0; i < num_points; i++) {
-		pl = coords_left[i];
-		pr = coords_right[i];
+Matrix RelativeOrientation::getParameters() {
+	Matrix x(2 + rotationParameters(parameterization), 1);
+	x[0][0] = B.y;
+	x[1][0] = B.z;
+	getRotation(parameterization, ang, q, x, 2);
+	return x;
+}
 
-		pr.rotateBy(M.trans());
+void RelativeOrientation::setParameters(const Matrix &x) {
+	B.y = x.at(0, 0);
+	B.z = x.at(1, 0);
+	setRotation(parameterization, x, 2, ang, q, M);
+}
 
-		// differential wrt By
-		A[i][0] = pr.x * pl.z - pl.x * pr.z;
+void RelativeOrientation::update(const Matrix &del) {
+	B.y += del.at(0, 0);
+	B.z += del.at(1, 0);
+	updateRotation(parameterization, del, 2, ang, q, M);
+}
 
-		// differential wrt Bz
-		A[i][1] = pl.x * pr.y - pr.x * pl.y;
+/*
+ * With the right ray rotated into the left image space, pr = M' * Vr, and a = B x Vl, the
+ * coplanarity condition of a point and its partials are
+ *
+ * F = a . pr
+ * dF/dBy = (Vl x pr).y, dF/dBz = (Vl x pr).z
+ * dF/dt_k = r_k . (pr x a)
+ *
+ * since every partial of pr with respect to a rotation parameter is a cross product r_k x pr
+ * with an axis r_k that does not depend on the point (see coplanarityTerms). The kernels below
+ * evaluate them in one pass over the rays, which are stored coordinate by coordinate.
+ */
+struct CoplanarityRays {
+	const double *lx, *ly, *lz, *rx, *ry, *rz;
+
+	CoplanarityRays(const PointCloud3D &left, const PointCloud3D &right) :
+		lx(left.x.data()), ly(left.y.data()), lz(left.z.data()),
+		rx(right.x.data()), ry(right.y.data()), rz(right.z.data()) {}
+};
+
+// the condition F and the five partials d of point i
+static inline void coplanarity(const double *t, const CoplanarityRays &rays, unsigned int i, double &F, double *d) {
+	double lx = rays.lx[i], ly = rays.ly[i], lz = rays.lz[i];
+	double rx = rays.rx[i], ry = rays.ry[i], rz = rays.rz[i];
+
+	double px = t[3] * rx + t[4] * ry + t[5] * rz;
+	double py = t[6] * rx + t[7] * ry + t[8] * rz;
+	double pz = t[9] * rx + t[10] * ry + t[11] * rz;
+
+	double ax = t[1] * lz - t[2] * ly;
+	double ay = t[2] * lx - t[0] * lz;
+	double az = t[0] * ly - t[1] * lx;
+
+	F = ax * px + ay * py + az * pz;
+
+	d[0] = lz * px - lx * pz;
+	d[1] = lx * py - ly * px;
+
+	double gx = py * az - pz * ay;
+	double gy = pz * ax - px * az;
+	double gz = px * ay - py * ax;
+
+	for (unsigned int k = 0; k < 3; k++)
+		d[2 + k] = t[12 + 3 * k] * gx + t[13 + 3 * k] * gy + t[14 + 3 * k] * gz;
+}
 
-		// rotation differentials (setup the matrix)
-		partials[0][0] = B.x;  partials[0][1] = B.y;  partials[0][2] = B.z;
-		partials[1][0] = pl.x; partials[1][1] = pl.y; partials[1][2] = pl.z;
+#ifdef __AVX2__
+// coplanarity for the points [i, i + 4), with the terms broadcast into t
+static inline void coplanarity4(const __m256d *t, const CoplanarityRays &rays, unsigned int i, __m256d &F, __m256d *d) {
+	const __m256d lx = _mm256_loadu_pd(rays.lx + i), ly = _mm256_loadu_pd(rays.ly + i), lz = _mm256_loadu_pd(rays.lz + i);
+	const __m256d rx = _mm256_loadu_pd(rays.rx + i), ry = _mm256_loadu_pd(rays.ry + i), rz = _mm256_loadu_pd(rays.rz + i);
 
-		// differential wrt omega
-		partials[2][0] = 0;
-		partials[2][1] = -pr.z;
-		partials[2][2] = pr.y;
+	const __m256d px = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(t[3], rx), _mm256_mul_pd(t[4], ry)), _mm256_mul_pd(t[5], rz));
+	const __m256d py = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(t[6], rx), _mm256_mul_pd(t[7], ry)), _mm256_mul_pd(t[8], rz));
+	const __m256d pz = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(t[9], rx), _mm256_mul_pd(t[10], ry)), _mm256_mul_pd(t[11], rz));
 
-		A[i][2] = determinant(partials);
+	const __m256d ax = _mm256_sub_pd(_mm256_mul_pd(t[1], lz), _mm256_mul_pd(t[2], ly));
+	const __m256d ay = _mm256_sub_pd(_mm256_mul_pd(t[2], lx), _mm256_mul_pd(t[0], lz));
+	const __m256d az = _mm256_sub_pd(_mm256_mul_pd(t[0], ly), _mm256_mul_pd(t[1], lx));
 
-		// differential wrt phi
-		partials[2][0] = -pr.y * sin(omega) + pr.z * cos(omega);
-		partials[2][1] = pr.x * sin(omega);
-		partials[2][2] = -pr.x * cos(omega);
+	F = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(ax, px), _mm256_mul_pd(ay, py)), _mm256_mul_pd(az, pz));
 
-		A[i][3] = determinant(partials);
+	d[0] = _mm256_sub_pd(_mm256_mul_pd(lz, px), _mm256_mul_pd(lx, pz));
+	d[1] = _mm256_sub_pd(_mm256_mul_pd(lx, py), _mm256_mul_pd(ly, px));
 
-		// differential wrt kappa
-		partials[2][0] = -pr.y * cos(omega) * cos(phi) - pr.z * sin(omega) * cos(phi);
-		partials[2][1] = pr.x * cos(omega) * cos(phi) - pr.z * sin(phi);
-		partials[2][2] = pr.x * sin(omega) * cos(phi) + pr.y * sin(phi);
+	const __m256d gx = _mm256_sub_pd(_mm256_mul_pd(py, az), _mm256_mul_pd(pz, ay));
+	const __m256d gy = _mm256_sub_pd(_mm256_mul_pd(pz, ax), _mm256_mul_pd(px, az));
+	const __m256d gz = _mm256_sub_pd(_mm256_mul_pd(px, ay), _mm256_mul_pd(py, ax));
 
-		A[i][4] = determinant(partials);
+	for (unsigned int k = 0; k < 3; k++)
+		d[2 + k] = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(t[12 + 3 * k], gx), _mm256_mul_pd(t[13 + 3 * k], gy)),
+			_mm256_mul_pd(t[14 + 3 * k], gz));
+}
+
+static inline void broadcastTerms(const double *terms, __m256d *t) {
+	for (unsigned int k = 0; k < 21; k++)
+		t[k] = _mm256_set1_pd(terms[k]);
+}
+#endif
+
+// the conditions of the points [begin, end) into F and, if D is given, their partials into D (5 per point)
+static void coplanarityRange(const double *terms, const CoplanarityRays &rays, unsigned int begin, unsigned int end,
+	double *F, double *D) {
+
+	unsigned int i = begin;
+
+#ifdef __AVX2__
+	__m256d t[21];
+	broadcastTerms(terms, t);
+
+	for (; i + 4 <= end; i += 4) {
+		__m256d Fi, d[5];
+		coplanarity4(t, rays, i, Fi, d);
+		_mm256_storeu_pd(F + i, Fi);
+
+		if (D != NULL) {
+			double lanes[5][4];
+			for (unsigned int k = 0; k < 5; k++)
+				_mm256_storeu_pd(lanes[k], d[k]);
+			for (unsigned int lane = 0; lane < 4; lane++)
+				for (unsigned int k = 0; k < 5; k++)
+					D[5 * (i + lane) + k] = lanes[k][lane];
+		}
 	}
+#endif
+
+	double d[5];
+	for (; i < end; i++)
+		coplanarity(terms, rays, i, F[i], (D != NULL) ? D + 5 * i : d);
 }
 
-Matrix RelativeOrientation::coplanarityCond() {
+void RelativeOrientation::coplanarityTerms(double *terms) {
+	terms[0] = B.x;
+	terms[1] = B.y;
+	terms[2] = B.z;
 
-	Matrix cond;
-	cond.resize(num_points, 1);
+	for (unsigned int j = 0; j < 3; j++)
+		for (unsigned int k = 0; k < 3; k++)
+			terms[3 + 3 * j + k] = M.at(k, j);
 
-	Point3D pl, pr;
-	Matrix condition(3, 3);
+	double *r = terms + 12;
 
-	for (unsigned int i = 0; i < num_points; i++) {
-		pl = coords_left[i];
-		pr = coords_right[i];
+	if (parameterization != RotationParameterization::Angles) {
+		// local increments, M_new = R(d) * M: pr changes by -[pr]x * M' * d, so the axes
+		// are the rows of M
+		for (unsigned int k = 0; k < 3; k++)
+			for (unsigned int j = 0; j < 3; j++)
+				r[3 * k + j] = M.at(k, j);
+		return;
+	}
+
+	double omega = M.getOmega();
+	double phi = M.getPhi();
+	double so = sin(omega), co = cos(omega);
+	double sp = sin(phi), cp = cos(phi);
+
+	// omega
+	r[0] = 1;
+	r[1] = 0;
+	r[2] = 0;
+
+	// phi
+	r[3] = 0;
+	r[4] = co;
+	r[5] = so;
+
+	// kappa
+	r[6] = sp;
+	r[7] = -so * cp;
+	r[8] = co * cp;
+}
 
-		pr.rotateBy(M.trans());
+void RelativeOrientation::coplanarityA() {
+	double terms[21];
+	coplanarityTerms(terms);
 
-		condition[0][0] = B.x;  condition[0][1] = B.y;  condition[0][2] = B.z;
-		condition[1][0] = pl.x; condition[1][1] = pl.y; condition[1][2] = pl.z;
-		condition[2][0] = pr.x; condition[2][1] = pr.y; condition[2][2] = pr.z;
+	CoplanarityRays rays(coords_left, coords_right);
+	vector<double> F(num_points), D(5 * num_points);
 
-		cond[i][0] = determinant(condition);
-	}
+	parallelFor(num_points, [&](unsigned int begin, unsigned int end) {
+		coplanarityRange(terms, rays, begin, end, F.data(), D.data());
+	}, 0, 65536);
+
+	A.resize(num_points, 5);
+	for (unsigned int i = 0; i < num_points; i++)
+		for (unsigned int k = 0; k < 5; k++)
+			A[i][k] = D[5 * i + k];
+}
+
+Matrix RelativeOrientation::coplanarityCond() {
+	double terms[21];
+	coplanarityTerms(terms);
+
+	CoplanarityRays rays(coords_left, coords_right);
+	vector<double> F(num_points);
+
+	parallelFor(num_points, [&](unsigned int begin, unsigned int end) {
+		coplanarityRange(terms, rays, begin, end, F.data(), NULL);
+	}, 0, 65536);
+
+	Matrix cond;
+	cond.resize(num_points, 1);
+	for (unsigned int i = 0; i < num_points; i++)
+		cond[i][0] = F[i];
 
 	return cond;
 }
 
+/*
+ * N and u are summed point by point from the partials of the kernel, so the n-by-5 design
+ * matrix is never formed; the 15 elements of the upper triangle of N are kept
+ */
+bool RelativeOrientation::normalEquations(const Matrix &w, const vector<double> &p, Matrix &N, Matrix &u) {
+	double terms[21];
+	coplanarityTerms(terms);
+
+	CoplanarityRays rays(coords_left, coords_right);
+
+	// the misclosures in one array, so that four of them load together
+	vector<double> misclosure(num_points);
+	for (unsigned int i = 0; i < num_points; i++)
+		misclosure[i] = w.at(i, 0);
+
+	double sums[20] = {};
+	std::mutex sums_mutex;
+
+	parallelFor(num_points, [&](unsigned int begin, unsigned int end) {
+		double local[20] = {};
+		unsigned int i = begin;
+
+#ifdef __AVX2__
+		__m256d t[21], acc[20];
+		broadcastTerms(terms, t);
+		for (unsigned int k = 0; k < 20; k++)
+			acc[k] = _mm256_setzero_pd();
+
+		for (; i + 4 <= end; i += 4) {
+			__m256d F, d[5];
+			coplanarity4(t, rays, i, F, d);
+
+			const __m256d pi = _mm256_loadu_pd(&p[i]);
+			const __m256d wi = _mm256_loadu_pd(&misclosure[i]);
+
+			unsigned int k = 0;
+			for (unsigned int a = 0; a < 5; a++) {
+				const __m256d pd = _mm256_mul_pd(pi, d[a]);
+				for (unsigned int b = a; b < 5; b++, k++)
+					acc[k] = _mm256_add_pd(acc[k], _mm256_mul_pd(pd, d[b]));
+				acc[15 + a] = _mm256_add_pd(acc[15 + a], _mm256_mul_pd(pd, wi));
+			}
+		}
+
+		double lanes[4];
+		for (unsigned int k = 0; k < 20; k++) {
+			_mm256_storeu_pd(lanes, acc[k]);
+			local[k] = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+		}
+#endif
+
+		for (; i < end; i++) {
+			double F, d[5];
+			coplanarity(terms, rays, i, F, d);
+
+			unsigned int k = 0;
+			for (unsigned int a = 0; a < 5; a++) {
+				double pd = p[i] * d[a];
+				for (unsigned int b = a; b < 5; b++, k++)
+					local[k] += pd * d[b];
+				local[15 + a] += pd * misclosure[i];
+			}
+		}
+
+		std::lock_guard<std::mutex> lock(sums_mutex);
+		for (unsigned int k = 0; k < 20; k++)
+			sums[k] += local[k];
+	}, 0, 65536);
+
+	N = Matrix(5, 5);
+	u = Matrix(5, 1);
+
+	unsigned int k = 0;
+	for (unsigned int a = 0; a < 5; a++) {
+		for (unsigned int b = a; b < 5; b++, k++) {
+			N[a][b] = sums[k];
+			N[b][a] = sums[k];
+		}
+		u[a][0] = sums[15 + a];
+	}
+
+	return true;
+}
+
 void RelativeOrientation::computeModelSpace() {
 
 	coords_model.clear();
 	parallax.clear();
 
 	Point3D pl, pr;
+	RotationMatrix M_trans = M.trans();
+
+	coords_model.reserve(num_points);
+	parallax.reserve(num_points);
 
 	for (unsigned int i = 0; i < num_points; i++) {
 		pl = coords_left[i];
 		pr = coords_right[i];
 
-		pr.rotateBy(M.trans());
+		pr.rotateBy(M_trans);
 
 		// explicitly solve for coefficients because Matrix inv() does not support
 		// non positive definite matrices
@@ -141,15 +384,21 @@ void RelativeOrientation::computeModelSpace() {
 }
 
 Matrix RelativeOrientation::getA() {
+	if (A.getrows() == 0)
+		coplanarityA();
 	return A;
 }
 
+SolverReport RelativeOrientation::getReport() {
+	return report;
+}
+
 vector<Point3D> RelativeOrientation::getLeftCoords() {
-	return coords_left;
+	return coords_left.toPoints();
 }
 
 vector<Point3D> RelativeOrientation::getRightCoords() {
-	return coords_right;
+	return coords_right.toPoints();
 }
 
 vector<Point3D> RelativeOrientation::getModelCoords() {
@@ -171,14 +420,3 @@ Point3D RelativeOrientation::getB() {
 double RelativeOrientation::getFocalLength() {
 	return c;
 }
-
-double RelativeOrientation::determinant(Matrix &mat) {
-	if (mat.getcols() != 3 || mat.getrows() != 3) {
-		std::cout << "Incorrect sized matrix. Exiting..." << std::endl;
-		exit(1);
-	}
-
-	return mat[0][0] * (mat[1][1] * mat[2][2] - mat[1][2] * mat[2][1]) -
-			mat[1][0] * (mat[0][1] * mat[2][2] - mat[0][2] * mat[2][1]) +
-			mat[2][0] * (mat[0][1] * mat[1][2] - mat[0][2] * mat[1][1]);
-}
\ No newline at end of file
@@ -3,9 +3,12 @@
 
 #include "RotationMatrix.h"
 #include "LeastSquares.h"
+#include "Adjustment.h"
 #include "Point.h"
+#include "PointCloud.h"
+#include "Quaternion.h"
 
-class RelativeOrientation {
+class RelativeOrientation : public Adjustment {
 public:
 	/** RelativeOrientation
 	 * the constructor of this class; converts the set of 2D coordinates into 3D points
@@ -18,16 +21,30 @@ public:
 	 * @param c			   - the focal length of the images
 	 */
 	RelativeOrientation(const vector<Point2D> &coords_left, const vector<Point2D> &coords_right, double c);
+	RelativeOrientation(const PointCloud2D &coords_left, const PointCloud2D &coords_right, double c);
 
 	/** computeOrientation
-	 * computes all parameters in the relative orientation adjustment
+	 * computes all parameters in the relative orientation adjustment with the damped
+	 * least-squares solver; the outcome of the iterations is available from getReport()
 	 * 
 	 * @param _B   - the point of expansion for the base vector
 	 * @param _ang - the point of expansion for the rotation angles
 	 */
 	void computeOrientation(const Point3D &_B, const Angles &_ang);
 
+	/** setSolverOptions
+	 * sets the iteration cap and damping of the solver used by computeOrientation
+	 */
+	void setSolverOptions(const SolverOptions &options);
+
+	/** setParameterization
+	 * selects how the rotation is parameterized by computeOrientation; with Quaternion or
+	 * Rodrigues the rotation increments are local small angles, see Quaternion.h
+	 */
+	void setParameterization(RotationParameterization parameterization);
+
 	Matrix getA();
+	SolverReport getReport();
 
 	vector<Point3D> getLeftCoords();
 	vector<Point3D> getRightCoords();
@@ -39,20 +56,36 @@ public:
 	Point3D getB();
 	double getFocalLength();
 
+	// Adjustment interface; parameters are [By, Bz, omega, phi, kappa], or the quaternion
+	// or rotation vector in place of the angles (see setParameterization)
+	Matrix designMatrix();
+	Matrix misclosureVector();
+	bool normalEquations(const Matrix &w, const vector<double> &p, Matrix &N, Matrix &u);
+	Matrix getParameters();
+	void setParameters(const Matrix &x);
+	void update(const Matrix &del);
+
 private:
 	Matrix A;
 
+	SolverOptions options;
+	SolverReport report;
+
 	unsigned int num_points;
-	vector<Point3D> coords_left; // constructs reference frame
-	vector<Point3D> coords_right;
+	PointCloud3D coords_left; // constructs reference frame
+	PointCloud3D coords_right;
 
 	vector<Point3D> coords_model;
 	vector<Point3D> parallax;
 
 	RotationMatrix M; // rotates from model to image space
+	Angles ang;		  // rotation angles of M (with the Angles parameterization only)
+	Quaternion q;	  // rotation of M for the local parameterizations
 	Point3D B;
 	double c; // focal length
 
+	RotationParameterization parameterization;
+
 	/** coplanarityA
 	 * Computes a n-by-5 design matrix for a relative orientaion transformation
 	 *
@@ -69,20 +102,20 @@ private:
 	 */
 	Matrix coplanarityCond();
 
+	/** coplanarityTerms
+	 * Collects what the coplanarity kernels need from the current estimate, so that the
+	 * trigonometry is done once per evaluation instead of once per point
+	 *
+	 * @param terms - 21 values: B, then M' row by row, then the rotation axes r_k row by
+	 *				  row, with d(M' * Vr)/dt_k = r_k x (M' * Vr) for the rotation parameter t_k
+	 */
+	void coplanarityTerms(double *terms);
+
 	/** computeModelSpace
 	 * Determines the final model space coordinates as well as using the RO parallax using
 	 * the space intersected coordinates of each image
 	 */
 	void computeModelSpace();
-
-	/** determinant
-	 * Computes the determinant of a strictly 3-by-3 matrix
-	 *
-	 * @param mat - the matrix in which we want the determinant of
-	 *
-	 * @return	  - the determinant of the matrix
-	 */
-	double determinant(Matrix &mat);
 };
 
 
@@ -1,39 +1,114 @@
 
 #include "Resection.h"
 
-Resection::Resection(const vector<Point3D> &coords_object, const vector<Point2D> &coords_image, double c) {
+Resection::Resection(const vector<Point3D> &coords_object, const vector<Point2D> &coords_image, double c) :
+	Resection(PointCloud3D(coords_object), PointCloud2D(coords_image), c) {}
+
+Resection::Resection(const PointCloud3D &coords_object, const PointCloud2D &coords_image, double c) {
 	this->num_points = coords_object.size();
 	this->coords_object = coords_object;
 	this->coords_image = coords_image;
 	this->c = c;
+	this->loss = NULL;
+	this->parameterization = RotationParameterization::Angles;
+}
+
+void Resection::setRobustLoss(const RobustLoss *loss) {
+	this->loss = loss;
 }
 
 void Resection::computeResection(const Point3D &_T, const Angles &_ang, const Matrix &tolerances) {
 	T = _T;
-	Angles ang = _ang;
+	ang = _ang;
+	M.rotate(ang);
+	q = Quaternion::fromMatrix(M);
+
+	obs = convertToVector(coords_image);
+	weights.assign(2 * num_points, 1.0);
+
+	report = levenbergMarquardt(*this, tolerances, options);
+
+	A = resectionA();
+	w = misclosureVector();
+	del = report.step;
+
+	// at the solution the residuals are the misclosures: v = f(x_hat) - l
+	v = w;
+}
+
+void Resection::setSolverOptions(const SolverOptions &options) {
+	this->options = options;
+}
+
+void Resection::setParameterization(RotationParameterization parameterization) {
+	// the angles are not kept up to date by the local parameterizations
+	if (parameterization == RotationParameterization::Angles && this->parameterization != parameterization)
+		ang = M.getAngles();
+	this->parameterization = parameterization;
+}
+
+void Resection::setOrientation(const Point3D &_T, const Angles &_ang) {
+	T = _T;
+	ang = _ang;
 	M.rotate(ang);
+	q = Quaternion::fromMatrix(M);
+}
+
+Matrix Resection::collinearityPartials(const Point3D &op) {
+	Matrix B(2, 6);
+
+	// the angles are only current with the Angles parameterization
+	Angles a = (parameterization == RotationParameterization::Angles) ? ang : M.getAngles();
+	vector<double> sin_vals = { sin(a.omega), sin(a.phi), sin(a.kappa) };
+	vector<double> cos_vals = { cos(a.omega), cos(a.phi), cos(a.kappa) };
+
+	computeRowX(B, 0, op, sin_vals, cos_vals);
+	computeRowY(B, 1, op, sin_vals, cos_vals);
+
+	return B;
+}
+
+Point2D Resection::project(const Point3D &op) {
+	double w = W(op);
+	return Point2D(op.id, -c * U(op) / w, -c * V(op) / w);
+}
 
-	Matrix obs = convertToVector(coords_image);
-	Matrix est;
+Matrix Resection::designMatrix() {
+	return resectionA();
+}
+
+Matrix Resection::misclosureVector() {
+	return misclosure(obs, resectionCond());
+}
 
-	double threshold = 1e-6;
-	do {
-		A = resectionA();
-		est = resectionCond();
-		w = misclosure(obs, est);
-		del = delta(A, w);
+vector<double> Resection::observationWeights(const Matrix &w) {
+	if (loss != NULL)
+		weights = robustWeights(w, *loss);
 
-		T.x += del.at(0, 0);
-		T.y += del.at(1, 0);
-		T.z += del.at(2, 0);
-		ang.omega += del.at(3, 0);
-		ang.phi += del.at(4, 0);
-		ang.kappa += del.at(5, 0);
+	return weights;
+}
+
+Matrix Resection::getParameters() {
+	Matrix x(3 + rotationParameters(parameterization), 1);
+	x[0][0] = T.x;
+	x[1][0] = T.y;
+	x[2][0] = T.z;
+	getRotation(parameterization, ang, q, x, 3);
+	return x;
+}
 
-		M.rotate(ang);
-	} while (!belowTolerances(del, tolerances));
+void Resection::setParameters(const Matrix &x) {
+	T.x = x.at(0, 0);
+	T.y = x.at(1, 0);
+	T.z = x.at(2, 0);
+	setRotation(parameterization, x, 3, ang, q, M);
+}
 
-	v = residuals(A, del, w);
+void Resection::update(const Matrix &del) {
+	T.x += del.at(0, 0);
+	T.y += del.at(1, 0);
+	T.z += del.at(2, 0);
+	updateRotation(parameterization, del, 3, ang, q, M);
 }
 
 Matrix Resection::resectionA() {
@@ -42,12 +117,18 @@ Matrix Resection::resectionA() {
 
 	Point3D op;
 
+	if (parameterization != RotationParameterization::Angles) {
+		for (unsigned int i = 0; i < num_points; i++)
+			computeRowsLocal(A, 2 * i, Point3D(coords_object.x[i], coords_object.y[i], coords_object.z[i]));
+		return A;
+	}
+
 	double omega = M.getOmega();
 	double phi = M.getPhi();
 	double kappa = M.getKappa();
 
 	for (unsigned int i = 0; i < num_points; i++) {
-		op = coords_object[i];
+		op = Point3D(coords_object.x[i], coords_object.y[i], coords_object.z[i]);
 
 		// define sine and cosine values for omega, phi, and kappa
 		// so to reduce computation time
@@ -68,7 +149,7 @@ Matrix Resection::resectionCond() {
 	Point3D op;
 
 	for (unsigned int i = 0; i < num_points; i++) {
-		op = coords_object[i];
+		op = Point3D(coords_object.x[i], coords_object.y[i], coords_object.z[i]);
 		
 		cond.at(2 * i, 0) = -c * U(op) / W(op);
 		cond.at(2 * i + 1, 0) = -c * V(op) / W(op);
@@ -119,6 +200,27 @@ void Resection::computeRowY(Matrix &A, int row, const Point3D &op, const vector<
 	A.at(row, 5) = c * u / w;
 }
 
+void Resection::computeRowsLocal(Matrix &A, int row, const Point3D &op) {
+	double u = U(op);
+	double v = V(op);
+	double w = W(op);
+	double coeff = -c / (w * w);
+
+	A.at(row, 0) = coeff * (M.at(2, 0) * u - M.at(0, 0) * w);
+	A.at(row, 1) = coeff * (M.at(2, 1) * u - M.at(0, 1) * w);
+	A.at(row, 2) = coeff * (M.at(2, 2) * u - M.at(0, 2) * w);
+	A.at(row, 3) = coeff * u * v;
+	A.at(row, 4) = -coeff * (w * w + u * u);
+	A.at(row, 5) = coeff * w * v;
+
+	A.at(row + 1, 0) = coeff * (M.at(2, 0) * v - M.at(1, 0) * w);
+	A.at(row + 1, 1) = coeff * (M.at(2, 1) * v - M.at(1, 1) * w);
+	A.at(row + 1, 2) = coeff * (M.at(2, 2) * v - M.at(1, 2) * w);
+	A.at(row + 1, 3) = coeff * (w * w + v * v);
+	A.at(row + 1, 4) = -coeff * u * v;
+	A.at(row + 1, 5) = -coeff * w * u;
+}
+
 double Resection::U(const Point3D &point) {
 	Point3D diff = point.difference(T);
 	return M.at(0, 0) * diff.x + M.at(0, 1) * diff.y + M.at(0, 2) * diff.z;
@@ -150,12 +252,20 @@ Matrix Resection::getResiduals() {
 	return v;
 }
 
+vector<double> Resection::getWeights() {
+	return weights;
+}
+
+SolverReport Resection::getReport() {
+	return report;
+}
+
 vector<Point3D> Resection::getObjectCoords() {
-	return coords_object;
+	return coords_object.toPoints();
 }
 
 vector<Point2D> Resection::getImageCoords() {
-	return coords_image;
+	return coords_image.toPoints();
 }
 
 RotationMatrix Resection::getM() {
@@ -168,4 +278,8 @@ Point3D Resection::getT() {
 
 double Resection::getFocalLength() {
 	return c;
+}
+
+Camera Resection::getCamera() {
+	return Camera(M, T, c);
 }
\ No newline at end of file
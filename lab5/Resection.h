@@ -1,22 +1,81 @@
 #pragma once
 
 #include "LeastSquares.h"
+#include "Adjustment.h"
+#include "Camera.h"
+#include "RobustLoss.h"
 #include "Point.h"
+#include "PointCloud.h"
+#include "Quaternion.h"
 #include "RotationMatrix.h"
 #include "Matrix.h"
 
-class Resection {
+class Resection : public Adjustment {
 public:
 	Resection(const vector<Point3D> &coords_object, const vector<Point2D> &coords_image, double c);
+	Resection(const PointCloud3D &coords_object, const PointCloud2D &coords_image, double c);
 
 	/** computeOrientation
-	 * Computes all parameters in the resection
+	 * Computes all parameters in the resection with the damped least-squares solver;
+	 * the outcome of the iterations is available from getReport()
 	 *
-	 * @param _T	  - the point of expansion for the translation vector
-	 * @param _ang	  - the point of expansion for the rotation angles
+	 * @param _T		 - the point of expansion for the translation vector
+	 * @param _ang		 - the point of expansion for the rotation angles
+	 * @param tolerances - a 6-by-1 vector of tolerances on the absolute delta values
 	 */
 	void computeResection(const Point3D &_T, const Angles &_ang, const Matrix &tolerances);
 
+	/** setSolverOptions
+	 * sets the iteration cap and damping of the solver used by computeResection
+	 */
+	void setSolverOptions(const SolverOptions &options);
+
+	/** setParameterization
+	 * selects how the rotation is parameterized by computeResection; with Quaternion or
+	 * Rodrigues the rotation increments are local small angles, see Quaternion.h
+	 */
+	void setParameterization(RotationParameterization parameterization);
+
+	/** setOrientation
+	 * sets the exterior orientation without running the adjustment
+	 *
+	 * @param _T   - the position of the perspective centre
+	 * @param _ang - the rotation angles
+	 */
+	void setOrientation(const Point3D &_T, const Angles &_ang);
+
+	/** collinearityPartials
+	 * computes the 2-by-6 partial derivatives of the image coordinates of a single object
+	 * point wrt. {Tx, Ty, Tz, omega, phi, kappa} at the current orientation. Since the
+	 * collinearity equations depend on (X - T), the partials wrt. the object point
+	 * {X, Y, Z} are the negated first three columns
+	 *
+	 * @param op - the object point
+	 *
+	 * @return	 - the 2-by-6 matrix with rows {x, y}
+	 */
+	Matrix collinearityPartials(const Point3D &op);
+
+	/** project
+	 * projects an object point into the image with the collinearity condition
+	 *
+	 * x = -c * U / W,  y = -c * V / W
+	 *
+	 * @param op - the object point
+	 *
+	 * @return	 - the image coordinates of the point
+	 */
+	Point2D project(const Point3D &op);
+
+	/** setRobustLoss
+	 * switches the adjustment into an iteratively reweighted least-squares (IRLS) mode;
+	 * after the first iteration the observation weights are updated from the misclosures
+	 * using the given loss. Passing NULL restores the unweighted adjustment
+	 *
+	 * @param loss - the robust loss function (not owned; must outlive the adjustment)
+	 */
+	void setRobustLoss(const RobustLoss *loss);
+
 	Matrix getA();
 	Matrix getMisclosure();
 	Matrix getDelta();
@@ -25,20 +84,44 @@ public:
 	vector<Point3D> getObjectCoords();
 	vector<Point2D> getImageCoords();
 
+	vector<double> getWeights();
+	SolverReport getReport();
+
 	RotationMatrix getM();
 	Point3D getT();
 	double getFocalLength();
+	Camera getCamera(); // the current orientation for the batch projection kernels
+
+	// Adjustment interface; parameters are [Tx, Ty, Tz, omega, phi, kappa], or the
+	// quaternion or rotation vector in place of the angles (see setParameterization)
+	Matrix designMatrix();
+	Matrix misclosureVector();
+	vector<double> observationWeights(const Matrix &w);
+	Matrix getParameters();
+	void setParameters(const Matrix &x);
+	void update(const Matrix &del);
 private:
 	Matrix A, w, del, v;
+	Matrix obs; // 2n-by-1 vector of image observations
+
+	SolverOptions options;
+	SolverReport report;
+
+	const RobustLoss *loss; // NULL for an unweighted adjustment
+	vector<double> weights;  // diagonal of the weight matrix
 
 	unsigned int num_points;
-	vector<Point3D> coords_object;
-	vector<Point2D> coords_image;
+	PointCloud3D coords_object;
+	PointCloud2D coords_image;
 
 	RotationMatrix M; // rotates from model to object space
+	Angles ang;		  // rotation angles of M (with the Angles parameterization only)
+	Quaternion q;	  // rotation of M for the local parameterizations
 	Point3D T;		  // translation vector from object to model space
 	double c;		  // focal length
 
+	RotationParameterization parameterization;
+
 	/** resectionA
 	 * Determines a 2n-by-7 design matrix for resection
 	 *
@@ -95,6 +178,17 @@ private:
 	 */
 	void computeRowY(Matrix &A, int row, const Point3D &op, const vector<double> &sinv, const vector<double> &cosv);
 
+	/** computeRowsLocal
+	 * updates the X and Y rows of the design matrix for the local rotation increments
+	 *
+	 * d{x, y}/d{rotation} = -c/W^2 * [ UV, -(W^2 + U^2), WV ; W^2 + V^2, -UV, -WU ]
+	 *
+	 * @param A	  - the current design matrix being calculated (manipulated)
+	 * @param row - the X row; the Y row follows it
+	 * @param op  - the object point of the rows
+	 */
+	void computeRowsLocal(Matrix &A, int row, const Point3D &op);
+
 	/** U
 	 * computes the U value of the coplanarity condition for a given point
 	 * 
@@ -0,0 +1,59 @@
+#include <algorithm>
+#include "RobustLoss.h"
+
+HuberLoss::HuberLoss(double k) : k(k) {}
+
+double HuberLoss::weight(double u) const {
+	double a = fabs(u);
+	if (a <= k)
+		return 1.0;
+	return k / a;
+}
+
+CauchyLoss::CauchyLoss(double k) : k(k) {}
+
+double CauchyLoss::weight(double u) const {
+	double r = u / k;
+	return 1.0 / (1.0 + r * r);
+}
+
+TukeyLoss::TukeyLoss(double k) : k(k) {}
+
+double TukeyLoss::weight(double u) const {
+	if (fabs(u) >= k)
+		return 0.0;
+	double r = u / k;
+	double t = 1.0 - r * r;
+	return t * t;
+}
+
+double robustScale(const Matrix &v) {
+	unsigned int n = v.getrows();
+	if (n == 0)
+		return 0.0;
+
+	vector<double> abs_v(n);
+	for (unsigned int i = 0; i < n; i++)
+		abs_v[i] = fabs(v.at(i, 0));
+
+	// median in linear time; the upper median is sufficient for a scale estimate
+	std::nth_element(abs_v.begin(), abs_v.begin() + n / 2, abs_v.end());
+
+	return 1.4826 * abs_v[n / 2];
+}
+
+vector<double> robustWeights(const Matrix &v, const RobustLoss &loss) {
+	unsigned int n = v.getrows();
+	vector<double> p(n, 1.0);
+
+	double sigma = robustScale(v);
+
+	// a perfect fit (or more than half exact observations) leaves nothing to down-weight
+	if (sigma <= 0.0)
+		return p;
+
+	for (unsigned int i = 0; i < n; i++)
+		p[i] = loss.weight(v.at(i, 0) / sigma);
+
+	return p;
+}
@@ -0,0 +1,91 @@
+/*
+ * The purpose of this header is to provide the robust loss functions used in an
+ * iteratively reweighted least-squares (IRLS) adjustment. Each loss maps a
+ * standardized residual onto an observation weight so that gross errors are
+ * down-weighted during the adjustment rather than found in a separate pass.
+ */
+
+#pragma once
+
+#include <vector>
+#include "Matrix.h"
+
+class RobustLoss {
+public:
+	virtual ~RobustLoss() {}
+
+	/** weight
+	 * computes the IRLS weight of an observation from its standardized residual
+	 *
+	 * w(u) = psi(u) / u
+	 *
+	 * @param u - the standardized residual (v / sigma)
+	 *
+	 * @return	- the weight of the observation in the range [0, 1]
+	 */
+	virtual double weight(double u) const = 0;
+};
+
+class HuberLoss : public RobustLoss {
+public:
+	/** HuberLoss
+	 * quadratic for |u| <= k and linear beyond; never rejects an observation completely
+	 *
+	 * @param k - the tuning constant (95% efficiency at the normal distribution: 1.345)
+	 */
+	HuberLoss(double k = 1.345);
+	double weight(double u) const;
+private:
+	double k;
+};
+
+class CauchyLoss : public RobustLoss {
+public:
+	/** CauchyLoss
+	 * w(u) = 1 / (1 + (u / k)^2)
+	 *
+	 * @param k - the tuning constant (95% efficiency at the normal distribution: 2.385)
+	 */
+	CauchyLoss(double k = 2.385);
+	double weight(double u) const;
+private:
+	double k;
+};
+
+class TukeyLoss : public RobustLoss {
+public:
+	/** TukeyLoss
+	 * biweight loss; observations with |u| > k receive a weight of zero
+	 *
+	 * @param k - the tuning constant (95% efficiency at the normal distribution: 4.685)
+	 */
+	TukeyLoss(double k = 4.685);
+	double weight(double u) const;
+private:
+	double k;
+};
+
+/** robustScale
+ * computes a robust estimate of the residual standard deviation using the
+ * median absolute deviation
+ *
+ * sigma = 1.4826 * median(|v|)
+ *
+ * @param v - the n-by-1 residual (or misclosure) vector
+ *
+ * @return	- the robust scale of the residuals
+ */
+double robustScale(const Matrix &v);
+
+/** robustWeights
+ * computes the diagonal of the IRLS weight matrix from the current residuals;
+ * the weight matrix itself is never formed
+ *
+ * p_i = w(v_i / sigma)
+ *
+ * @param v	   - the n-by-1 residual (or misclosure) vector
+ * @param loss - the robust loss function providing the weights
+ *
+ * @return	   - the n diagonal weights of the observations
+ */
+vector<double> robustWeights(const Matrix &v, const RobustLoss &loss);
@@ -1,4 +1,6 @@
 #include "RotationMatrix.h"
+#include "Parallel.h"
+#include "SimdMath.h"
 
 RotationMatrix::RotationMatrix() {
 	resize(3, 3);
@@ -15,43 +17,46 @@ void RotationMatrix::rotate(double rx, double ry, double rz) {
 }
 
 void RotationMatrix::rotate(Angles angle) {
-	clear();
-	rotateAboutX(angle.omega);
-	rotateAboutY(angle.phi);
-	rotateAboutZ(angle.kappa);
+	double m[9];
+	rotationMatrix(angle.omega, angle.phi, angle.kappa, m);
+
+	for (unsigned int i = 0; i < 3; i++) {
+		vector<double> &row = (*this)[i];
+		row[0] = m[3 * i];
+		row[1] = m[3 * i + 1];
+		row[2] = m[3 * i + 2];
+	}
 }
 
+// the rotations below are applied to the rows in place: only two rows change
 void RotationMatrix::rotateAboutX(double rx) {
-	Matrix rot(3, 3);
-	rot[0][0] = 1;
-	rot[1][1] = cos(rx);
-	rot[1][2] = sin(rx);
-	rot[2][1] = -rot[1][2];
-	rot[2][2] = rot[1][1];
-
-	(*this) = rot * (*this);
+	double s = sin(rx), c = cos(rx);
+	vector<double> &r1 = (*this)[1], &r2 = (*this)[2];
+	for (unsigned int j = 0; j < 3; j++) {
+		double a = r1[j], b = r2[j];
+		r1[j] = c * a + s * b;
+		r2[j] = -s * a + c * b;
+	}
 }
 
 void RotationMatrix::rotateAboutY(double ry) {
-	Matrix rot(3, 3);
-	rot[0][0] = cos(ry);
-	rot[0][2] = -sin(ry);
-	rot[1][1] = 1;
-	rot[2][0] = -rot[0][2];
-	rot[2][2] = rot[0][0];
-
-	(*this) = rot * (*this);
+	double s = sin(ry), c = cos(ry);
+	vector<double> &r0 = (*this)[0], &r2 = (*this)[2];
+	for (unsigned int j = 0; j < 3; j++) {
+		double a = r0[j], b = r2[j];
+		r0[j] = c * a - s * b;
+		r2[j] = s * a + c * b;
+	}
 }
 
 void RotationMatrix::rotateAboutZ(double rz) {
-	Matrix rot(3, 3);
-	rot[0][0] = cos(rz);
-	rot[0][1] = sin(rz);
-	rot[1][0] = -rot[0][1];
-	rot[1][1] = rot[0][0];
-	rot[2][2] = 1;
-
-	(*this) = rot * (*this);
+	double s = sin(rz), c = cos(rz);
+	vector<double> &r0 = (*this)[0], &r1 = (*this)[1];
+	for (unsigned int j = 0; j < 3; j++) {
+		double a = r0[j], b = r1[j];
+		r0[j] = c * a + s * b;
+		r1[j] = -s * a + c * b;
+	}
 }
 
 RotationMatrix RotationMatrix::trans() {
@@ -110,4 +115,66 @@ const RotationMatrix operator* (const RotationMatrix& mat1, const RotationMatrix
 				temp[i][j] += mat1[i][k] * mat2[k][j];
 
 	return temp;
-}
\ No newline at end of file
+}
+
+void rotationMatrix(double omega, double phi, double kappa, double *m) {
+	double so = sin(omega), co = cos(omega);
+	double sp = sin(phi), cp = cos(phi);
+	double sk = sin(kappa), ck = cos(kappa);
+
+	m[0] = cp * ck;
+	m[1] = co * sk + so * sp * ck;
+	m[2] = so * sk - co * sp * ck;
+	m[3] = -cp * sk;
+	m[4] = co * ck - so * sp * sk;
+	m[5] = so * ck + co * sp * sk;
+	m[6] = sp;
+	m[7] = -so * cp;
+	m[8] = co * cp;
+}
+
+// builds the matrices of the records [begin, end)
+static void rotationMatricesRange(const double *omega, const double *phi, const double *kappa, unsigned int begin,
+	unsigned int end, double *m) {
+
+	unsigned int i = begin;
+
+#ifdef __AVX2__
+	for (; i + 4 <= end; i += 4) {
+		__m256d so, co, sp, cp, sk, ck;
+		sincos4(_mm256_loadu_pd(omega + i), so, co);
+		sincos4(_mm256_loadu_pd(phi + i), sp, cp);
+		sincos4(_mm256_loadu_pd(kappa + i), sk, ck);
+
+		__m256d e[9];
+		e[0] = _mm256_mul_pd(cp, ck);
+		e[1] = _mm256_add_pd(_mm256_mul_pd(co, sk), _mm256_mul_pd(_mm256_mul_pd(so, sp), ck));
+		e[2] = _mm256_sub_pd(_mm256_mul_pd(so, sk), _mm256_mul_pd(_mm256_mul_pd(co, sp), ck));
+		e[3] = _mm256_xor_pd(_mm256_mul_pd(cp, sk), _mm256_set1_pd(-0.0));
+		e[4] = _mm256_sub_pd(_mm256_mul_pd(co, ck), _mm256_mul_pd(_mm256_mul_pd(so, sp), sk));
+		e[5] = _mm256_add_pd(_mm256_mul_pd(so, ck), _mm256_mul_pd(_mm256_mul_pd(co, sp), sk));
+		e[6] = sp;
+		e[7] = _mm256_xor_pd(_mm256_mul_pd(so, cp), _mm256_set1_pd(-0.0));
+		e[8] = _mm256_mul_pd(co, cp);
+
+		// transpose the nine element vectors into four consecutive records
+		double lanes[9][4];
+		for (unsigned int k = 0; k < 9; k++)
+			_mm256_storeu_pd(lanes[k], e[k]);
+		for (unsigned int l = 0; l < 4; l++)
+			for (unsigned int k = 0; k < 9; k++)
+				m[9 * (i + l) + k] = lanes[k][l];
+	}
+#endif
+
+	for (; i < end; i++)
+		rotationMatrix(omega[i], phi[i], kappa[i], m + 9 * i);
+}
+
+void rotationMatrices(const double *omega, const double *phi, const double *kappa, unsigned int n, double *m,
+	unsigned int num_threads) {
+
+	parallelFor(n, [&](unsigned int begin, unsigned int end) {
+		rotationMatricesRange(omega, phi, kappa, begin, end, m);
+	}, num_threads, 16384);
+}
@@ -52,4 +52,24 @@ public:
 	const RotationMatrix& operator= (const Matrix& mat1);
 	friend const RotationMatrix operator* (const RotationMatrix& mat1, const RotationMatrix& mat2);
 private:
-};
\ No newline at end of file
+};
+
+/** rotationMatrix
+ * the closed form of R = R3(kappa) * R2(phi) * R1(omega), written row-major into m[9]
+ *
+ * @param omega, phi, kappa - the rotation angles [rad]
+ * @param m					- the nine elements of the matrix
+ */
+void rotationMatrix(double omega, double phi, double kappa, double *m);
+
+/** rotationMatrices
+ * builds the rotation matrices of many attitude records at once, vectorized across
+ * records where AVX2 is available and threaded across chunks
+ *
+ * @param omega, phi, kappa - n angles each [rad]
+ * @param n					- the number of records
+ * @param m					- 9 * n elements, the row-major matrix of record i at m + 9 * i
+ * @param num_threads		- the maximum number of threads (0: one per hardware thread)
+ */
+void rotationMatrices(const double *omega, const double *phi, const double *kappa, unsigned int n, double *m,
+	unsigned int num_threads = 0);
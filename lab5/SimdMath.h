@@ -0,0 +1,93 @@
+/*
+ * The purpose of this header is to provide the elementary functions needed by the AVX2
+ * batch kernels, four doubles at a time. The standard library has no vector versions of
+ * them, and the kernels would otherwise fall back to one call per lane.
+ */
+
+#pragma once
+
+#ifdef __AVX2__
+#include <immintrin.h>
+
+// sine and cosine of four angles: reduction by multiples of pi/2 in three parts, then the
+// minimax polynomials of fdlibm on [-pi/4, pi/4]; accurate to a few ulp for |x| < 1e5
+inline void sincos4(__m256d x, __m256d &s, __m256d &c) {
+	const __m256d k = _mm256_round_pd(_mm256_mul_pd(x, _mm256_set1_pd(0.63661977236758134308)),
+		_MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+
+	__m256d r = _mm256_sub_pd(x, _mm256_mul_pd(k, _mm256_set1_pd(1.57079632673412561417e+00)));
+	r = _mm256_sub_pd(r, _mm256_mul_pd(k, _mm256_set1_pd(6.07710050630396597660e-11)));
+	r = _mm256_sub_pd(r, _mm256_mul_pd(k, _mm256_set1_pd(2.02226624879595063154e-21)));
+	const __m256d z = _mm256_mul_pd(r, r);
+
+	__m256d ps = _mm256_set1_pd(1.58969099521155010221e-10);
+	ps = _mm256_add_pd(_mm256_mul_pd(ps, z), _mm256_set1_pd(-2.50507602534068634195e-08));
+	ps = _mm256_add_pd(_mm256_mul_pd(ps, z), _mm256_set1_pd(2.75573137070700676789e-06));
+	ps = _mm256_add_pd(_mm256_mul_pd(ps, z), _mm256_set1_pd(-1.98412698298579493134e-04));
+	ps = _mm256_add_pd(_mm256_mul_pd(ps, z), _mm256_set1_pd(8.33333333332248946124e-03));
+	ps = _mm256_add_pd(_mm256_mul_pd(ps, z), _mm256_set1_pd(-1.66666666666666324348e-01));
+	const __m256d sr = _mm256_add_pd(r, _mm256_mul_pd(_mm256_mul_pd(r, z), ps));
+
+	__m256d pc = _mm256_set1_pd(-1.13596475577881948265e-11);
+	pc = _mm256_add_pd(_mm256_mul_pd(pc, z), _mm256_set1_pd(2.08757232129817482790e-09));
+	pc = _mm256_add_pd(_mm256_mul_pd(pc, z), _mm256_set1_pd(-2.75573143513906633035e-07));
+	pc = _mm256_add_pd(_mm256_mul_pd(pc, z), _mm256_set1_pd(2.48015872894767294178e-05));
+	pc = _mm256_add_pd(_mm256_mul_pd(pc, z), _mm256_set1_pd(-1.38888888888741095749e-03));
+	pc = _mm256_add_pd(_mm256_mul_pd(pc, z), _mm256_set1_pd(4.16666666666666019037e-02));
+	const __m256d cr = _mm256_add_pd(_mm256_sub_pd(_mm256_set1_pd(1.0), _mm256_mul_pd(_mm256_set1_pd(0.5), z)),
+		_mm256_mul_pd(_mm256_mul_pd(z, z), pc));
+
+	// quadrant q = k mod 4: (sin, cos) = (s, c), (c, -s), (-s, -c), (-c, s)
+	const __m256d q = _mm256_sub_pd(k, _mm256_mul_pd(_mm256_set1_pd(4.0),
+		_mm256_floor_pd(_mm256_mul_pd(k, _mm256_set1_pd(0.25)))));
+	const __m256d one = _mm256_set1_pd(1.0), two = _mm256_set1_pd(2.0), three = _mm256_set1_pd(3.0);
+	const __m256d swap = _mm256_or_pd(_mm256_cmp_pd(q, one, _CMP_EQ_OQ), _mm256_cmp_pd(q, three, _CMP_EQ_OQ));
+	const __m256d sin_negative = _mm256_cmp_pd(q, two, _CMP_GE_OQ);
+	const __m256d cos_negative = _mm256_or_pd(_mm256_cmp_pd(q, one, _CMP_EQ_OQ), _mm256_cmp_pd(q, two, _CMP_EQ_OQ));
+	const __m256d sign = _mm256_set1_pd(-0.0);
+
+	s = _mm256_xor_pd(_mm256_blendv_pd(sr, cr, swap), _mm256_and_pd(sin_negative, sign));
+	c = _mm256_xor_pd(_mm256_blendv_pd(cr, sr, swap), _mm256_and_pd(cos_negative, sign));
+}
+
+// arc tangent of y/x in the correct quadrant, like atan2: the ratio of the smaller to the
+// larger magnitude is reduced to [0, tan(pi/8)] and evaluated with the rational
+// approximation of Cephes; accurate to a few ulp. atan2(0, 0) is 0
+inline __m256d atan2_4(__m256d y, __m256d x) {
+	const __m256d sign = _mm256_set1_pd(-0.0);
+	const __m256d ax = _mm256_andnot_pd(sign, x), ay = _mm256_andnot_pd(sign, y);
+	const __m256d big = _mm256_max_pd(ax, ay), small = _mm256_min_pd(ax, ay);
+	const __m256d zero = _mm256_setzero_pd(), one = _mm256_set1_pd(1.0);
+
+	// t = small / big in [0, 1]
+	const __m256d nonzero = _mm256_cmp_pd(big, zero, _CMP_GT_OQ);
+	const __m256d t = _mm256_and_pd(_mm256_div_pd(small, _mm256_blendv_pd(one, big, nonzero)), nonzero);
+
+	// above tan(3pi/8) cannot occur; above 0.66: atan(t) = pi/4 + atan((t - 1) / (t + 1))
+	const __m256d upper = _mm256_cmp_pd(t, _mm256_set1_pd(0.66), _CMP_GT_OQ);
+	const __m256d r = _mm256_blendv_pd(t, _mm256_div_pd(_mm256_sub_pd(t, one), _mm256_add_pd(t, one)), upper);
+	const __m256d offset = _mm256_and_pd(upper, _mm256_set1_pd(0.78539816339744830962));
+	const __m256d more_bits = _mm256_and_pd(upper, _mm256_set1_pd(0.5 * 6.123233995736765886130e-17));
+
+	const __m256d z = _mm256_mul_pd(r, r);
+	__m256d p = _mm256_set1_pd(-8.750608600031904122785e-01);
+	p = _mm256_add_pd(_mm256_mul_pd(p, z), _mm256_set1_pd(-1.615753718733365076637e+01));
+	p = _mm256_add_pd(_mm256_mul_pd(p, z), _mm256_set1_pd(-7.500855792314704667340e+01));
+	p = _mm256_add_pd(_mm256_mul_pd(p, z), _mm256_set1_pd(-1.228866684490136173410e+02));
+	p = _mm256_add_pd(_mm256_mul_pd(p, z), _mm256_set1_pd(-6.485021904942025371773e+01));
+	__m256d q = _mm256_add_pd(z, _mm256_set1_pd(2.485846490142306297962e+01));
+	q = _mm256_add_pd(_mm256_mul_pd(q, z), _mm256_set1_pd(1.650270098316988542046e+02));
+	q = _mm256_add_pd(_mm256_mul_pd(q, z), _mm256_set1_pd(4.328810604912902668951e+02));
+	q = _mm256_add_pd(_mm256_mul_pd(q, z), _mm256_set1_pd(4.853903996359136964868e+02));
+	q = _mm256_add_pd(_mm256_mul_pd(q, z), _mm256_set1_pd(1.945506571482613964425e+02));
+
+	__m256d a = _mm256_add_pd(r, _mm256_mul_pd(_mm256_mul_pd(r, z), _mm256_div_pd(p, q)));
+	a = _mm256_add_pd(_mm256_add_pd(a, more_bits), offset);
+
+	// back to the full circle: swap of the roles of x and y, then the quadrant
+	const __m256d swapped = _mm256_cmp_pd(ay, ax, _CMP_GT_OQ);
+	a = _mm256_blendv_pd(a, _mm256_sub_pd(_mm256_set1_pd(1.57079632679489661923), a), swapped);
+	a = _mm256_blendv_pd(a, _mm256_sub_pd(_mm256_set1_pd(3.14159265358979323846), a), _mm256_cmp_pd(x, zero, _CMP_LT_OQ));
+	return _mm256_or_pd(a, _mm256_and_pd(y, sign));
+}
+#endif
@@ -1,38 +1,80 @@
 
 #include "SimilarityTransform2D.h"
+#include "Photo.h"
 
-SimilarityTransform2D::SimilarityTransform2D(vector<Point2D> &coords_from, vector<Point2D> &coords_to) {
-	setCoordinates(coords_from, coords_to);
+SimilarityTransform2D::SimilarityTransform2D(vector<Point2D> &coords_from, vector<Point2D> &coords_to,
+	const vector<double> &weights) {
+	setCoordinates(coords_from, coords_to, weights);
 }
 
-void SimilarityTransform2D::setCoordinates(vector<Point2D> &coords_from, vector<Point2D> &coords_to) {
+SimilarityTransform2D::SimilarityTransform2D(const PointCloud2D &coords_from, const PointCloud2D &coords_to,
+	const vector<double> &weights) {
+	setCoordinates(coords_from, coords_to, weights);
+}
+
+void SimilarityTransform2D::setCoordinates(vector<Point2D> &coords_from, vector<Point2D> &coords_to,
+	const vector<double> &weights) {
+	setCoordinates(PointCloud2D(coords_from), PointCloud2D(coords_to), weights);
+}
+
+void SimilarityTransform2D::setCoordinates(const PointCloud2D &coords_from, const PointCloud2D &coords_to,
+	const vector<double> &weights) {
 	this->coords_from = coords_from;
 	this->coords_to = coords_to;
+	this->weights = weights;
 
 	num_points = coords_to.size();
 
+	if (coords_from.size() != num_points) {
+		cout << "Error: SimilarityTransform2D - Number of from and to coordinates do not match" << endl;
+		exit(1);
+	}
+	if (!weights.empty() && weights.size() != 2 * num_points) {
+		cout << "Error: SimilarityTransform2D - Number of weights does not match the observations" << endl;
+		exit(1);
+	}
+
 	computeTransformation();
 }
 
 void SimilarityTransform2D::computeTransformation() {
-	similarityA();
-
-	Matrix observations(2 * num_points, 1);
-	for (unsigned int i = 0; i < num_points; i++) {
-		observations[2 * i][0] = coords_to[i].x;
-		observations[2 * i + 1][0] = coords_to[i].y;
+	const double *x = coords_from.x.data(), *y = coords_from.y.data();
+	const double *X = coords_to.x.data(), *Y = coords_to.y.data();
+
+	// reduced to the first point of each set, so the sums stay accurate for large coordinates
+	double origin[4] = { 0, 0, 0, 0 };
+	if (num_points > 0) {
+		origin[0] = x[0];
+		origin[1] = y[0];
+		origin[2] = X[0];
+		origin[3] = Y[0];
 	}
 
-	del = delta(A, -1 * observations);
-	v = residuals(A, del, -1 * observations);
+	double N[16], u[4], x_hat[4];
+	similarityNormals(x, y, X, Y, weights.empty() ? NULL : weights.data(), num_points, origin, N, u);
+
+	if (!choleskySolve<4>(N, u, x_hat)) {
+		cout << "Error: SimilarityTransform2D - The normal matrix is singular" << endl;
+		exit(1);
+	}
 
-	params.a = del.at(0, 0);
-	params.b = del.at(1, 0);
-	params.dx = del.at(2, 0);
-	params.dy = del.at(3, 0);
+	params.a = x_hat[0];
+	params.b = x_hat[1];
+	params.dx = x_hat[2] + origin[2] - params.a * origin[0] + params.b * origin[1];
+	params.dy = x_hat[3] + origin[3] - params.b * origin[0] - params.a * origin[1];
 
 	params.theta = atan2(params.b, params.a);
 	params.lambda = sqrt(pow(params.a, 2) + pow(params.b, 2));
+
+	del = Matrix(4, 1);
+	del[0][0] = params.a;
+	del[1][0] = params.b;
+	del[2][0] = params.dx;
+	del[3][0] = params.dy;
+
+	// formed by getA() and getResiduals() on request
+	A = Matrix();
+	v = Matrix();
 }
 
 void SimilarityTransform2D::similarityA() {
@@ -40,17 +82,19 @@ void SimilarityTransform2D::similarityA() {
 	A.clear();
 
 	for (unsigned int i = 0; i < num_points; i++) {
-		A[2 * i][0] = coords_from[i].x;
-		A[2 * i][1] = -coords_from[i].y;
+		A[2 * i][0] = coords_from.x[i];
+		A[2 * i][1] = -coords_from.y[i];
 		A[2 * i][2] = 1.0;
 
-		A[2 * i + 1][0] = coords_from[i].y;
-		A[2 * i + 1][1] = coords_from[i].x;
+		A[2 * i + 1][0] = coords_from.y[i];
+		A[2 * i + 1][1] = coords_from.x[i];
 		A[2 * i + 1][3] = 1.0;
 	}
 }
 
 Matrix SimilarityTransform2D::getA() {
+	if (A.getrows() == 0 && num_points > 0)
+		similarityA();
 	return A;
 }
 
@@ -59,15 +103,26 @@ Matrix SimilarityTransform2D::getDelta() {
 }
 
 Matrix SimilarityTransform2D::getResiduals() {
+	if (v.getrows() == 0 && num_points > 0) {
+		const double *x = coords_from.x.data(), *y = coords_from.y.data();
+		const double *X = coords_to.x.data(), *Y = coords_to.y.data();
+
+		// v = f(x_hat) - l
+		v = Matrix(2 * num_points, 1);
+		for (unsigned int i = 0; i < num_points; i++) {
+			v[2 * i][0] = params.a * x[i] - params.b * y[i] + params.dx - X[i];
+			v[2 * i + 1][0] = params.b * x[i] + params.a * y[i] + params.dy - Y[i];
+		}
+	}
 	return v;
 }
 
 vector<Point2D> SimilarityTransform2D::getFromCoords() {
-	return coords_from;
+	return coords_from.toPoints();
 }
 
 vector<Point2D> SimilarityTransform2D::getToCoords() {
-	return coords_from;
+	return coords_to.toPoints();
 }
 
 SimilarityParams SimilarityTransform2D::getParams() {
@@ -2,6 +2,7 @@
 
 #include "LeastSquares.h"
 #include "Point.h"
+#include "PointCloud.h"
 
 struct SimilarityParams {
 	double a, b;
@@ -17,8 +18,13 @@ public:
 	 * 
 	 * @param coords_from - the starting coordinates for the transformation
 	 * @param coords_to	  - the expected final coordinates after the transformation
+	 * @param weights	  - the 2n weights of the observations in the order x0, y0, x1, y1, ...
+	 *						(unit weights if empty)
 	 */
-	SimilarityTransform2D(vector<Point2D> &coords_from, vector<Point2D> &coords_to);
+	SimilarityTransform2D(vector<Point2D> &coords_from, vector<Point2D> &coords_to,
+		const vector<double> &weights = vector<double>());
+	SimilarityTransform2D(const PointCloud2D &coords_from, const PointCloud2D &coords_to,
+		const vector<double> &weights = vector<double>());
 
 	/** setCoordinates
 	 * sets the coordinates to their respective values and computes the 
@@ -26,8 +32,12 @@ public:
 	 * 
 	 * @param coords_from - the starting coordinates for the transformation
 	 * @param coords_to	  - the expected final coordinates after the transformation
+	 * @param weights	  - the 2n weights of the observations (unit weights if empty)
 	 */
-	void setCoordinates(vector<Point2D> &coords_from, vector<Point2D> &coords_to);
+	void setCoordinates(vector<Point2D> &coords_from, vector<Point2D> &coords_to,
+		const vector<double> &weights = vector<double>());
+	void setCoordinates(const PointCloud2D &coords_from, const PointCloud2D &coords_to,
+		const vector<double> &weights = vector<double>());
 
 	Matrix getA();
 	Matrix getDelta();
@@ -41,13 +51,16 @@ private:
 	Matrix A, del, v;
 
 	unsigned int num_points;
-	vector<Point2D> coords_from; // considered as KNOWNS in the LS adjustment
-	vector<Point2D> coords_to;	 // considered as OBSERVATIONS in the LS adjustment
+	PointCloud2D coords_from; // considered as KNOWNS in the LS adjustment
+	PointCloud2D coords_to;	  // considered as OBSERVATIONS in the LS adjustment
+	vector<double> weights;	  // diagonal of the weight matrix (empty for unit weights)
 
 	SimilarityParams params;
 
 	/** computeTransformation
-	 * Computes all parameters in a linear similarity transformation
+	 * Computes all parameters in a linear similarity transformation from normal equations
+	 * summed directly from the points (see similarityNormals); the design matrix and
+	 * residuals are only formed on request
 	 */
 	void computeTransformation();
 
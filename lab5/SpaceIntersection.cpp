@@ -0,0 +1,282 @@
+#include "SpaceIntersection.h"
+#include "Parallel.h"
+
+// symmetric 3-by-3 systems of a chunk of points, one array per element
+struct NormalsSoA {
+	vector<double> n00, n01, n02, n11, n12, n22;
+	vector<double> b0, b1, b2;
+
+	void assign(unsigned int n) {
+		n00.assign(n, 0.0); n01.assign(n, 0.0); n02.assign(n, 0.0);
+		n11.assign(n, 0.0); n12.assign(n, 0.0); n22.assign(n, 0.0);
+		b0.assign(n, 0.0); b1.assign(n, 0.0); b2.assign(n, 0.0);
+	}
+};
+
+// solves all systems of a chunk with the closed-form inverse; branch-free so the loop
+// vectorizes across points. Returns the inverses in place of the normals and the
+// solutions in place of the right hand sides, det receives the determinants
+static void solveNormals(NormalsSoA &N, vector<double> &det, unsigned int n) {
+	double *n00 = N.n00.data(), *n01 = N.n01.data(), *n02 = N.n02.data();
+	double *n11 = N.n11.data(), *n12 = N.n12.data(), *n22 = N.n22.data();
+	double *b0 = N.b0.data(), *b1 = N.b1.data(), *b2 = N.b2.data();
+	double *d = det.data();
+
+	for (unsigned int i = 0; i < n; i++) {
+		double c00 = n11[i] * n22[i] - n12[i] * n12[i];
+		double c01 = n02[i] * n12[i] - n01[i] * n22[i];
+		double c02 = n01[i] * n12[i] - n02[i] * n11[i];
+		double c11 = n00[i] * n22[i] - n02[i] * n02[i];
+		double c12 = n01[i] * n02[i] - n00[i] * n12[i];
+		double c22 = n00[i] * n11[i] - n01[i] * n01[i];
+
+		double D = n00[i] * c00 + n01[i] * c01 + n02[i] * c02;
+		double s = (D != 0.0) ? 1.0 / D : 0.0;
+
+		n00[i] = c00 * s; n01[i] = c01 * s; n02[i] = c02 * s;
+		n11[i] = c11 * s; n12[i] = c12 * s; n22[i] = c22 * s;
+
+		double x = n00[i] * b0[i] + n01[i] * b1[i] + n02[i] * b2[i];
+		double y = n01[i] * b0[i] + n11[i] * b1[i] + n12[i] * b2[i];
+		double z = n02[i] * b0[i] + n12[i] * b1[i] + n22[i] * b2[i];
+		b0[i] = x;
+		b1[i] = y;
+		b2[i] = z;
+		d[i] = D;
+	}
+}
+
+SpaceIntersection::SpaceIntersection(const vector<Camera> &cameras) : cameras(cameras) {}
+
+void SpaceIntersection::setOptions(const IntersectionOptions &options) {
+	this->options = options;
+}
+
+void SpaceIntersection::groupObservations(const vector<ImageObservation> &observations, unsigned int num_points) {
+	offsets.assign(num_points + 1, 0);
+	for (unsigned int k = 0; k < observations.size(); k++) {
+		if (observations[k].photo >= cameras.size() || observations[k].point >= num_points) {
+			cout << "Error: SpaceIntersection - Observation references an unknown photo or point" << endl;
+			exit(1);
+		}
+		offsets[observations[k].point + 1]++;
+	}
+	for (unsigned int i = 0; i < num_points; i++)
+		offsets[i + 1] += offsets[i];
+
+	obs_photo.resize(observations.size());
+	obs_x.resize(observations.size());
+	obs_y.resize(observations.size());
+
+	vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+	for (unsigned int k = 0; k < observations.size(); k++) {
+		unsigned int a = fill[observations[k].point]++;
+		obs_photo[a] = observations[k].photo;
+		obs_x[a] = observations[k].x;
+		obs_y[a] = observations[k].y;
+	}
+}
+
+void SpaceIntersection::computeIntersection(const vector<ImageObservation> &observations, unsigned int num_points) {
+	if (num_points == 0)
+		for (unsigned int k = 0; k < observations.size(); k++)
+			num_points = max(num_points, observations[k].point + 1);
+
+	groupObservations(observations, num_points);
+
+	X.assign(num_points, 0.0);
+	Y.assign(num_points, 0.0);
+	Z.assign(num_points, 0.0);
+	cov.assign(6 * num_points, 0.0);
+	sigma0.assign(num_points, 0.0);
+	valid.assign(num_points, 0);
+
+	parallelFor(num_points, [this](unsigned int begin, unsigned int end) {
+		intersectRays(begin, end);
+		refinePoints(begin, end);
+	}, options.num_threads);
+}
+
+void SpaceIntersection::intersectRays(unsigned int begin, unsigned int end) {
+	unsigned int n = end - begin;
+
+	NormalsSoA N;
+	N.assign(n);
+	vector<double> det(n);
+
+	// sum of (I - d * d_trans) over the unit ray directions d = M_trans * {x, y, -c}
+	for (unsigned int i = 0; i < n; i++) {
+		for (unsigned int a = offsets[begin + i]; a < offsets[begin + i + 1]; a++) {
+			const Camera &cam = cameras[obs_photo[a]];
+			const double *m = cam.m;
+
+			double px = obs_x[a], py = obs_y[a], pz = -cam.c;
+			double dx = m[0] * px + m[3] * py + m[6] * pz;
+			double dy = m[1] * px + m[4] * py + m[7] * pz;
+			double dz = m[2] * px + m[5] * py + m[8] * pz;
+			double s = 1.0 / sqrt(dx * dx + dy * dy + dz * dz);
+			dx *= s;
+			dy *= s;
+			dz *= s;
+
+			double p00 = 1.0 - dx * dx, p01 = -dx * dy, p02 = -dx * dz;
+			double p11 = 1.0 - dy * dy, p12 = -dy * dz, p22 = 1.0 - dz * dz;
+
+			N.n00[i] += p00; N.n01[i] += p01; N.n02[i] += p02;
+			N.n11[i] += p11; N.n12[i] += p12; N.n22[i] += p22;
+
+			N.b0[i] += p00 * cam.T[0] + p01 * cam.T[1] + p02 * cam.T[2];
+			N.b1[i] += p01 * cam.T[0] + p11 * cam.T[1] + p12 * cam.T[2];
+			N.b2[i] += p02 * cam.T[0] + p12 * cam.T[1] + p22 * cam.T[2];
+		}
+	}
+
+	solveNormals(N, det, n);
+
+	for (unsigned int i = 0; i < n; i++) {
+		unsigned int rays = offsets[begin + i + 1] - offsets[begin + i];
+
+		// with two rays the determinant is 2 * sin^2 of their angle, so this rejects
+		// intersection angles below about 0.04 deg
+		valid[begin + i] = (rays >= 2 && det[i] > 1.0E-6) ? 1 : 0;
+		X[begin + i] = N.b0[i];
+		Y[begin + i] = N.b1[i];
+		Z[begin + i] = N.b2[i];
+	}
+}
+
+void SpaceIntersection::refinePoints(unsigned int begin, unsigned int end) {
+	unsigned int n = end - begin;
+
+	NormalsSoA N;
+	vector<double> det(n), vtv(n);
+
+	for (unsigned int it = 0; it <= options.iterations; it++) {
+		N.assign(n);
+		vtv.assign(n, 0.0);
+
+		// normal equations of the collinearity equations wrt. the object point
+		for (unsigned int i = 0; i < n; i++) {
+			unsigned int p = begin + i;
+			if (!valid[p])
+				continue;
+
+			for (unsigned int a = offsets[p]; a < offsets[p + 1]; a++) {
+				const Camera &cam = cameras[obs_photo[a]];
+				const double *m = cam.m;
+
+				double dX = X[p] - cam.T[0];
+				double dY = Y[p] - cam.T[1];
+				double dZ = Z[p] - cam.T[2];
+
+				double U = m[0] * dX + m[1] * dY + m[2] * dZ;
+				double V = m[3] * dX + m[4] * dY + m[5] * dZ;
+				double W = m[6] * dX + m[7] * dY + m[8] * dZ;
+
+				double f = -cam.c / W;
+				double rx = obs_x[a] - f * U;
+				double ry = obs_y[a] - f * V;
+
+				// dx/dX_j = -c * (m1j * W - U * m3j) / W^2, likewise for y
+				double gx = f / W;
+				double bx0 = gx * (m[0] * W - U * m[6]);
+				double bx1 = gx * (m[1] * W - U * m[7]);
+				double bx2 = gx * (m[2] * W - U * m[8]);
+				double by0 = gx * (m[3] * W - V * m[6]);
+				double by1 = gx * (m[4] * W - V * m[7]);
+				double by2 = gx * (m[5] * W - V * m[8]);
+
+				N.n00[i] += bx0 * bx0 + by0 * by0;
+				N.n01[i] += bx0 * bx1 + by0 * by1;
+				N.n02[i] += bx0 * bx2 + by0 * by2;
+				N.n11[i] += bx1 * bx1 + by1 * by1;
+				N.n12[i] += bx1 * bx2 + by1 * by2;
+				N.n22[i] += bx2 * bx2 + by2 * by2;
+
+				N.b0[i] += bx0 * rx + by0 * ry;
+				N.b1[i] += bx1 * rx + by1 * ry;
+				N.b2[i] += bx2 * rx + by2 * ry;
+
+				vtv[i] += rx * rx + ry * ry;
+			}
+		}
+
+		solveNormals(N, det, n);
+
+		if (it == options.iterations)
+			break;
+
+		for (unsigned int i = 0; i < n; i++) {
+			unsigned int p = begin + i;
+			if (!valid[p])
+				continue;
+			X[p] += N.b0[i];
+			Y[p] += N.b1[i];
+			Z[p] += N.b2[i];
+		}
+	}
+
+	// covariance = sigma0^2 * N^-1 at the final point
+	for (unsigned int i = 0; i < n; i++) {
+		unsigned int p = begin + i;
+		if (!valid[p])
+			continue;
+
+		double dof = 2.0 * (offsets[p + 1] - offsets[p]) - 3.0;
+		double s2 = (options.sigma > 0.0) ? options.sigma * options.sigma : vtv[i] / dof;
+
+		sigma0[p] = sqrt(vtv[i] / dof);
+		cov[6 * p] = s2 * N.n00[i];
+		cov[6 * p + 1] = s2 * N.n01[i];
+		cov[6 * p + 2] = s2 * N.n02[i];
+		cov[6 * p + 3] = s2 * N.n11[i];
+		cov[6 * p + 4] = s2 * N.n12[i];
+		cov[6 * p + 5] = s2 * N.n22[i];
+	}
+}
+
+unsigned int SpaceIntersection::getNumPoints() {
+	return X.size();
+}
+
+bool SpaceIntersection::isValid(unsigned int point) {
+	return valid[point] != 0;
+}
+
+Point3D SpaceIntersection::getPoint(unsigned int point) {
+	return Point3D(X[point], Y[point], Z[point]);
+}
+
+vector<Point3D> SpaceIntersection::getPoints() {
+	vector<Point3D> points;
+	points.reserve(X.size());
+	for (unsigned int i = 0; i < X.size(); i++)
+		points.push_back(Point3D(X[i], Y[i], Z[i]));
+	return points;
+}
+
+Matrix SpaceIntersection::getCovariance(unsigned int point) {
+	const double *q = &cov[6 * point];
+
+	Matrix C(3, 3);
+	C[0][0] = q[0]; C[0][1] = q[1]; C[0][2] = q[2];
+	C[1][0] = q[1]; C[1][1] = q[3]; C[1][2] = q[4];
+	C[2][0] = q[2]; C[2][1] = q[4]; C[2][2] = q[5];
+	return C;
+}
+
+double SpaceIntersection::getSigma0(unsigned int point) {
+	return sigma0[point];
+}
+
+const vector<double> &SpaceIntersection::getX() {
+	return X;
+}
+
+const vector<double> &SpaceIntersection::getY() {
+	return Y;
+}
+
+const vector<double> &SpaceIntersection::getZ() {
+	return Z;
+}
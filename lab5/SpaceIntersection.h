@@ -0,0 +1,91 @@
+/*
+ * The purpose of this header is to provide a batch space intersection (forward
+ * intersection) of object points from any number of oriented photos. The points are
+ * processed in chunks on all hardware threads, and all per-point data is kept in
+ * separate arrays (structure of arrays) so the per-point kernels can be vectorized.
+ */
+
+#pragma once
+
+#include "Camera.h"
+#include "Matrix.h"
+#include "Point.h"
+
+struct IntersectionOptions {
+	unsigned int iterations;  // Gauss-Newton iterations on the collinearity equations
+	unsigned int num_threads; // 0: one thread per hardware thread
+	double sigma;			  // a-priori std. dev. of the image coordinates (0: use the a-posteriori variance factor)
+
+	IntersectionOptions() : iterations(2), num_threads(0), sigma(0) {}
+};
+
+class SpaceIntersection {
+public:
+	/** SpaceIntersection
+	 * the constructor of this class
+	 *
+	 * @param cameras - the oriented photos, indexed by ImageObservation::photo
+	 */
+	SpaceIntersection(const vector<Camera> &cameras);
+
+	void setOptions(const IntersectionOptions &options);
+
+	/** computeIntersection
+	 * intersects the rays of all observations of each object point. The least-squares
+	 * point closest to all rays serves as the point of expansion for a few Gauss-Newton
+	 * iterations on the collinearity equations, which also yield the covariance matrix
+	 * of each point. Points observed in fewer than two photos, or with (nearly) parallel
+	 * rays, are flagged as invalid
+	 *
+	 * @param observations - the image observations of all points, in any order
+	 * @param num_points   - the number of object points (0: largest point index + 1)
+	 */
+	void computeIntersection(const vector<ImageObservation> &observations, unsigned int num_points = 0);
+
+	unsigned int getNumPoints();
+	bool isValid(unsigned int point);
+
+	Point3D getPoint(unsigned int point);
+	vector<Point3D> getPoints();
+
+	/** getCovariance
+	 * returns the 3-by-3 covariance matrix of an intersected point
+	 */
+	Matrix getCovariance(unsigned int point);
+
+	double getSigma0(unsigned int point); // a-posteriori std. dev. of unit weight of a point
+
+	// object coordinates as separate arrays
+	const vector<double> &getX();
+	const vector<double> &getY();
+	const vector<double> &getZ();
+private:
+	vector<Camera> cameras;
+	IntersectionOptions options;
+
+	// observations grouped by point (CSR)
+	vector<unsigned int> offsets;
+	vector<unsigned int> obs_photo;
+	vector<double> obs_x, obs_y;
+
+	// results
+	vector<double> X, Y, Z;
+	vector<double> cov; // upper triangle {xx, xy, xz, yy, yz, zz} of each point
+	vector<double> sigma0;
+	vector<unsigned char> valid;
+
+	/** groupObservations
+	 * sorts the observations by point with a counting sort
+	 */
+	void groupObservations(const vector<ImageObservation> &observations, unsigned int num_points);
+
+	/** intersectRays
+	 * the linear least-squares intersection of the points [begin, end)
+	 */
+	void intersectRays(unsigned int begin, unsigned int end);
+
+	/** refinePoints
+	 * the Gauss-Newton iterations and precision estimates of the points [begin, end)
+	 */
+	void refinePoints(unsigned int begin, unsigned int end);
+};
@@ -0,0 +1,259 @@
+#include <algorithm>
+#include <set>
+#include "SparseCholesky.h"
+
+vector<unsigned int> minimumDegreeOrdering(const SparseMatrix &A, unsigned int block_size) {
+	unsigned int n = A.size();
+	if (block_size == 0)
+		block_size = 1;
+	unsigned int nb = (n + block_size - 1) / block_size;
+
+	const vector<unsigned int> &col_ptr = A.colPointers();
+	const vector<unsigned int> &row_idx = A.rowIndices();
+
+	// adjacency of the (block) elimination graph as sorted vectors
+	vector<vector<unsigned int> > adj(nb);
+	for (unsigned int j = 0; j < n; j++)
+		for (unsigned int p = col_ptr[j]; p < col_ptr[j + 1]; p++) {
+			unsigned int bi = row_idx[p] / block_size;
+			unsigned int bj = j / block_size;
+			if (bi != bj) {
+				adj[bi].push_back(bj);
+				adj[bj].push_back(bi);
+			}
+		}
+
+	std::set<std::pair<unsigned int, unsigned int> > degree; // (degree, node)
+	for (unsigned int b = 0; b < nb; b++) {
+		std::sort(adj[b].begin(), adj[b].end());
+		adj[b].erase(std::unique(adj[b].begin(), adj[b].end()), adj[b].end());
+		degree.insert(std::make_pair((unsigned int)adj[b].size(), b));
+	}
+
+	vector<unsigned int> block_perm;
+	vector<unsigned int> merged;
+
+	while (!degree.empty()) {
+		unsigned int p = degree.begin()->second;
+		degree.erase(degree.begin());
+		block_perm.push_back(p);
+
+		// eliminating p connects all of its neighbours into a clique
+		const vector<unsigned int> &np = adj[p];
+		for (unsigned int a = 0; a < np.size(); a++) {
+			unsigned int u = np[a];
+			degree.erase(std::make_pair((unsigned int)adj[u].size(), u));
+
+			merged.clear();
+			std::set_union(adj[u].begin(), adj[u].end(), np.begin(), np.end(), std::back_inserter(merged));
+			adj[u].clear();
+			for (unsigned int b = 0; b < merged.size(); b++)
+				if (merged[b] != u && merged[b] != p)
+					adj[u].push_back(merged[b]);
+
+			degree.insert(std::make_pair((unsigned int)adj[u].size(), u));
+		}
+
+		// p is gone from the graph
+		for (unsigned int a = 0; a < np.size(); a++) {
+			vector<unsigned int> &nu = adj[np[a]];
+			vector<unsigned int>::iterator it = std::lower_bound(nu.begin(), nu.end(), p);
+			if (it != nu.end() && *it == p)
+				nu.erase(it);
+		}
+		adj[p].clear();
+	}
+
+	vector<unsigned int> perm;
+	perm.reserve(n);
+	for (unsigned int k = 0; k < nb; k++)
+		for (unsigned int i = block_perm[k] * block_size; i < n && i < (block_perm[k] + 1) * block_size; i++)
+			perm.push_back(i);
+
+	return perm;
+}
+
+SparseCholesky::SparseCholesky(unsigned int block_size) : n(0), block_size(block_size), factored(false) {}
+
+bool SparseCholesky::samePattern(const SparseMatrix &A) const {
+	return A.size() == n && A.colPointers() == A_col_ptr && A.rowIndices() == A_row_idx;
+}
+
+void SparseCholesky::analyze(const SparseMatrix &A, unsigned int block_size) {
+	n = A.size();
+	this->block_size = block_size;
+	factored = false;
+
+	A_col_ptr = A.colPointers();
+	A_row_idx = A.rowIndices();
+
+	perm = minimumDegreeOrdering(A, block_size);
+	pinv.resize(n);
+	for (unsigned int k = 0; k < n; k++)
+		pinv[perm[k]] = k;
+
+	// C = P * A * P_trans stored as an upper triangle: column max(pi, pj), row min(pi, pj)
+	unsigned int nnz = A_row_idx.size();
+	C_col_ptr.assign(n + 1, 0);
+	for (unsigned int j = 0; j < n; j++)
+		for (unsigned int p = A_col_ptr[j]; p < A_col_ptr[j + 1]; p++)
+			C_col_ptr[std::max(pinv[A_row_idx[p]], pinv[j]) + 1]++;
+	for (unsigned int k = 0; k < n; k++)
+		C_col_ptr[k + 1] += C_col_ptr[k];
+
+	C_row_idx.resize(nnz);
+	C_map.resize(nnz);
+	C_vals.assign(nnz, 0.0);
+	vector<unsigned int> fill(C_col_ptr.begin(), C_col_ptr.end() - 1);
+	for (unsigned int j = 0; j < n; j++)
+		for (unsigned int p = A_col_ptr[j]; p < A_col_ptr[j + 1]; p++) {
+			unsigned int pi = pinv[A_row_idx[p]];
+			unsigned int pj = pinv[j];
+			unsigned int q = fill[std::max(pi, pj)]++;
+			C_row_idx[q] = std::min(pi, pj);
+			C_map[p] = q;
+		}
+
+	// elimination tree of C (Liu's algorithm with path compression)
+	parent.assign(n, -1);
+	vector<int> ancestor(n, -1);
+	for (unsigned int k = 0; k < n; k++)
+		for (unsigned int p = C_col_ptr[k]; p < C_col_ptr[k + 1]; p++) {
+			int i = C_row_idx[p];
+			while (i != -1 && i < (int)k) {
+				int next = ancestor[i];
+				ancestor[i] = k;
+				if (next == -1)
+					parent[i] = k;
+				i = next;
+			}
+		}
+
+	// column counts of L from the row patterns
+	vector<unsigned int> counts(n, 1), s(n), mark(n, n);
+	for (unsigned int k = 0; k < n; k++) {
+		unsigned int top = ereach(k, s, mark);
+		for (unsigned int t = top; t < n; t++)
+			counts[s[t]]++;
+	}
+
+	L_col_ptr.assign(n + 1, 0);
+	for (unsigned int k = 0; k < n; k++)
+		L_col_ptr[k + 1] = L_col_ptr[k] + counts[k];
+
+	L_row_idx.resize(L_col_ptr[n]);
+	L_vals.resize(L_col_ptr[n]);
+}
+
+unsigned int SparseCholesky::ereach(unsigned int k, vector<unsigned int> &s, vector<unsigned int> &mark) const {
+	unsigned int top = n;
+	mark[k] = k;
+
+	for (unsigned int p = C_col_ptr[k]; p < C_col_ptr[k + 1]; p++) {
+		unsigned int i = C_row_idx[p];
+		if (i > k)
+			continue;
+
+		// walk up the elimination tree until a marked node is found
+		unsigned int len = 0;
+		for (; mark[i] != k; i = parent[i]) {
+			s[len++] = i;
+			mark[i] = k;
+		}
+		while (len > 0)
+			s[--top] = s[--len];
+	}
+
+	return top;
+}
+
+bool SparseCholesky::factorize(const SparseMatrix &A) {
+	if (!samePattern(A))
+		analyze(A, block_size);
+
+	factored = false;
+
+	const vector<double> &A_vals = A.values();
+	for (unsigned int p = 0; p < A_vals.size(); p++)
+		C_vals[C_map[p]] = A_vals[p];
+
+	vector<double> x(n, 0.0);
+	vector<unsigned int> c(L_col_ptr.begin(), L_col_ptr.end() - 1);
+	vector<unsigned int> s(n), mark(n, n);
+
+	// up-looking Cholesky: row k of L from a sparse triangular solve
+	for (unsigned int k = 0; k < n; k++) {
+		unsigned int top = ereach(k, s, mark);
+
+		x[k] = 0.0;
+		for (unsigned int p = C_col_ptr[k]; p < C_col_ptr[k + 1]; p++)
+			x[C_row_idx[p]] += C_vals[p];
+
+		double d = x[k];
+		x[k] = 0.0;
+
+		for (; top < n; top++) {
+			unsigned int i = s[top];
+			double lki = x[i] / L_vals[L_col_ptr[i]];
+			x[i] = 0.0;
+
+			for (unsigned int p = L_col_ptr[i] + 1; p < c[i]; p++)
+				x[L_row_idx[p]] -= L_vals[p] * lki;
+
+			d -= lki * lki;
+
+			unsigned int p = c[i]++;
+			L_row_idx[p] = k;
+			L_vals[p] = lki;
+		}
+
+		if (!(d > 0.0) || !std::isfinite(d))
+			return false;
+
+		unsigned int p = c[k]++;
+		L_row_idx[p] = k;
+		L_vals[p] = sqrt(d);
+	}
+
+	factored = true;
+	return true;
+}
+
+vector<double> SparseCholesky::solve(const vector<double> &b) const {
+	if (!factored || b.size() != n) {
+		cout << "Error: SparseCholesky::solve No decomposition of a conformal matrix" << endl;
+		exit(1);
+	}
+
+	vector<double> y(n);
+	for (unsigned int k = 0; k < n; k++)
+		y[k] = b[perm[k]];
+
+	// L * z = P * b
+	for (unsigned int j = 0; j < n; j++) {
+		y[j] /= L_vals[L_col_ptr[j]];
+		for (unsigned int p = L_col_ptr[j] + 1; p < L_col_ptr[j + 1]; p++)
+			y[L_row_idx[p]] -= L_vals[p] * y[j];
+	}
+
+	// L_trans * w = z
+	for (unsigned int j = n; j-- > 0;) {
+		for (unsigned int p = L_col_ptr[j] + 1; p < L_col_ptr[j + 1]; p++)
+			y[j] -= L_vals[p] * y[L_row_idx[p]];
+		y[j] /= L_vals[L_col_ptr[j]];
+	}
+
+	vector<double> x(n);
+	for (unsigned int k = 0; k < n; k++)
+		x[perm[k]] = y[k];
+
+	return x;
+}
+
+unsigned int SparseCholesky::nonZerosL() const {
+	return L_col_ptr.empty() ? 0 : L_col_ptr[n];
+}
+
+const vector<unsigned int> &SparseCholesky::permutation() const {
+	return perm;
+}
@@ -0,0 +1,88 @@
+/*
+ * The purpose of this header is to provide a sparse alternative to the dense
+ * Cholesky decomposition in Matrix::inv() for banded and block-sparse normal
+ * matrices. The decomposition is split into a symbolic analysis (fill-reducing
+ * ordering, elimination tree and the pattern of L), which only depends on the
+ * sparsity pattern and is reused over the iterations of an adjustment, and a
+ * numeric factorization.
+ */
+
+#pragma once
+
+#include "SparseMatrix.h"
+
+/** minimumDegreeOrdering
+ * computes a fill-reducing ordering of a symmetric matrix with the minimum degree
+ * heuristic on its elimination graph. With a block size > 1 the graph of the blocks
+ * (e.g. the 6 parameters of a photo) is ordered and the blocks are kept together
+ *
+ * @param A			 - the symmetric matrix (only the pattern is used)
+ * @param block_size - the number of consecutive unknowns forming a node of the graph
+ *
+ * @return			 - the permutation: perm[k] is the unknown eliminated k-th
+ */
+vector<unsigned int> minimumDegreeOrdering(const SparseMatrix &A, unsigned int block_size = 1);
+
+class SparseCholesky {
+public:
+	/** SparseCholesky
+	 * @param block_size - the block size used by the ordering when factorize() analyzes a new pattern
+	 */
+	SparseCholesky(unsigned int block_size = 1);
+
+	/** analyze
+	 * computes the fill-reducing ordering, the elimination tree and the pattern of L
+	 *
+	 * @param A			 - the symmetric positive definite matrix (only the pattern is used)
+	 * @param block_size - the block size passed to minimumDegreeOrdering
+	 */
+	void analyze(const SparseMatrix &A, unsigned int block_size = 1);
+
+	/** factorize
+	 * computes the numeric decomposition P * A * P_trans = L * L_trans with an up-looking
+	 * sparse Cholesky; the symbolic analysis is reused if A has the same pattern as the
+	 * previously analyzed matrix and repeated otherwise
+	 *
+	 * @param A - the symmetric positive definite matrix
+	 *
+	 * @return  - false if a pivot is not positive, in which case solve() cannot be called
+	 *			  until a later factorization succeeds
+	 */
+	bool factorize(const SparseMatrix &A);
+
+	/** solve
+	 * solves A * x = b with the current decomposition
+	 */
+	vector<double> solve(const vector<double> &b) const;
+
+	unsigned int nonZerosL() const;
+	const vector<unsigned int> &permutation() const;
+private:
+	unsigned int n;
+	unsigned int block_size;
+
+	// pattern of the analyzed matrix, to detect when the analysis can be reused
+	vector<unsigned int> A_col_ptr, A_row_idx;
+
+	vector<unsigned int> perm, pinv;
+	vector<int> parent; // elimination tree of P * A * P_trans
+
+	// P * A * P_trans as an upper triangle in CSC, and where each entry of A goes
+	vector<unsigned int> C_col_ptr, C_row_idx, C_map;
+	vector<double> C_vals;
+
+	// L in CSC with the diagonal first in each column
+	vector<unsigned int> L_col_ptr, L_row_idx;
+	vector<double> L_vals;
+
+	bool factored;
+
+	/** ereach
+	 * computes the pattern of row k of L (in topological order) in s[top..n-1]
+	 *
+	 * @return - top
+	 */
+	unsigned int ereach(unsigned int k, vector<unsigned int> &s, vector<unsigned int> &mark) const;
+
+	bool samePattern(const SparseMatrix &A) const;
+};
@@ -0,0 +1,131 @@
+#include <algorithm>
+#include "SparseMatrix.h"
+
+SparseMatrix::SparseMatrix() : n(0), col_ptr(1, 0) {}
+
+SparseMatrix::SparseMatrix(unsigned int n) : n(n), col_ptr(n + 1, 0) {}
+
+SparseMatrix::SparseMatrix(unsigned int n, const vector<unsigned int> &col_ptr, const vector<unsigned int> &row_idx,
+	const vector<double> &values) : n(n), col_ptr(col_ptr), row_idx(row_idx), vals(values) {
+
+	if (col_ptr.size() != n + 1 || row_idx.size() != col_ptr[n] || values.size() != col_ptr[n]) {
+		cout << "Error: SparseMatrix - Inconsistent CSC arrays" << endl;
+		exit(1);
+	}
+}
+
+SparseMatrix::SparseMatrix(const Matrix &N) : n(N.getrows()), col_ptr(1, 0) {
+	if (N.getrows() != N.getcols()) {
+		cout << "Error: SparseMatrix - Non-square matrix" << endl;
+		exit(1);
+	}
+
+	for (unsigned int j = 0; j < n; j++) {
+		for (unsigned int i = j; i < n; i++) {
+			double a = N.at(i, j);
+			if (a != 0.0 || i == j) {
+				row_idx.push_back(i);
+				vals.push_back(a);
+			}
+		}
+		col_ptr.push_back(row_idx.size());
+	}
+}
+
+void SparseMatrix::add(unsigned int row, unsigned int col, double value) {
+	if (row >= n || col >= n) {
+		cout << "Error: SparseMatrix::add Index requested exceeds matrix dimensions" << endl;
+		exit(1);
+	}
+
+	Triplet t;
+	t.row = (row >= col) ? row : col;
+	t.col = (row >= col) ? col : row;
+	t.value = value;
+	triplets.push_back(t);
+}
+
+void SparseMatrix::compress() {
+	// merge the existing entries with the new triplets
+	for (unsigned int j = 0; j < n; j++)
+		for (unsigned int p = col_ptr[j]; p < col_ptr[j + 1]; p++) {
+			Triplet t;
+			t.row = row_idx[p];
+			t.col = j;
+			t.value = vals[p];
+			triplets.push_back(t);
+		}
+
+	std::sort(triplets.begin(), triplets.end(), [](const Triplet &a, const Triplet &b) {
+		return (a.col != b.col) ? a.col < b.col : a.row < b.row;
+	});
+
+	col_ptr.assign(n + 1, 0);
+	row_idx.clear();
+	vals.clear();
+
+	for (unsigned int k = 0; k < triplets.size(); k++) {
+		const Triplet &t = triplets[k];
+		if (k > 0 && triplets[k - 1].col == t.col && triplets[k - 1].row == t.row) {
+			vals.back() += t.value;
+			continue;
+		}
+		row_idx.push_back(t.row);
+		vals.push_back(t.value);
+		col_ptr[t.col + 1]++;
+	}
+
+	for (unsigned int j = 0; j < n; j++)
+		col_ptr[j + 1] += col_ptr[j];
+
+	triplets.clear();
+}
+
+unsigned int SparseMatrix::size() const {
+	return n;
+}
+
+unsigned int SparseMatrix::nonZeros() const {
+	return row_idx.size();
+}
+
+double SparseMatrix::at(unsigned int row, unsigned int col) const {
+	if (row < col)
+		std::swap(row, col);
+
+	const unsigned int *begin = row_idx.data() + col_ptr[col];
+	const unsigned int *end = row_idx.data() + col_ptr[col + 1];
+	const unsigned int *it = std::lower_bound(begin, end, row);
+
+	if (it != end && *it == row)
+		return vals[it - row_idx.data()];
+	return 0.0;
+}
+
+void SparseMatrix::apply(const vector<double> &x, vector<double> &y) const {
+	y.assign(n, 0.0);
+
+	for (unsigned int j = 0; j < n; j++) {
+		double xj = x[j];
+		double yj = 0.0;
+		for (unsigned int p = col_ptr[j]; p < col_ptr[j + 1]; p++) {
+			unsigned int i = row_idx[p];
+			y[i] += vals[p] * xj;
+			if (i != j)
+				yj += vals[p] * x[i];
+		}
+		y[j] += yj;
+	}
+}
+
+const vector<unsigned int> &SparseMatrix::colPointers() const {
+	return col_ptr;
+}
+
+const vector<unsigned int> &SparseMatrix::rowIndices() const {
+	return row_idx;
+}
+
+const vector<double> &SparseMatrix::values() const {
+	return vals;
+}
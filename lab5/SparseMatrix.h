@@ -0,0 +1,67 @@
+#pragma once
+
+#include "Matrix.h"
+#include "ConjugateGradient.h"
+
+class SparseMatrix : public LinearOperator {
+public:
+	/** SparseMatrix
+	 * a symmetric sparse matrix in compressed sparse column (CSC) form; only the
+	 * lower triangle (row >= col) is stored
+	 *
+	 * Column j holds the entries [col_ptr[j], col_ptr[j + 1]) with row indices in
+	 * ascending order
+	 */
+	SparseMatrix();
+	SparseMatrix(unsigned int n);
+
+	/** SparseMatrix
+	 * constructs the matrix directly from its CSC arrays (lower triangle, rows sorted)
+	 */
+	SparseMatrix(unsigned int n, const vector<unsigned int> &col_ptr, const vector<unsigned int> &row_idx,
+		const vector<double> &values);
+
+	/** SparseMatrix
+	 * converts the lower triangle of a dense symmetric matrix, dropping the zeros
+	 */
+	SparseMatrix(const Matrix &N);
+
+	/** add
+	 * adds a value to the entry (row, col) in triplet form; the entry is mirrored into
+	 * the lower triangle and duplicates are summed by compress()
+	 */
+	void add(unsigned int row, unsigned int col, double value);
+
+	/** compress
+	 * converts all added triplets into the CSC arrays
+	 */
+	void compress();
+
+	unsigned int size() const;
+	unsigned int nonZeros() const;
+
+	/** at
+	 * returns the entry (row, col) of the symmetric matrix (zero if not stored)
+	 */
+	double at(unsigned int row, unsigned int col) const;
+
+	/** apply
+	 * y = N * x using the symmetry of the stored lower triangle
+	 */
+	void apply(const vector<double> &x, vector<double> &y) const;
+
+	const vector<unsigned int> &colPointers() const;
+	const vector<unsigned int> &rowIndices() const;
+	const vector<double> &values() const;
+private:
+	unsigned int n;
+	vector<unsigned int> col_ptr;
+	vector<unsigned int> row_idx;
+	vector<double> vals;
+
+	struct Triplet {
+		unsigned int row, col;
+		double value;
+	};
+	vector<Triplet> triplets;
+};
@@ -0,0 +1,275 @@
+#include <atomic>
+#include <limits>
+
+#include "StripOrientation.h"
+#include "Parallel.h"
+
+StripOrientation::StripOrientation(const vector<PointCloud2D> &photos, double c) {
+	if (photos.size() < 2) {
+		cout << "Error: StripOrientation - A strip needs at least two photos" << endl;
+		exit(1);
+	}
+
+	this->photos = photos;
+	this->c = c;
+	this->parameterization = RotationParameterization::Angles;
+	this->lambda = 1;
+}
+
+void StripOrientation::setSolverOptions(const SolverOptions &options) {
+	this->options = options;
+}
+
+void StripOrientation::setParameterization(RotationParameterization parameterization) {
+	this->parameterization = parameterization;
+}
+
+void StripOrientation::computeModels(const Point3D &_B, const Angles &_ang, unsigned int num_threads) {
+	unsigned int pairs = photos.size() - 1;
+
+	reports.assign(pairs, SolverReport());
+	bases.assign(pairs, Point3D());
+	rotations.assign(pairs, RotationMatrix());
+	models.assign(pairs, PointCloud3D());
+
+	scales.clear();
+	centres.clear();
+	attitudes.clear();
+
+	if (num_threads == 0)
+		num_threads = std::max(1u, std::thread::hardware_concurrency());
+
+	// the pairs differ in size and convergence, so every thread takes the next pair left
+	// rather than a fixed share of them
+	std::atomic<unsigned int> next(0);
+	vector<unsigned int> common(pairs, 0);
+
+	parallelFor(std::min(num_threads, pairs), [&](unsigned int begin, unsigned int end) {
+		for (unsigned int worker = begin; worker < end; worker++) {
+			for (unsigned int k = next++; k < pairs; k = next++) {
+				PointCloud2D left, right;
+				alignPoints(photos[k], photos[k + 1], left, right);
+
+				common[k] = left.size();
+				if (common[k] < 5)
+					continue;
+
+				RelativeOrientation ro(left, right, c);
+				ro.setSolverOptions(options);
+				ro.setParameterization(parameterization);
+				ro.computeOrientation(_B, _ang);
+
+				reports[k] = ro.getReport();
+				bases[k] = ro.getB();
+				rotations[k] = ro.getM();
+
+				// the model points come in the order of the aligned left photo
+				vector<Point3D> model = ro.getModelCoords();
+				PointCloud3D &cloud = models[k];
+				cloud = PointCloud3D(left.table);
+				cloud.id = left.id;
+				cloud.x.resize(model.size());
+				cloud.y.resize(model.size());
+				cloud.z.resize(model.size());
+				for (unsigned int i = 0; i < model.size(); i++) {
+					cloud.x[i] = model[i].x;
+					cloud.y[i] = model[i].y;
+					cloud.z[i] = model[i].z;
+				}
+			}
+		}
+	}, num_threads, 1);
+
+	for (unsigned int k = 0; k < pairs; k++) {
+		if (common[k] < 5) {
+			cout << "Error: StripOrientation::computeModels - Photos " << k << " and " << k + 1 << " share "
+				<< common[k] << " points, at least 5 are needed" << endl;
+			exit(1);
+		}
+
+		// a model that did not converge would carry its error into every model chained after it
+		if (reports[k].reason != ConvergenceReason::Converged) {
+			cout << "Error: StripOrientation::computeModels - The relative orientation of photos " << k << " and "
+				<< k + 1 << " failed: " << convergenceReason(reports[k].reason) << endl;
+			exit(1);
+		}
+	}
+}
+
+void StripOrientation::chainModels(unsigned int num_threads) {
+	unsigned int pairs = models.size();
+	if (pairs == 0) {
+		cout << "Error: StripOrientation::chainModels - The models have not been computed" << endl;
+		exit(1);
+	}
+
+	/*
+	 * Model k + 1 has the right photo of model k as its datum, so a common point is seen
+	 * from that photo at pm - B_k in model k and at pm' in model k + 1; the ratio of the
+	 * summed distances carries the scale over
+	 */
+	vector<double> ratios(pairs - 1);
+	parallelFor(pairs - 1, [&](unsigned int begin, unsigned int end) {
+		for (unsigned int k = begin; k < end; k++) {
+			const PointCloud3D &a = models[k], &b = models[k + 1];
+			Correspondence common = joinPoints(a, b);
+
+			double sum_a = 0, sum_b = 0;
+			for (unsigned int j = 0; j < common.size(); j++) {
+				unsigned int i = common.first[j], l = common.second[j];
+				sum_a += sqrt(pow(a.x[i] - bases[k].x, 2) + pow(a.y[i] - bases[k].y, 2) + pow(a.z[i] - bases[k].z, 2));
+				sum_b += sqrt(pow(b.x[l], 2) + pow(b.y[l], 2) + pow(b.z[l], 2));
+			}
+
+			ratios[k] = (sum_b > 0) ? sum_a / sum_b : std::numeric_limits<double>::quiet_NaN();
+		}
+	}, num_threads, 16);
+
+	for (unsigned int k = 0; k + 1 < pairs; k++) {
+		if (!std::isfinite(ratios[k])) {
+			cout << "Error: StripOrientation::chainModels - Models " << k << " and " << k + 1
+				<< " have no points in common" << endl;
+			exit(1);
+		}
+	}
+
+	// the photos are placed one after another from the first, which defines the strip
+	scales.assign(pairs, 1.0);
+	centres.assign(pairs + 1, Point3D());
+	attitudes.assign(pairs + 1, RotationMatrix());
+
+	for (unsigned int k = 0; k < pairs; k++) {
+		Point3D base = bases[k];
+		base.rotateBy(attitudes[k]);
+		base.scaleBy(scales[k]);
+		base.translateBy(centres[k]);
+
+		centres[k + 1] = base;
+		attitudes[k + 1] = attitudes[k] * rotations[k].trans();
+		if (k + 1 < pairs)
+			scales[k + 1] = scales[k] * ratios[k];
+	}
+
+	vector<PointCloud3D> chained(pairs);
+	parallelFor(pairs, [&](unsigned int begin, unsigned int end) {
+		for (unsigned int k = begin; k < end; k++)
+			chained[k] = transformPoints(models[k], scales[k], attitudes[k], centres[k], 1);
+	}, num_threads, 16);
+
+	// the points of all models, averaged over the models they appear in
+	std::shared_ptr<IdTable> table = photos[0].table;
+	vector<double> sum_x, sum_y, sum_z;
+	vector<unsigned int> count;
+	vector<uint32_t> order;
+
+	for (unsigned int k = 0; k < pairs; k++) {
+		const PointCloud3D &model = chained[k];
+		for (unsigned int i = 0; i < model.size(); i++) {
+			uint32_t id = (model.table == table) ? model.id[i] : table->intern(model.name(i));
+			if (id >= count.size()) {
+				unsigned int size = std::max((unsigned int)id + 1, table->size());
+				sum_x.resize(size, 0.0);
+				sum_y.resize(size, 0.0);
+				sum_z.resize(size, 0.0);
+				count.resize(size, 0);
+			}
+
+			if (count[id] == 0)
+				order.push_back(id);
+
+			sum_x[id] += model.x[i];
+			sum_y[id] += model.y[i];
+			sum_z[id] += model.z[i];
+			count[id]++;
+		}
+	}
+
+	strip = PointCloud3D(table);
+	strip.reserve(order.size());
+	for (unsigned int j = 0; j < order.size(); j++) {
+		uint32_t id = order[j];
+		strip.push_back(id, sum_x[id] / count[id], sum_y[id] / count[id], sum_z[id] / count[id]);
+	}
+}
+
+SolverReport StripOrientation::computeOrientation(const PointCloud3D &control, const Point3D &_T, const Angles &_ang,
+	double _lambda) {
+
+	if (strip.size() == 0) {
+		cout << "Error: StripOrientation::computeOrientation - The models have not been chained" << endl;
+		exit(1);
+	}
+
+	PointCloud3D coords_object, coords_model;
+	alignPoints(control, strip, coords_object, coords_model);
+	if (coords_object.size() < 3) {
+		cout << "Error: StripOrientation::computeOrientation - The strip holds " << coords_object.size()
+			<< " control points, at least 3 are needed" << endl;
+		exit(1);
+	}
+
+	AbsoluteOrientation absolute(coords_object, coords_model);
+	absolute.setSolverOptions(options);
+	absolute.setParameterization(parameterization);
+	absolute.computeOrientation(_T, _ang, _lambda);
+
+	M = absolute.getM();
+	T = absolute.getT();
+	lambda = absolute.getScale();
+
+	object = transformPoints(strip, lambda, M, T);
+
+	return absolute.getReport();
+}
+
+unsigned int StripOrientation::getPairCount() {
+	return photos.size() - 1;
+}
+
+vector<SolverReport> StripOrientation::getReports() {
+	return reports;
+}
+
+vector<Point3D> StripOrientation::getBases() {
+	return bases;
+}
+
+vector<RotationMatrix> StripOrientation::getRotations() {
+	return rotations;
+}
+
+vector<PointCloud3D> StripOrientation::getModels() {
+	return models;
+}
+
+vector<double> StripOrientation::getScales() {
+	return scales;
+}
+
+vector<Point3D> StripOrientation::getCentres() {
+	return centres;
+}
+
+vector<RotationMatrix> StripOrientation::getAttitudes() {
+	return attitudes;
+}
+
+PointCloud3D StripOrientation::getStripCoords() {
+	return strip;
+}
+
+PointCloud3D StripOrientation::getObjectCoords() {
+	return object;
+}
+
+RotationMatrix StripOrientation::getM() {
+	return M;
+}
+
+Point3D StripOrientation::getT() {
+	return T;
+}
+
+double StripOrientation::getScale() {
+	return lambda;
+}
@@ -0,0 +1,116 @@
+/*
+ * The purpose of this header is to form a strip of photos into a single model. The relative
+ * orientations of all consecutive pairs are independent of each other, so they are computed
+ * in parallel, each with its left photo as datum. The models are then chained into the system
+ * of the first photo: every model is rotated by the attitudes of the photos before it and
+ * scaled to its predecessor on the points both have in common (scale transfer). The strip
+ * model can finally be brought into object space by an absolute orientation on control points.
+ */
+
+#pragma once
+
+#include "RelativeOrientation.h"
+#include "AbsoluteOrientation.h"
+#include "Correspondence.h"
+
+class StripOrientation {
+public:
+	/** StripOrientation
+	 * the constructor of this class
+	 *
+	 * @param photos - the image coordinates measured on every photo of the strip, in order
+	 *				   of flight; consecutive photos are matched by point id
+	 * @param c		 - the focal length of the photos
+	 */
+	StripOrientation(const vector<PointCloud2D> &photos, double c);
+
+	/** setSolverOptions
+	 * sets the iteration cap and damping of the solvers of the relative and absolute
+	 * orientations
+	 */
+	void setSolverOptions(const SolverOptions &options);
+
+	/** setParameterization
+	 * selects how the rotations of the relative and absolute orientations are
+	 * parameterized, see Quaternion.h
+	 */
+	void setParameterization(RotationParameterization parameterization);
+
+	/** computeModels
+	 * computes the relative orientation of every consecutive pair of photos; the pairs are
+	 * handed out to the threads one at a time, so the strip takes about as long as its
+	 * slowest pair once there are as many threads as pairs. The strip is rejected if any
+	 * pair shares fewer than 5 points or its relative orientation does not converge
+	 *
+	 * @param _B		  - the point of expansion for the base vectors; B.x fixes the scale
+	 *						of every model
+	 * @param _ang		  - the point of expansion for the rotation angles
+	 * @param num_threads - the maximum number of threads (0: one per hardware thread)
+	 */
+	void computeModels(const Point3D &_B, const Angles &_ang, unsigned int num_threads = 0);
+
+	/** chainModels
+	 * chains the models of computeModels into the system of the first model. The scale of
+	 * model k + 1 relative to model k is the ratio of the distances of their common points
+	 * from the photo both models share; points in several models are averaged
+	 *
+	 * @param num_threads - the maximum number of threads (0: one per hardware thread)
+	 */
+	void chainModels(unsigned int num_threads = 0);
+
+	/** computeOrientation
+	 * computes the absolute orientation of the chained strip model on the control points
+	 * it has in common with them, and transforms the whole strip into object space
+	 *
+	 * @param control - the object coordinates of the control points
+	 * @param _T	  - the point of expansion for the translation vector
+	 * @param _ang	  - the point of expansion for the rotation angles
+	 * @param _lambda - the point of expansion for the scale
+	 *
+	 * @return		  - the report of the absolute orientation
+	 */
+	SolverReport computeOrientation(const PointCloud3D &control, const Point3D &_T, const Angles &_ang, double _lambda);
+
+	unsigned int getPairCount();
+
+	// the relative orientation of every pair
+	vector<SolverReport> getReports();
+	vector<Point3D> getBases();
+	vector<RotationMatrix> getRotations();
+	vector<PointCloud3D> getModels();
+
+	// the chained strip; photo k is at centres[k] with the attitude attitudes[k], and model
+	// k is scaled by scales[k]
+	vector<double> getScales();
+	vector<Point3D> getCentres();
+	vector<RotationMatrix> getAttitudes();
+	PointCloud3D getStripCoords();
+
+	// the absolute orientation of the strip
+	PointCloud3D getObjectCoords();
+	RotationMatrix getM();
+	Point3D getT();
+	double getScale();
+
+private:
+	SolverOptions options;
+	RotationParameterization parameterization;
+
+	vector<PointCloud2D> photos;
+	double c; // focal length
+
+	vector<SolverReport> reports;
+	vector<Point3D> bases;
+	vector<RotationMatrix> rotations; // M of each pair, from model to right image space
+	vector<PointCloud3D> models;	  // each in the space of its left photo
+
+	vector<double> scales;
+	vector<Point3D> centres;
+	vector<RotationMatrix> attitudes; // from the space of each photo to the strip
+	PointCloud3D strip;
+
+	PointCloud3D object;
+	RotationMatrix M; // rotates from strip to object space
+	Point3D T;
+	double lambda;
+};
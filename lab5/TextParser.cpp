@@ -0,0 +1,139 @@
+#include <charconv>
+
+#include "TextParser.h"
+#include "MappedFile.h"
+#include "Parallel.h"
+
+// the points of one chunk of the file; the names point into the mapped file
+template <int D>
+struct ParsedChunk {
+	vector<const char *> name_begin, name_end;
+	vector<double> coords[D];
+	string error; // the first error of the chunk, reported by the calling thread
+};
+
+static inline bool isBlank(char c) {
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+static bool malformedLine(const char *line, const char *end, const char *filename, string &error) {
+	const char *stop = line;
+	while (stop < end && *stop != '\n' && *stop != '\r' && stop - line < 80)
+		stop++;
+
+	error = "Malformed line \"" + string(line, stop) + "\" in file " + filename;
+	return false;
+}
+
+// parses the lines in [p, end), each an id followed by D coordinates; false with the error
+// in the chunk if a line cannot be read
+template <int D>
+static bool parseChunk(const char *p, const char *end, const char *filename, ParsedChunk<D> &chunk) {
+	while (p < end) {
+		while (p < end && (isBlank(*p) || *p == '\n'))
+			p++;
+		if (p == end)
+			break;
+
+		const char *line = p;
+		while (p < end && !isBlank(*p) && *p != '\n')
+			p++;
+		chunk.name_begin.push_back(line);
+		chunk.name_end.push_back(p);
+
+		for (int d = 0; d < D; d++) {
+			while (p < end && isBlank(*p))
+				p++;
+
+			double value;
+			std::from_chars_result result = std::from_chars(p, end, value);
+			if (result.ec != std::errc() || result.ptr == p)
+				return malformedLine(line, end, filename, chunk.error);
+
+			chunk.coords[d].push_back(value);
+			p = result.ptr;
+		}
+
+		while (p < end && isBlank(*p))
+			p++;
+		if (p < end && *p != '\n')
+			return malformedLine(line, end, filename, chunk.error);
+	}
+
+	return true;
+}
+
+// parses a whole point file into the interned ids and D coordinate arrays
+template <int D>
+static void parsePoints(const char *filename, unsigned int num_threads, IdTable &table, vector<uint32_t> &id,
+	vector<double> *coords[D]) {
+
+	MappedFile file(filename);
+	const char *data = file.data();
+	const char *end = data + file.size();
+
+	// chunks of about 4 MB, split after a line break
+	unsigned int num_chunks = (unsigned int)(file.size() >> 22) + 1;
+	vector<const char *> bounds(num_chunks + 1, end);
+	bounds[0] = data;
+	for (unsigned int k = 1; k < num_chunks; k++) {
+		const char *p = std::max(bounds[k - 1], data + file.size() * k / num_chunks);
+		while (p < end && p[-1] != '\n')
+			p++;
+		bounds[k] = p;
+	}
+
+	vector<ParsedChunk<D> > chunks(num_chunks);
+	parallelFor(num_chunks, [&](unsigned int begin, unsigned int stop) {
+		for (unsigned int k = begin; k < stop; k++)
+			parseChunk<D>(bounds[k], bounds[k + 1], filename, chunks[k]);
+	}, num_threads, 1);
+
+	// the chunks are in the order of the file, so the first error is that of the first bad line
+	for (unsigned int k = 0; k < num_chunks; k++) {
+		if (!chunks[k].error.empty()) {
+			cout << "Error: parsePoints - " << chunks[k].error << endl;
+			exit(1);
+		}
+	}
+
+	size_t n = 0;
+	for (unsigned int k = 0; k < num_chunks; k++)
+		n += chunks[k].name_begin.size();
+
+	id.reserve(id.size() + n);
+	for (int d = 0; d < D; d++)
+		coords[d]->reserve(coords[d]->size() + n);
+
+	// the ids are interned serially so that they are numbered in the order of the file
+	string name;
+	for (unsigned int k = 0; k < num_chunks; k++) {
+		ParsedChunk<D> &chunk = chunks[k];
+		for (unsigned int i = 0; i < chunk.name_begin.size(); i++) {
+			name.assign(chunk.name_begin[i], chunk.name_end[i]);
+			id.push_back(table.intern(name));
+		}
+		for (int d = 0; d < D; d++) {
+			coords[d]->insert(coords[d]->end(), chunk.coords[d].begin(), chunk.coords[d].end());
+			vector<double>().swap(chunk.coords[d]);
+		}
+	}
+}
+
+PointCloud2D parse2DPoints(const char *filename, std::shared_ptr<IdTable> table, unsigned int num_threads) {
+	PointCloud2D points(table);
+	vector<double> *coords[2] = { &points.x, &points.y };
+	parsePoints<2>(filename, num_threads, *points.table, points.id, coords);
+	return points;
+}
+
+PointCloud3D parse3DPoints(const char *filename, std::shared_ptr<IdTable> table, unsigned int num_threads) {
+	PointCloud3D points(table);
+	vector<double> *coords[3] = { &points.x, &points.y, &points.z };
+	parsePoints<3>(filename, num_threads, *points.table, points.id, coords);
+	return points;
+}
+
+PointCloud3D parseGeodeticPoints(const char *filename, std::shared_ptr<IdTable> table, unsigned int num_threads) {
+	return parse3DPoints(filename, table, num_threads);
+}
@@ -0,0 +1,37 @@
+/*
+ * The purpose of this header is to read large point files quickly. The file is mapped into
+ * memory, split into chunks at line boundaries and the chunks are parsed in parallel with
+ * std::from_chars, which is locale independent and does not copy the text. The points are
+ * written straight into point clouds.
+ *
+ * Every non-blank line holds a point id followed by its coordinates, separated by spaces or
+ * tabs, as in the files read by read2DPoints, read3DPoints and readGeodeticPoints.
+ */
+
+#pragma once
+
+#include "PointCloud.h"
+
+/** parse2DPoints
+ * reads a file of 2D points (id x y) into a point cloud
+ *
+ * @param filename	  - the file to read
+ * @param table		  - the id table to intern the ids into (a new one if not given)
+ * @param num_threads - the maximum number of threads (0: one per hardware thread)
+ *
+ * @return			  - the points in the order of the file
+ */
+PointCloud2D parse2DPoints(const char *filename, std::shared_ptr<IdTable> table = std::shared_ptr<IdTable>(),
+	unsigned int num_threads = 0);
+
+/** parse3DPoints
+ * reads a file of 3D points (id x y z) into a point cloud
+ */
+PointCloud3D parse3DPoints(const char *filename, std::shared_ptr<IdTable> table = std::shared_ptr<IdTable>(),
+	unsigned int num_threads = 0);
+
+/** parseGeodeticPoints
+ * reads a file of geodetic points (id lat lon h) into a point cloud with x=lat, y=lon, z=h
+ */
+PointCloud3D parseGeodeticPoints(const char *filename, std::shared_ptr<IdTable> table = std::shared_ptr<IdTable>(),
+	unsigned int num_threads = 0);
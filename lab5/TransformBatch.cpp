@@ -0,0 +1,277 @@
+#include <algorithm>
+#include <limits>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include "TransformBatch.h"
+#include "Photo.h"
+#include "Parallel.h"
+
+// a pivot that has lost this much of its diagonal element leaves the system rank deficient
+static const double PIVOT_TOLERANCE = 1e-12;
+
+// system j of the batch, solved alone
+template <unsigned int size>
+static bool solveOne(const double *N, const double *u, unsigned int count, unsigned int j, double *x) {
+	double L[size * size], y[size];
+
+	for (unsigned int i = 0; i < size; i++) {
+		for (unsigned int c = 0; c <= i; c++) {
+			double s = N[(i * size + c) * count + j];
+			for (unsigned int k = 0; k < c; k++)
+				s -= L[i * size + k] * L[c * size + k];
+
+			if (i == c) {
+				if (!(s > PIVOT_TOLERANCE * N[(i * size + i) * count + j]))
+					return false;
+				L[i * size + i] = sqrt(s);
+			}
+			else
+				L[i * size + c] = s / L[c * size + c];
+		}
+	}
+
+	for (unsigned int i = 0; i < size; i++) {
+		double s = u[i * count + j];
+		for (unsigned int k = 0; k < i; k++)
+			s -= L[i * size + k] * y[k];
+		y[i] = s / L[i * size + i];
+	}
+
+	for (unsigned int i = size; i-- > 0;) {
+		double s = y[i];
+		for (unsigned int k = i + 1; k < size; k++)
+			s -= L[k * size + i] * x[k * count + j];
+		x[i * count + j] = s / L[i * size + i];
+	}
+
+	return true;
+}
+
+// the systems [begin, end) of the batch, four at a time in the lanes of a vector
+template <unsigned int size>
+static void solveRange(const double *N, const double *u, unsigned int count, unsigned int begin, unsigned int end,
+	double *x, vector<unsigned char> &solved) {
+
+	unsigned int j = begin;
+
+#ifdef __AVX2__
+	const __m256d tolerance = _mm256_set1_pd(PIVOT_TOLERANCE);
+
+	for (; j + 4 <= end; j += 4) {
+		__m256d L[size * size], y[size];
+		__m256d valid = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+
+		for (unsigned int i = 0; i < size; i++) {
+			for (unsigned int c = 0; c <= i; c++) {
+				__m256d s = _mm256_loadu_pd(N + (i * size + c) * count + j);
+				for (unsigned int k = 0; k < c; k++)
+					s = _mm256_sub_pd(s, _mm256_mul_pd(L[i * size + k], L[c * size + k]));
+
+				if (i == c) {
+					__m256d Nii = _mm256_loadu_pd(N + (i * size + i) * count + j);
+					valid = _mm256_and_pd(valid, _mm256_cmp_pd(s, _mm256_mul_pd(tolerance, Nii), _CMP_GT_OQ));
+					L[i * size + i] = _mm256_sqrt_pd(s);
+				}
+				else
+					L[i * size + c] = _mm256_div_pd(s, L[c * size + c]);
+			}
+		}
+
+		for (unsigned int i = 0; i < size; i++) {
+			__m256d s = _mm256_loadu_pd(u + i * count + j);
+			for (unsigned int k = 0; k < i; k++)
+				s = _mm256_sub_pd(s, _mm256_mul_pd(L[i * size + k], y[k]));
+			y[i] = _mm256_div_pd(s, L[i * size + i]);
+		}
+
+		__m256d xi[size];
+		for (unsigned int i = size; i-- > 0;) {
+			__m256d s = y[i];
+			for (unsigned int k = i + 1; k < size; k++)
+				s = _mm256_sub_pd(s, _mm256_mul_pd(L[k * size + i], xi[k]));
+			xi[i] = _mm256_div_pd(s, L[i * size + i]);
+			_mm256_storeu_pd(x + i * count + j, xi[i]);
+		}
+
+		int mask = _mm256_movemask_pd(valid);
+		for (unsigned int lane = 0; lane < 4; lane++)
+			solved[j + lane] = (mask >> lane) & 1;
+	}
+#endif
+
+	for (; j < end; j++)
+		solved[j] = solveOne<size>(N, u, count, j, x);
+}
+
+template <unsigned int size>
+static void solveBatch(const double *N, const double *u, unsigned int count, double *x, vector<unsigned char> &solved,
+	unsigned int num_threads) {
+
+	parallelFor(count, [&](unsigned int begin, unsigned int end) {
+		solveRange<size>(N, u, count, begin, end, x, solved);
+	}, num_threads, 1024);
+}
+
+void choleskySolveBatch(const double *N, const double *u, unsigned int size, unsigned int count, double *x,
+	vector<unsigned char> &solved, unsigned int num_threads) {
+
+	solved.assign(count, 0);
+
+	switch (size) {
+	case 1: solveBatch<1>(N, u, count, x, solved, num_threads); break;
+	case 2: solveBatch<2>(N, u, count, x, solved, num_threads); break;
+	case 3: solveBatch<3>(N, u, count, x, solved, num_threads); break;
+	case 4: solveBatch<4>(N, u, count, x, solved, num_threads); break;
+	case 5: solveBatch<5>(N, u, count, x, solved, num_threads); break;
+	case 6: solveBatch<6>(N, u, count, x, solved, num_threads); break;
+	case 7: solveBatch<7>(N, u, count, x, solved, num_threads); break;
+	case 8: solveBatch<8>(N, u, count, x, solved, num_threads); break;
+	default:
+		cout << "Error: choleskySolveBatch - Systems larger than 8 are not supported" << endl;
+		exit(1);
+	}
+}
+
+/*
+ * The normals of every problem, reduced to the first point of the problem, scattered across
+ * problems; kernel is similarityNormals or affineNormals
+ */
+template <unsigned int size, typename Kernel>
+static void batchNormals(const double *x, const double *y, const double *X, const double *Y, const double *p,
+	const unsigned int *offsets, unsigned int count, vector<double> &N, vector<double> &u, vector<double> &origins,
+	unsigned int num_threads, const Kernel &kernel) {
+
+	N.resize(size * size * count);
+	u.resize(size * count);
+	origins.resize(4 * count);
+
+	parallelFor(count, [&](unsigned int begin, unsigned int end) {
+		double Nj[size * size], uj[size];
+
+		for (unsigned int j = begin; j < end; j++) {
+			unsigned int first = offsets[j], n = offsets[j + 1] - first;
+
+			double *origin = &origins[4 * j];
+			if (n > 0) {
+				origin[0] = x[first];
+				origin[1] = y[first];
+				origin[2] = X[first];
+				origin[3] = Y[first];
+			}
+			else
+				std::fill(origin, origin + 4, 0.0);
+
+			kernel(x + first, y + first, X + first, Y + first, (p != NULL) ? p + 2 * first : NULL, n, origin, Nj, uj, 1);
+
+			for (unsigned int k = 0; k < size * size; k++)
+				N[k * count + j] = Nj[k];
+			for (unsigned int k = 0; k < size; k++)
+				u[k * count + j] = uj[k];
+		}
+	}, num_threads, 256);
+}
+
+unsigned int fitSimilarityBatch(const double *x, const double *y, const double *X, const double *Y, const double *p,
+	const unsigned int *offsets, unsigned int count, vector<SimilarityParams> &params, unsigned int num_threads) {
+
+	vector<double> N, u, origins, del(4 * count);
+	batchNormals<4>(x, y, X, Y, p, offsets, count, N, u, origins, num_threads, similarityNormals);
+
+	vector<unsigned char> solved;
+	choleskySolveBatch(N.data(), u.data(), 4, count, del.data(), solved, num_threads);
+
+	params.resize(count);
+	unsigned int failed = 0;
+	const double nan = std::numeric_limits<double>::quiet_NaN();
+
+	for (unsigned int j = 0; j < count; j++) {
+		SimilarityParams &par = params[j];
+		if (!solved[j]) {
+			par.a = par.b = par.dx = par.dy = par.lambda = par.theta = nan;
+			failed++;
+			continue;
+		}
+
+		const double *origin = &origins[4 * j];
+		par.a = del[j];
+		par.b = del[count + j];
+		par.dx = del[2 * count + j] + origin[2] - par.a * origin[0] + par.b * origin[1];
+		par.dy = del[3 * count + j] + origin[3] - par.b * origin[0] - par.a * origin[1];
+
+		par.theta = atan2(par.b, par.a);
+		par.lambda = sqrt(pow(par.a, 2) + pow(par.b, 2));
+	}
+
+	return failed;
+}
+
+unsigned int fitAffineBatch(const double *x, const double *y, const double *X, const double *Y, const double *p,
+	const unsigned int *offsets, unsigned int count, vector<AffineParams> &params, unsigned int num_threads) {
+
+	vector<double> N, u, origins, del(6 * count);
+	batchNormals<6>(x, y, X, Y, p, offsets, count, N, u, origins, num_threads, affineNormals);
+
+	vector<unsigned char> solved;
+	choleskySolveBatch(N.data(), u.data(), 6, count, del.data(), solved, num_threads);
+
+	params.resize(count);
+	unsigned int failed = 0;
+	const double nan = std::numeric_limits<double>::quiet_NaN();
+
+	for (unsigned int j = 0; j < count; j++) {
+		AffineParams &par = params[j];
+		if (!solved[j]) {
+			par.a = par.b = par.c = par.d = par.dx = par.dy = nan;
+			par.sx = par.sy = par.theta = par.delta = nan;
+			failed++;
+			continue;
+		}
+
+		const double *origin = &origins[4 * j];
+		par.a = del[j];
+		par.b = del[count + j];
+		par.dx = del[2 * count + j] + origin[2] - par.a * origin[0] - par.b * origin[1];
+		par.c = del[3 * count + j];
+		par.d = del[4 * count + j];
+		par.dy = del[5 * count + j] + origin[3] - par.c * origin[0] - par.d * origin[1];
+
+		par.sx = sqrt(pow(par.a, 2) + pow(par.c, 2));
+		par.sy = sqrt(pow(par.b, 2) + pow(par.d, 2));
+		par.theta = atan2(par.c, par.a);
+		par.delta = atan2(par.a * par.b + par.c * par.d, par.a * par.d - par.b * par.c);
+	}
+
+	return failed;
+}
+
+// checks the offsets of a batch against the clouds
+static void checkOffsets(const PointCloud2D &coords_from, const PointCloud2D &coords_to,
+	const vector<unsigned int> &offsets, const char *caller) {
+
+	bool valid = !offsets.empty() && offsets.front() == 0 && offsets.back() == coords_from.size() &&
+		coords_to.size() == coords_from.size() && std::is_sorted(offsets.begin(), offsets.end());
+
+	if (!valid) {
+		cout << "Error: " << caller << " - The offsets do not match the coordinates" << endl;
+		exit(1);
+	}
+}
+
+unsigned int fitSimilarityBatch(const PointCloud2D &coords_from, const PointCloud2D &coords_to,
+	const vector<unsigned int> &offsets, vector<SimilarityParams> &params, unsigned int num_threads) {
+
+	checkOffsets(coords_from, coords_to, offsets, "fitSimilarityBatch");
+	return fitSimilarityBatch(coords_from.x.data(), coords_from.y.data(), coords_to.x.data(), coords_to.y.data(),
+		NULL, offsets.data(), offsets.size() - 1, params, num_threads);
+}
+
+unsigned int fitAffineBatch(const PointCloud2D &coords_from, const PointCloud2D &coords_to,
+	const vector<unsigned int> &offsets, vector<AffineParams> &params, unsigned int num_threads) {
+
+	checkOffsets(coords_from, coords_to, offsets, "fitAffineBatch");
+	return fitAffineBatch(coords_from.x.data(), coords_from.y.data(), coords_to.x.data(), coords_to.y.data(),
+		NULL, offsets.data(), offsets.size() - 1, params, num_threads);
+}
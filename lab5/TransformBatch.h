@@ -0,0 +1,60 @@
+/*
+ * The purpose of this header is to fit many independent 2D similarity or affine
+ * transformations at once, such as the fiducial mark transformations of the interior
+ * orientation of every scanned photo of a block. The points of all problems are given
+ * one after another, with offsets marking where each problem starts, and the small
+ * normal equations are stored across problems (element k of problem j at k * count + j)
+ * so that their Cholesky decompositions run with one problem in each lane of a vector.
+ */
+
+#pragma once
+
+#include "PointCloud.h"
+#include "SimilarityTransform2D.h"
+#include "AffineTransform2D.h"
+
+/** choleskySolveBatch
+ * solves count independent symmetric positive definite systems N_j * x_j = u_j, with
+ * element k of system j stored at k * count + j, vectorized across systems where AVX2 is
+ * available and threaded across chunks
+ *
+ * @param N			  - size * size * count elements, the row-major matrices across systems
+ * @param u			  - size * count elements, the right-hand sides across systems
+ * @param size		  - the size of the systems (at most 8)
+ * @param count		  - the number of systems
+ * @param x			  - size * count elements, the solutions across systems
+ * @param solved	  - count flags; 0 where N_j is not positive definite
+ * @param num_threads - the maximum number of threads (0: one per hardware thread)
+ */
+void choleskySolveBatch(const double *N, const double *u, unsigned int size, unsigned int count, double *x,
+	vector<unsigned char> &solved, unsigned int num_threads = 0);
+
+/** fitSimilarityBatch
+ * fits a linear similarity transformation to each of count problems (see
+ * SimilarityTransform2D); problem j is made up of the points [offsets[j], offsets[j + 1])
+ *
+ * @param x, y		  - the "from" coordinates of all problems
+ * @param X, Y		  - the "to" coordinates of all problems, the observations
+ * @param p			  - the weights of the observations in the order x0, y0, x1, y1, ...
+ *						(NULL for unit weights)
+ * @param offsets	  - count + 1 offsets of the problems into the coordinates
+ * @param count		  - the number of problems
+ * @param params	  - the count fitted transformations; NaN for a problem without a unique
+ *						solution (fewer than two distinct points)
+ * @param num_threads - the maximum number of threads (0: one per hardware thread)
+ *
+ * @return			  - the number of problems without a unique solution
+ */
+unsigned int fitSimilarityBatch(const double *x, const double *y, const double *X, const double *Y, const double *p,
+	const unsigned int *offsets, unsigned int count, vector<SimilarityParams> &params, unsigned int num_threads = 0);
+unsigned int fitSimilarityBatch(const PointCloud2D &coords_from, const PointCloud2D &coords_to,
+	const vector<unsigned int> &offsets, vector<SimilarityParams> &params, unsigned int num_threads = 0);
+
+/** fitAffineBatch
+ * fits a linear affine transformation to each of count problems (see AffineTransform2D),
+ * like fitSimilarityBatch; NaN for a problem with fewer than three points not on a line
+ */
+unsigned int fitAffineBatch(const double *x, const double *y, const double *X, const double *Y, const double *p,
+	const unsigned int *offsets, unsigned int count, vector<AffineParams> &params, unsigned int num_threads = 0);
+unsigned int fitAffineBatch(const PointCloud2D &coords_from, const PointCloud2D &coords_to,
+	const vector<unsigned int> &offsets, vector<AffineParams> &params, unsigned int num_threads = 0);
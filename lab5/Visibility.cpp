@@ -0,0 +1,310 @@
+#include <atomic>
+#include <limits>
+#include "Visibility.h"
+#include "Parallel.h"
+#include "Projection.h"
+
+static const float empty_depth = std::numeric_limits<float>::infinity();
+
+Visibility::Visibility(const Camera &camera, const SensorGeometry &sensor) : camera(camera), sensor(sensor) {
+	clear();
+}
+
+void Visibility::setOptions(const VisibilityOptions &options) {
+	if (options.tile_size == 0) {
+		cout << "Error: Visibility::setOptions Tile size must be positive" << endl;
+		exit(1);
+	}
+	this->options = options;
+}
+
+void Visibility::clear() {
+	depth.assign((size_t)sensor.width * sensor.height, empty_depth);
+}
+
+const vector<float> &Visibility::getDepthBuffer() {
+	return depth;
+}
+
+void Visibility::projectToPixels(const vector<double> &X, const vector<double> &Y, const vector<double> &Z,
+	vector<double> &col, vector<double> &row, vector<double> &d, vector<unsigned char> &valid) {
+
+	unsigned int n = X.size();
+	col.resize(n);
+	row.resize(n);
+	d.resize(n);
+	valid.resize(n);
+
+	ProjectionOptions projection_options;
+	projection_options.num_threads = options.num_threads;
+
+	Projection projection(camera);
+	projection.setOptions(projection_options);
+	projection.project(X.data(), Y.data(), Z.data(), n, col.data(), row.data(), valid.data(), d.data());
+
+	// image coordinates -> pixel positions
+	double ps = sensor.pixel_size;
+	for (unsigned int i = 0; i < n; i++) {
+		col[i] = sensor.cx + col[i] / ps;
+		row[i] = sensor.cy - row[i] / ps;
+	}
+}
+
+void Visibility::binPrimitives(const vector<int> &bbox, vector<unsigned int> &offsets, vector<unsigned int> &items) {
+	unsigned int ts = options.tile_size;
+	unsigned int tiles_x = (sensor.width + ts - 1) / ts;
+	unsigned int tiles_y = (sensor.height + ts - 1) / ts;
+	unsigned int n = bbox.size() / 4;
+
+	// counting sort of the (primitive, tile) pairs by tile
+	offsets.assign(tiles_x * tiles_y + 1, 0);
+	for (int pass = 0; pass < 2; pass++) {
+		vector<unsigned int> fill;
+		if (pass == 1) {
+			for (unsigned int t = 0; t < tiles_x * tiles_y; t++)
+				offsets[t + 1] += offsets[t];
+			items.resize(offsets.back());
+			fill.assign(offsets.begin(), offsets.end() - 1);
+		}
+
+		for (unsigned int k = 0; k < n; k++) {
+			const int *b = &bbox[4 * k];
+			if (b[0] > b[1] || b[2] > b[3])
+				continue;
+
+			for (unsigned int ty = b[2] / ts; ty <= b[3] / ts; ty++)
+				for (unsigned int tx = b[0] / ts; tx <= b[1] / ts; tx++) {
+					unsigned int t = ty * tiles_x + tx;
+					if (pass == 0)
+						offsets[t + 1]++;
+					else
+						items[fill[t]++] = k;
+				}
+		}
+	}
+}
+
+// bounding box of a primitive in pixels, clipped to the image; empty if fully outside
+static void clipBox(double c0, double c1, double r0, double r1, unsigned int width, unsigned int height, int *b) {
+	// rejected before any conversion, so NaN or far off-image coordinates never reach the casts
+	if (!(c1 >= 0.0 && r1 >= 0.0 && c0 <= width - 1.0 && r0 <= height - 1.0)) {
+		b[0] = 1;
+		b[1] = 0;
+		b[2] = 1;
+		b[3] = 0;
+		return;
+	}
+
+	b[0] = (int)fmax(ceil(c0), 0.0);
+	b[1] = (int)fmin(floor(c1), width - 1.0);
+	b[2] = (int)fmax(ceil(r0), 0.0);
+	b[3] = (int)fmin(floor(r1), height - 1.0);
+}
+
+// the tile of the depth buffer a thread rasterizes into, addressed by pixel position
+struct DepthTile {
+	float *z;
+	int c0, r0;
+	unsigned int stride;
+
+	// keeps the nearer of the depth at the pixel and d
+	void test(int x, int y, float d) {
+		float &t = z[(y - r0) * stride + (x - c0)];
+		if (d < t)
+			t = d;
+	}
+};
+
+/*
+ * rasterizes the binned primitives tile by tile: each tile is loaded from the depth buffer,
+ * every primitive of the tile is drawn into it by draw(k, x0, x1, y0, y1, tile) over its
+ * bounding box clipped to the tile, and the tile is written back
+ */
+template <typename Draw>
+static void rasterizeTiles(vector<float> &depth, unsigned int width, unsigned int height, unsigned int ts,
+	const vector<unsigned int> &offsets, const vector<unsigned int> &items, const vector<int> &bbox,
+	unsigned int num_threads, const Draw &draw) {
+
+	unsigned int tiles_x = (width + ts - 1) / ts;
+
+	parallelFor(offsets.size() - 1, [&](unsigned int begin, unsigned int end) {
+		vector<float> buffer(ts * ts);
+
+		for (unsigned int t = begin; t < end; t++) {
+			if (offsets[t] == offsets[t + 1])
+				continue;
+
+			unsigned int c0 = (t % tiles_x) * ts;
+			unsigned int r0 = (t / tiles_x) * ts;
+			unsigned int tw = min(ts, width - c0);
+			unsigned int th = min(ts, height - r0);
+
+			for (unsigned int y = 0; y < th; y++)
+				for (unsigned int x = 0; x < tw; x++)
+					buffer[y * ts + x] = depth[(size_t)(r0 + y) * width + c0 + x];
+
+			DepthTile tile = { buffer.data(), (int)c0, (int)r0, ts };
+			for (unsigned int a = offsets[t]; a < offsets[t + 1]; a++) {
+				unsigned int k = items[a];
+				const int *b = &bbox[4 * k];
+
+				int x0 = max(b[0], (int)c0), x1 = min(b[1], (int)(c0 + tw - 1));
+				int y0 = max(b[2], (int)r0), y1 = min(b[3], (int)(r0 + th - 1));
+				draw(k, x0, x1, y0, y1, tile);
+			}
+
+			for (unsigned int y = 0; y < th; y++)
+				for (unsigned int x = 0; x < tw; x++)
+					depth[(size_t)(r0 + y) * width + c0 + x] = buffer[y * ts + x];
+		}
+	}, num_threads, 1);
+}
+
+void Visibility::rasterizePoints(const vector<double> &X, const vector<double> &Y, const vector<double> &Z) {
+	vector<double> col, row, d;
+	vector<unsigned char> valid;
+	projectToPixels(X, Y, Z, col, row, d, valid);
+
+	unsigned int n = X.size();
+	double r = options.point_radius;
+
+	vector<int> bbox(4 * n);
+	for (unsigned int i = 0; i < n; i++) {
+		int *b = &bbox[4 * i];
+		if (!valid[i]) {
+			b[0] = 1;
+			b[1] = 0;
+			continue;
+		}
+		double c = floor(col[i] + 0.5);
+		double w = floor(row[i] + 0.5);
+		clipBox(c - r, c + r, w - r, w + r, sensor.width, sensor.height, b);
+	}
+
+	vector<unsigned int> offsets, items;
+	binPrimitives(bbox, offsets, items);
+
+	rasterizeTiles(depth, sensor.width, sensor.height, options.tile_size, offsets, items, bbox, options.num_threads,
+		[&](unsigned int k, int x0, int x1, int y0, int y1, DepthTile &tile) {
+		float dk = (float)d[k];
+		for (int y = y0; y <= y1; y++)
+			for (int x = x0; x <= x1; x++)
+				tile.test(x, y, dk);
+	});
+}
+
+void Visibility::rasterizeDEM(const DEM &dem) {
+	unsigned int cols = dem.getCols();
+	unsigned int rows = dem.getRows();
+	unsigned int nv = cols * rows;
+
+	vector<double> X(nv), Y(nv), Z(nv);
+	for (unsigned int r = 0; r < rows; r++)
+		for (unsigned int c = 0; c < cols; c++) {
+			unsigned int v = r * cols + c;
+			X[v] = dem.cellX(c);
+			Y[v] = dem.cellY(r);
+			Z[v] = dem.at(r, c);
+		}
+
+	vector<double> col, row, d;
+	vector<unsigned char> valid;
+	projectToPixels(X, Y, Z, col, row, d, valid);
+
+	// two triangles per grid cell
+	unsigned int nt = 2 * (cols - 1) * (rows - 1);
+	vector<unsigned int> tri(3 * nt);
+	vector<int> bbox(4 * nt);
+
+	for (unsigned int r = 0, k = 0; r + 1 < rows; r++)
+		for (unsigned int c = 0; c + 1 < cols; c++) {
+			unsigned int v00 = r * cols + c, v01 = v00 + 1, v10 = v00 + cols, v11 = v10 + 1;
+			unsigned int corners[2][3] = { { v00, v01, v10 }, { v01, v11, v10 } };
+
+			for (int h = 0; h < 2; h++, k++) {
+				unsigned int *v = &tri[3 * k];
+				v[0] = corners[h][0];
+				v[1] = corners[h][1];
+				v[2] = corners[h][2];
+
+				int *b = &bbox[4 * k];
+				if (!valid[v[0]] || !valid[v[1]] || !valid[v[2]]) {
+					b[0] = 1;
+					b[1] = 0;
+					continue;
+				}
+				clipBox(fmin(col[v[0]], fmin(col[v[1]], col[v[2]])), fmax(col[v[0]], fmax(col[v[1]], col[v[2]])),
+					fmin(row[v[0]], fmin(row[v[1]], row[v[2]])), fmax(row[v[0]], fmax(row[v[1]], row[v[2]])),
+					sensor.width, sensor.height, b);
+			}
+		}
+
+	vector<unsigned int> offsets, items;
+	binPrimitives(bbox, offsets, items);
+
+	rasterizeTiles(depth, sensor.width, sensor.height, options.tile_size, offsets, items, bbox, options.num_threads,
+		[&](unsigned int k, int x0, int x1, int y0, int y1, DepthTile &tile) {
+		const unsigned int *v = &tri[3 * k];
+
+		double ax = col[v[0]], ay = row[v[0]];
+		double bx = col[v[1]], by = row[v[1]];
+		double cx = col[v[2]], cy = row[v[2]];
+
+		double area = (bx - ax) * (cy - ay) - (by - ay) * (cx - ax);
+		if (area == 0.0)
+			return;
+
+		// 1/depth is linear in the image, so it is interpolated instead of the depth
+		double ia = 1.0 / d[v[0]], ib = 1.0 / d[v[1]], ic = 1.0 / d[v[2]];
+
+		for (int y = y0; y <= y1; y++)
+			for (int x = x0; x <= x1; x++) {
+				// barycentric coordinates of the pixel centre
+				double l1 = ((cx - x) * (ay - y) - (cy - y) * (ax - x)) / area;
+				double l2 = ((ax - x) * (by - y) - (ay - y) * (bx - x)) / area;
+				double l0 = 1.0 - l1 - l2;
+				if (l0 < 0.0 || l1 < 0.0 || l2 < 0.0)
+					continue;
+
+				tile.test(x, y, (float)(1.0 / (l0 * ia + l1 * ib + l2 * ic)));
+			}
+	});
+}
+
+unsigned int Visibility::testPoints(const vector<double> &X, const vector<double> &Y, const vector<double> &Z,
+	vector<unsigned char> &visible) {
+
+	vector<double> col, row, d;
+	projectToPixels(X, Y, Z, col, row, d, visible);
+
+	std::atomic<unsigned int> count(0);
+	parallelFor(X.size(), [&](unsigned int begin, unsigned int end) {
+		unsigned int local = 0;
+		for (unsigned int i = begin; i < end; i++) {
+			if (!visible[i])
+				continue;
+
+			double c = floor(col[i] + 0.5);
+			double r = floor(row[i] + 0.5);
+			if (!(c >= 0.0 && r >= 0.0 && c < sensor.width && r < sensor.height)) {
+				visible[i] = 0;
+				continue;
+			}
+
+			float z = depth[(size_t)r * sensor.width + (size_t)c];
+			visible[i] = (d[i] <= z + options.tolerance * d[i]) ? 1 : 0;
+			local += visible[i];
+		}
+		count += local;
+	}, options.num_threads, 16384);
+
+	return count;
+}
+
+unsigned int Visibility::computeVisibility(const vector<double> &X, const vector<double> &Y, const vector<double> &Z,
+	vector<unsigned char> &visible) {
+
+	clear();
+	rasterizePoints(X, Y, Z);
+	return testPoints(X, Y, Z, visible);
+}
@@ -0,0 +1,94 @@
+/*
+ * The purpose of this header is to provide a z-buffer of an oriented photo to decide which
+ * object points are visible in it. Occluders (dense point sets drawn as small square
+ * splats, or the triangles of a DEM) are projected with the collinearity equations, binned
+ * into the image tiles they overlap and rasterized tile by tile on all threads, each thread
+ * working in its own tile-sized depth buffer. The depth of a point is -W, its distance from
+ * the perspective centre along the optical axis.
+ *
+ * All passes (projection, binning, rasterization, depth test) are linear in the number of
+ * primitives and pixels.
+ */
+
+#pragma once
+
+#include "Camera.h"
+#include "Raster.h"
+
+struct VisibilityOptions {
+	unsigned int tile_size;	   // edge length of the square image tiles [pixels]
+	unsigned int point_radius; // half size of the square splat of a point [pixels]
+	double tolerance;		   // depth tolerance of the visibility test, relative to the depth
+	unsigned int num_threads;  // 0: one thread per hardware thread
+
+	VisibilityOptions() : tile_size(64), point_radius(1), tolerance(1.0E-3), num_threads(0) {}
+};
+
+class Visibility {
+public:
+	/** Visibility
+	 * the constructor of this class; the depth buffer covers the pixels of the sensor
+	 *
+	 * @param camera - the oriented photo (e.g. Resection::getCamera())
+	 * @param sensor - the pixel geometry of the photo
+	 */
+	Visibility(const Camera &camera, const SensorGeometry &sensor);
+
+	void setOptions(const VisibilityOptions &options);
+
+	/** clear
+	 * resets the depth buffer to empty (infinite depth)
+	 */
+	void clear();
+
+	/** rasterizePoints
+	 * draws a set of object points into the depth buffer as square splats
+	 */
+	void rasterizePoints(const vector<double> &X, const vector<double> &Y, const vector<double> &Z);
+
+	/** rasterizeDEM
+	 * draws the surface of a DEM, two triangles per grid cell, into the depth buffer
+	 */
+	void rasterizeDEM(const DEM &dem);
+
+	/** testPoints
+	 * tests object points against the current depth buffer; a point is visible if it
+	 * projects into the photo in front of the camera and is not farther away than the
+	 * surface drawn at its pixel (within the tolerance)
+	 *
+	 * @param visible - the output visibility flags
+	 *
+	 * @return		  - the number of visible points
+	 */
+	unsigned int testPoints(const vector<double> &X, const vector<double> &Y, const vector<double> &Z,
+		vector<unsigned char> &visible);
+
+	/** computeVisibility
+	 * the visibility of a dense point set occluded by itself: the points are drawn into
+	 * the (cleared) depth buffer and then tested against it
+	 *
+	 * @return - the number of visible points
+	 */
+	unsigned int computeVisibility(const vector<double> &X, const vector<double> &Y, const vector<double> &Z,
+		vector<unsigned char> &visible);
+
+	const vector<float> &getDepthBuffer(); // width * height depths, row-major
+private:
+	Camera camera;
+	SensorGeometry sensor;
+	VisibilityOptions options;
+	vector<float> depth;
+
+	/** projectToPixels
+	 * projects object points to pixel positions and depths; valid is 0 for points at or
+	 * behind the perspective centre
+	 */
+	void projectToPixels(const vector<double> &X, const vector<double> &Y, const vector<double> &Z,
+		vector<double> &col, vector<double> &row, vector<double> &d, vector<unsigned char> &valid);
+
+	/** binPrimitives
+	 * sorts primitives into the tiles overlapped by their pixel bounding boxes (4 per
+	 * primitive: col_min, col_max, row_min, row_max; empty if col_min > col_max)
+	 */
+	void binPrimitives(const vector<int> &bbox, vector<unsigned int> &offsets, vector<unsigned int> &items);
+};
@@ -38,6 +38,10 @@ int main() {
 	Resection resection(coords_object, coords_image, c);
 	resection.computeResection(Point3D(params.dx, params.dy, H), Angles(0, 0, params.theta), tolerances);
 
+	SolverReport report = resection.getReport();
+	std::cout << "Resection " << convergenceReason(report.reason) << " after "
+		<< report.iterations << " iterations" << std::endl;
+
 	printStatistics(resection);
 	printParameters(resection);
 	